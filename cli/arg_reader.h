@@ -27,6 +27,20 @@ public:
         }
     }
 
+    // Return the argument after the current one without advancing, or NULL if
+    // there is none.  This is useful for options with optional values.
+    const char * peek() const
+    {
+        if (index < argc)
+        {
+            return argv[index + 1];
+        }
+        else
+        {
+            return NULL;
+        }
+    }
+
     // Return the argument before the current one, or NULL.
     const char * last() const
     {
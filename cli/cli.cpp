@@ -4,9 +4,30 @@
 #include <iomanip>
 #include <bitset>
 #include <cassert>
+#include <cctype>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <iterator>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
 
 #include <pavrpgm_config.h>
 #include <programmer.h>
+#include <programmer_trace.h>
+#include <programmer_descriptor_cache.h>
+#ifndef _WIN32
+#include <programmer_daemon.h>
+#endif
+#include <programmer_fleet.h>
+#include <programmer_format.h>
+#include <programmer_profile.h>
+#include <programmer_resilient.h>
 #include "arg_reader.h"
 #include "exit_codes.h"
 #include "exception_with_exit_code.h"
@@ -21,9 +42,36 @@ static const char help[] =
     "General options:\n"
     "  -s, --status                Show programmer settings and info.\n"
     "  -d SERIALNUMBER             Specifies the serial number of the programmer.\n"
+    "                              Can be repeated, and can contain * and ?\n"
+    "                              wildcards, to select several programmers.\n"
+    "  --all                       Select every connected programmer.\n"
     "  --list                      List programmers connected to computer.\n"
+    "  --format FORMAT             Output format for --status: text (default),\n"
+    "                              json, yaml, or kv (key=value lines).  The\n"
+    "                              output of -r and --stats is included.\n"
     "  --prog-port                 Print the name of the programming serial port.\n"
     "  --ttl-port                  Print the name of the TTL serial port.\n"
+    "  --watch [RATE]              Keep printing the programmer's variables,\n"
+    "                              RATE times per second (default 10), until\n"
+    "                              interrupted with Ctrl+C.\n"
+    "  --watch-format FORMAT       Output format for --watch: csv (default) or\n"
+    "                              json (one JSON object per line).\n"
+    "  --watch-count N             Stop --watch after N samples.\n"
+    "  --export-settings FILE      Save the settings to a profile file, after\n"
+    "                              making any requested changes.  Use - for\n"
+    "                              standard output.\n"
+    "  --stats                     Show USB transfer statistics after other actions.\n"
+    "  --cache                     Remember serial port names and firmware versions\n"
+    "                              in a cache file to make later runs faster.\n"
+#ifndef _WIN32
+    "  --no-daemon                 Talk to the programmer directly even if\n"
+    "                              " DAEMON_NAME " is running.\n"
+#endif
+    "  --record-trace FILE         Record all USB requests to a trace file.\n"
+    "  --replay-trace FILE         Use responses from a trace file instead of a\n"
+    "                              real programmer.\n"
+    "  --replay-timing             Replay the requests with the same timing as\n"
+    "                              when they were recorded.\n"
     "  -h, --help                  Show this help screen.\n"
     "\n"
     "Options for changing settings:\n"
@@ -36,13 +84,14 @@ static const char help[] =
     "  --vcc-output-ind OPTION     Sets how to indicate that VCC is an output.\n"
     "                              blinking - yellow LED(s) blink at 8 Hz (default)\n"
     "                              steady - yellow LED(s) are on constantly\n"
-    "  --freq NUM                  Sets the ISP frequency (in units of kHz).\n"
-    "                              Must be typed exactly as shown below.\n"
+    "  --freq NUM                  Sets the ISP frequency (in units of kHz, or\n"
+    "                              with a Hz, kHz, or MHz suffix).  If it is not\n"
+    "                              one of the allowed values, the fastest allowed\n"
+    "                              value below it is used.\n"
     "                              Suggested values: 3000, 2400, 2000, 1714\n"
     "                              1500, 1200, 1000, 750, 444, 114 (default),\n"
     "                              28.3, 14.0, 6.98, 3.47, 1.744, 1.465.\n"
-    "  --max-freq NUM              Sets the max ISP frequency (in units of kHz).\n"
-    "                              Must be typed exactly as shown below.\n"
+    "  --max-freq NUM              Sets the max ISP frequency, like --freq.\n"
     "                              Suggested values: 3000, 2400, 2000,\n"
     "                              1714 (default), 1500, 1200, 1000, 750.\n"
     "  --line-a FUNC               Set the function of line A.  Valid FUNCs are:\n"
@@ -59,6 +108,9 @@ static const char help[] =
     "  --sw-major HEXNUM           Set STK500 software version major (in hex)\n"
     "  --hw HEXNUM                 Set STK500 software hardware version (in hex)\n"
     "  --restore-defaults          Restore factory settings\n"
+    "  --import-settings FILE      Apply the settings in a profile file made with\n"
+    "                              --export-settings.  Use - for standard input.\n"
+    "                              Options above override the profile.\n"
     "\n"
     "This utility only supports the Pololu USB AVR Programmer v2\n"
     "(blue-colored, labeled \"pgm04a\").\n"
@@ -68,6 +120,54 @@ static const char help[] =
     "For more help, see: " DOCUMENTATION_URL "\n"
     "\n";
 
+// The default and maximum number of samples per second for --watch.
+#define WATCH_DEFAULT_RATE 10
+#define WATCH_MAX_RATE 1000
+
+// How often --watch flushes its output, in milliseconds.  Flushing every line
+// would make fast rates much more expensive when the output is a pipe or file.
+#define WATCH_FLUSH_INTERVAL_MS 250
+
+// Returns true if the serial number pattern contains wildcards.
+static bool hasWildcards(const std::string & pattern)
+{
+    return pattern.find_first_of("*?") != std::string::npos;
+}
+
+// Matches a string against a pattern where '*' matches any sequence of
+// characters and '?' matches any single character.
+static bool matchesPattern(const char * str, const char * pattern)
+{
+    // When we hit a '*', remember where we were so we can come back and let
+    // it match one more character if the rest of the pattern fails.
+    const char * starPattern = NULL;
+    const char * starStr = NULL;
+    while (*str)
+    {
+        if (*pattern == '*')
+        {
+            starPattern = ++pattern;
+            starStr = str;
+        }
+        else if (*pattern == '?' || *pattern == *str)
+        {
+            pattern++;
+            str++;
+        }
+        else if (starPattern)
+        {
+            pattern = starPattern;
+            str = ++starStr;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (*pattern == '*') { pattern++; }
+    return *pattern == 0;
+}
+
 // Note: The arguments that are entered as a number by the user are all
 // uint32_t.  If we made them be their proper types, that would mean adding more
 // information to the CLI code that could instead be in the library, and it
@@ -76,9 +176,12 @@ static const char help[] =
 struct Arguments
 {
     bool showStatus = false;
+    std::string statusFormat = "text";
+
+    // Serial numbers or patterns from the -d options.
+    std::vector<std::string> serialNumbers;
 
-    bool serialNumberSpecified = false;
-    std::string serialNumber;
+    bool all = false;
 
     bool showList = false;
 
@@ -129,6 +232,13 @@ struct Arguments
 
     bool restoreDefaults = false;
 
+    bool importSettingsSpecified = false;
+    std::string importSettingsFile;
+    ProgrammerSettingsProfile importProfile;
+
+    bool exportSettingsSpecified = false;
+    std::string exportSettingsFile;
+
     bool printProgrammingPort = false;
 
     bool printTtlPort = false;
@@ -137,6 +247,29 @@ struct Arguments
 
     bool digitalRead = false;
 
+    bool watch = false;
+    double watchRate = WATCH_DEFAULT_RATE;
+    bool watchJson = false;
+
+    bool watchCountSpecified = false;
+    uint32_t watchCount;
+
+    bool showStats = false;
+
+    bool useCache = false;
+
+#ifndef _WIN32
+    bool noDaemon = false;
+#endif
+
+    bool recordTraceSpecified = false;
+    std::string recordTraceFile;
+
+    bool replayTraceSpecified = false;
+    std::string replayTraceFile;
+
+    bool replayTiming = false;
+
     // [all-settings]
     bool settingsSpecified() const
     {
@@ -155,7 +288,24 @@ struct Arguments
             vcc3v3MaxSpecified ||
             vcc5vMinSpecified ||
             vcc5vMaxSpecified ||
-            restoreDefaults;
+            restoreDefaults ||
+            importSettingsSpecified;
+    }
+
+    // Returns true if the actions should be run on every matching programmer
+    // instead of exactly one.
+    bool multipleProgrammers() const
+    {
+        if (all || serialNumbers.size() > 1) { return true; }
+        return serialNumbers.size() == 1 && hasWildcards(serialNumbers[0]);
+    }
+
+    // Returns true if the status is printed as a JSON, YAML, or key=value
+    // document.  The digital readings and the statistics are added to the
+    // document then, so that no other output gets mixed with it.
+    bool statusDocument() const
+    {
+        return showStatus && statusFormat != "text";
     }
 
     bool actionSpecified() const
@@ -166,7 +316,9 @@ struct Arguments
             printProgrammingPort ||
             printTtlPort ||
             showHelp ||
-            digitalRead;
+            digitalRead ||
+            watch ||
+            exportSettingsSpecified;
     }
 };
 
@@ -174,22 +326,55 @@ struct Arguments
 class ProgrammerSelector
 {
 public:
-    void specifySerialNumber(const std::string & serialNumber)
+    // Restricts the selection to programmers whose serial numbers match any
+    // of the specified serial numbers or patterns.
+    void specifySerialNumbers(const std::vector<std::string> & serialNumbers)
+    {
+        assert(!listInitialized);
+        this->serialNumbers = serialNumbers;
+    }
+
+    void useDescriptorCache(const std::string & path)
     {
         assert(!listInitialized);
-        this->serialNumber = serialNumber;
-        this->serialNumberSpecified = true;
+        cache.reset(new ProgrammerDescriptorCache(path));
     }
 
+#ifndef _WIN32
+    // Gets the list of programmers from the daemon and talks to them through
+    // it instead of using USB directly.
+    void useDaemon(std::shared_ptr<ProgrammerDaemonClient> client)
+    {
+        assert(!listInitialized);
+        daemon = client;
+    }
+#endif
+
     std::vector<ProgrammerInstance> listProgrammers()
     {
         if (listInitialized) { return list; }
 
         list.clear();
-        for (const ProgrammerInstance & instance : programmerGetList())
+        std::vector<ProgrammerInstance> fullList;
+#ifndef _WIN32
+        if (daemon)
+        {
+            daemonDevices = daemon->getList();
+            for (const ProgrammerDaemonDevice & device : daemonDevices)
+            {
+                fullList.push_back(device.instance);
+            }
+        }
+        else
+#endif
+        {
+            fullList = programmerGetList();
+        }
+        if (cache) { cache->prune(fullList); }
+        for (const ProgrammerInstance & instance : fullList)
         {
-            if (serialNumberSpecified &&
-                instance.getSerialNumber() != serialNumber)
+            if (!serialNumbers.empty() &&
+                !matchesSerialNumbers(instance.getSerialNumber()))
             {
                 continue;
             }
@@ -202,7 +387,22 @@ public:
 
     ProgrammerInstance selectProgrammer()
     {
-        if (programmer) { return programmer; }
+        // Programmers from the daemon have no USB interface, so they are
+        // false even though they are valid.
+        if (programmerSelected) { return programmer; }
+
+        if (serialNumbers.size() == 1 && !hasWildcards(serialNumbers[0]) &&
+            !listInitialized && !usingDaemon())
+        {
+            // This is faster than getting the whole list.
+            programmer = programmerFindBySerial(serialNumbers[0]);
+            if (!programmer)
+            {
+                throw deviceNotFoundError();
+            }
+            programmerSelected = true;
+            return programmer;
+        }
 
         auto list = listProgrammers();
         if (list.size() == 0)
@@ -216,19 +416,270 @@ public:
         }
 
         programmer = list[0];
+        programmerSelected = true;
         return programmer;
     }
 
+    // Returns every programmer that matches the specified serial numbers and
+    // patterns, or every programmer if none were specified.  A serial number
+    // without wildcards that matches nothing is an error, even if other
+    // programmers were found.
+    std::vector<ProgrammerInstance> selectProgrammers()
+    {
+        auto list = listProgrammers();
+
+        for (const std::string & serialNumber : serialNumbers)
+        {
+            if (hasWildcards(serialNumber)) { continue; }
+
+            bool found = false;
+            for (const ProgrammerInstance & instance : list)
+            {
+                if (instance.getSerialNumber() == serialNumber) { found = true; }
+            }
+            if (!found)
+            {
+                throw ExceptionWithExitCode(PAVRPGM_ERROR_DEVICE_NOT_FOUND,
+                    "No programmer was found with serial number '" +
+                    serialNumber + "'.");
+            }
+        }
+
+        if (list.size() == 0)
+        {
+            throw deviceNotFoundError();
+        }
+        return list;
+    }
+
+    // Gets the serial port names of the selected programmer, from the
+    // descriptor cache if possible.
+    ProgrammerDescriptorCacheEntry getPortNames()
+    {
+        ProgrammerInstance instance = selectProgrammer();
+        ProgrammerDescriptorCacheEntry entry;
+        if (usingDaemon())
+        {
+            entry = tryGetPortNames(instance);
+            if (entry.programmingPortName.empty() || entry.ttlPortName.empty())
+            {
+                throw std::runtime_error(
+                    "The daemon could not determine the serial port names.");
+            }
+            return entry;
+        }
+
+        if (cache && cache->lookup(instance, entry) &&
+            entry.programmingPortName.size() && entry.ttlPortName.size())
+        {
+            return entry;
+        }
+
+        entry.programmingPortName = instance.getProgrammingPortName();
+        entry.ttlPortName = instance.getTtlPortName();
+        if (cache) { cache->store(instance, entry); }
+        return entry;
+    }
+
+    // Gets the serial port names of a programmer for showing in its status.
+    // The names that could not be determined are empty.
+    // This can be called from several threads at once.
+    ProgrammerDescriptorCacheEntry tryGetPortNames(
+        const ProgrammerInstance & instance)
+    {
+        ProgrammerDescriptorCacheEntry entry;
+#ifndef _WIN32
+        if (daemon)
+        {
+            for (const ProgrammerDaemonDevice & device : daemonDevices)
+            {
+                if (device.instance.getSerialNumber() == instance.getSerialNumber())
+                {
+                    entry.programmingPortName = device.programmingPortName;
+                    entry.ttlPortName = device.ttlPortName;
+                }
+            }
+            return entry;
+        }
+#endif
+
+        try
+        {
+            entry.programmingPortName = instance.getProgrammingPortName();
+        }
+        catch (const libusbp::error &) { }
+        try
+        {
+            entry.ttlPortName = instance.getTtlPortName();
+        }
+        catch (const libusbp::error &) { }
+        return entry;
+    }
+
+    // Returns a transport for talking to a programmer, through the daemon if
+    // we are using it.
+    std::shared_ptr<ProgrammerTransport> openTransport(
+        const ProgrammerInstance & instance)
+    {
+#ifndef _WIN32
+        if (daemon)
+        {
+            return std::make_shared<ProgrammerDaemonTransport>(daemon,
+                instance.getSerialNumber());
+        }
+#endif
+        return std::make_shared<ProgrammerUsbTransport>(instance.usbInterface);
+    }
+
+    // This can be called from several threads at once.
+    ProgrammerHandle openHandle(const ProgrammerInstance & instance)
+    {
+        if (usingDaemon())
+        {
+            return ProgrammerHandle(instance, openTransport(instance));
+        }
+        return ProgrammerHandle(instance);
+    }
+
+    // Finds the programmer with the specified serial number again and opens
+    // it, or returns a closed handle if it is not connected.  This is used to
+    // reconnect after the programmer re-enumerates.
+    ProgrammerHandle reopenProgrammer(const std::string & serialNumber)
+    {
+#ifndef _WIN32
+        if (daemon)
+        {
+            for (const ProgrammerDaemonDevice & device : daemon->getList())
+            {
+                if (device.instance.getSerialNumber() == serialNumber)
+                {
+                    return openHandle(device.instance);
+                }
+            }
+            return ProgrammerHandle();
+        }
+#endif
+
+        ProgrammerInstance instance = programmerFindBySerial(serialNumber);
+        if (!instance) { return ProgrammerHandle(); }
+        return ProgrammerHandle(instance);
+    }
+
+    // Gets the firmware version string of the programmer, from the daemon or
+    // the descriptor cache if possible.
+    // This can be called from several threads at once.
+    std::string getFirmwareVersionString(ProgrammerHandle & handle)
+    {
+        const ProgrammerInstance & instance = handle.getInstance();
+#ifndef _WIN32
+        if (daemon)
+        {
+            return daemon->getFirmwareVersionString(instance.getSerialNumber());
+        }
+#endif
+        if (!cache || !instance)
+        {
+            return handle.getFirmwareVersionString();
+        }
+
+        ProgrammerDescriptorCacheEntry entry;
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            if (cache->lookup(instance, entry) && entry.firmwareVersionString.size())
+            {
+                return entry.firmwareVersionString;
+            }
+        }
+
+        entry.firmwareVersionString = handle.getFirmwareVersionString();
+
+        // A question mark means reading the modification string failed, so
+        // don't remember that.
+        if (entry.firmwareVersionString.back() != '?')
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            cache->store(instance, entry);
+        }
+        return entry.firmwareVersionString;
+    }
+
+    // These read the programmer with the daemon's handle if we are using the
+    // daemon, which takes one request to the daemon instead of one for each
+    // control transfer.
+    // They can be called from several threads at once.
+    ProgrammerSettings getSettings(ProgrammerHandle & handle)
+    {
+#ifndef _WIN32
+        if (daemon)
+        {
+            return daemon->getSettings(handle.getInstance().getSerialNumber());
+        }
+#endif
+        return handle.getSettings();
+    }
+
+    ProgrammerVariables getVariables(ProgrammerHandle & handle)
+    {
+#ifndef _WIN32
+        if (daemon)
+        {
+            return daemon->getVariables(handle.getInstance().getSerialNumber());
+        }
+#endif
+        return handle.getVariables();
+    }
+
+    ProgrammerDigitalReadings digitalRead(ProgrammerHandle & handle)
+    {
+#ifndef _WIN32
+        if (daemon)
+        {
+            return daemon->digitalRead(handle.getInstance().getSerialNumber());
+        }
+#endif
+        return handle.digitalRead();
+    }
+
+    void saveDescriptorCache()
+    {
+        if (cache) { cache->save(); }
+    }
+
 private:
 
+    bool usingDaemon() const
+    {
+#ifndef _WIN32
+        return (bool)daemon;
+#else
+        return false;
+#endif
+    }
+
+    bool matchesSerialNumbers(const std::string & serialNumber) const
+    {
+        for (const std::string & pattern : serialNumbers)
+        {
+            if (matchesPattern(serialNumber.c_str(), pattern.c_str()))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
     std::string deviceNotFoundMessage() const
     {
         std::string r = "No programmer was found";
 
-        if (serialNumberSpecified)
+        if (serialNumbers.size() == 1 && !hasWildcards(serialNumbers[0]))
         {
             r += std::string(" with serial number '") +
-                serialNumber + "'";
+                serialNumbers[0] + "'";
+        }
+        else if (serialNumbers.size())
+        {
+            r += " matching the specified serial numbers";
         }
 
         r += ".";
@@ -249,13 +700,21 @@ private:
             "or disconnect the others.");
     }
 
-    bool serialNumberSpecified = false;
-    std::string serialNumber;
+    std::vector<std::string> serialNumbers;
 
     bool listInitialized = false;
     std::vector<ProgrammerInstance> list;
 
+    bool programmerSelected = false;
     ProgrammerInstance programmer;
+
+    std::unique_ptr<ProgrammerDescriptorCache> cache;
+    std::mutex cacheMutex;
+
+#ifndef _WIN32
+    std::shared_ptr<ProgrammerDaemonClient> daemon;
+    std::vector<ProgrammerDaemonDevice> daemonDevices;
+#endif
 };
 
 // Converts a string to an unsigned long, returning true if there is an error.
@@ -362,8 +821,7 @@ static void parseArgSerialNumber(ArgReader & argReader, Arguments & args)
             "An empty serial number was specified.");
     }
 
-    args.serialNumberSpecified = true;
-    args.serialNumber = valueCStr;
+    args.serialNumbers.push_back(valueCStr);
 }
 
 static void parseArgString(ArgReader & argReader, std::string & str)
@@ -378,6 +836,20 @@ static void parseArgString(ArgReader & argReader, std::string & str)
     str = valueCStr;
 }
 
+static void parseArgFrequency(ArgReader & argReader, std::string & frequency)
+{
+    parseArgString(argReader, frequency);
+
+    std::string number;
+    double unitHz;
+    if (!Programmer::splitFrequency(frequency, number, unitHz))
+    {
+        throw ExceptionWithExitCode(PAVRPGM_ERROR_BAD_ARGS,
+            "The frequency after '" + std::string(argReader.last()) +
+            "' is invalid.");
+    }
+}
+
 static void parseArgRegulatorMode(ArgReader & argReader, Arguments & args)
 {
     const char * valueCStr = argReader.next();
@@ -452,6 +924,73 @@ static void parseArgVccOutputIndicator(ArgReader & argReader, Arguments & args)
     }
 }
 
+// Parses the optional rate after --watch.  The next argument is only consumed
+// if it looks like a number, so "--watch -s" still works.
+static void parseArgWatchRate(ArgReader & argReader, Arguments & args)
+{
+    const char * valueCStr = argReader.peek();
+    if (valueCStr == NULL ||
+        !(std::isdigit((unsigned char)valueCStr[0]) || valueCStr[0] == '.'))
+    {
+        return;
+    }
+    argReader.next();
+
+    char * end;
+    double rate = strtod(valueCStr, &end);
+    if (*end != 0 || !std::isfinite(rate) || rate <= 0)
+    {
+        throw ExceptionWithExitCode(PAVRPGM_ERROR_BAD_ARGS,
+            "The rate after '" + std::string(argReader.last()) + "' is invalid.");
+    }
+    if (rate > WATCH_MAX_RATE)
+    {
+        throw ExceptionWithExitCode(PAVRPGM_ERROR_BAD_ARGS,
+            "The rate after '" + std::string(argReader.last()) +
+            "' is too large.  The maximum is " +
+            std::to_string(WATCH_MAX_RATE) + ".");
+    }
+    args.watchRate = rate;
+}
+
+static void parseArgStatusFormat(ArgReader & argReader, Arguments & args)
+{
+    const char * valueCStr = argReader.next();
+    std::string value = valueCStr == NULL ? "" : valueCStr;
+
+    if (value == "text" || value == "json" || value == "yaml" || value == "kv")
+    {
+        args.statusFormat = value;
+    }
+    else
+    {
+        throw ExceptionWithExitCode(PAVRPGM_ERROR_BAD_ARGS,
+            "Expected 'text', 'json', 'yaml', or 'kv' after '"
+            + std::string(argReader.last()) + "'.");
+    }
+}
+
+static void parseArgWatchFormat(ArgReader & argReader, Arguments & args)
+{
+    const char * valueCStr = argReader.next();
+    std::string value = valueCStr == NULL ? "" : valueCStr;
+
+    if (value == "csv" || value == "CSV")
+    {
+        args.watchJson = false;
+    }
+    else if (value == "json" || value == "JSON")
+    {
+        args.watchJson = true;
+    }
+    else
+    {
+        throw ExceptionWithExitCode(PAVRPGM_ERROR_BAD_ARGS,
+            "Expected 'csv' or 'json' after '"
+            + std::string(argReader.last()) + "'.");
+    }
+}
+
 // [all-settings]
 static Arguments parseArgs(int argc, char ** argv)
 {
@@ -472,6 +1011,10 @@ static Arguments parseArgs(int argc, char ** argv)
         {
             parseArgSerialNumber(argReader, args);
         }
+        else if (arg == "--all")
+        {
+            args.all = true;
+        }
         else if (arg == "-s" || arg == "--status")
         {
             args.showStatus = true;
@@ -480,6 +1023,10 @@ static Arguments parseArgs(int argc, char ** argv)
         {
             args.showList = true;
         }
+        else if (arg == "--format")
+        {
+            parseArgStatusFormat(argReader, args);
+        }
         else if (arg == "--regulator-mode")
         {
             parseArgRegulatorMode(argReader, args);
@@ -494,12 +1041,12 @@ static Arguments parseArgs(int argc, char ** argv)
         }
         else if (arg == "--freq")
         {
-            parseArgString(argReader, args.frequencyName);
+            parseArgFrequency(argReader, args.frequencyName);
             args.frequencySpecified = true;
         }
         else if (arg == "--max-freq")
         {
-            parseArgString(argReader, args.maxFrequencyName);
+            parseArgFrequency(argReader, args.maxFrequencyName);
             args.maxFrequencySpecified = true;
         }
         else if (arg == "--line-a")
@@ -556,6 +1103,16 @@ static Arguments parseArgs(int argc, char ** argv)
         {
             args.restoreDefaults = true;
         }
+        else if (arg == "--import-settings")
+        {
+            parseArgString(argReader, args.importSettingsFile);
+            args.importSettingsSpecified = true;
+        }
+        else if (arg == "--export-settings")
+        {
+            parseArgString(argReader, args.exportSettingsFile);
+            args.exportSettingsSpecified = true;
+        }
         else if (arg == "--prog-port")
         {
             args.printProgrammingPort = true;
@@ -573,6 +1130,48 @@ static Arguments parseArgs(int argc, char ** argv)
         {
             args.digitalRead = true;
         }
+        else if (arg == "--watch")
+        {
+            args.watch = true;
+            parseArgWatchRate(argReader, args);
+        }
+        else if (arg == "--watch-format")
+        {
+            parseArgWatchFormat(argReader, args);
+        }
+        else if (arg == "--watch-count")
+        {
+            parseArgUInt32(argReader, args.watchCount);
+            args.watchCountSpecified = true;
+        }
+        else if (arg == "--stats")
+        {
+            args.showStats = true;
+        }
+        else if (arg == "--cache")
+        {
+            args.useCache = true;
+        }
+#ifndef _WIN32
+        else if (arg == "--no-daemon")
+        {
+            args.noDaemon = true;
+        }
+#endif
+        else if (arg == "--record-trace")
+        {
+            parseArgString(argReader, args.recordTraceFile);
+            args.recordTraceSpecified = true;
+        }
+        else if (arg == "--replay-trace")
+        {
+            parseArgString(argReader, args.replayTraceFile);
+            args.replayTraceSpecified = true;
+        }
+        else if (arg == "--replay-timing")
+        {
+            args.replayTiming = true;
+        }
         else
         {
             throw ExceptionWithExitCode(PAVRPGM_ERROR_BAD_ARGS,
@@ -582,35 +1181,89 @@ static Arguments parseArgs(int argc, char ** argv)
     return args;
 }
 
-static void adjustArguments(Arguments & args)
+static ProgrammerSettingsProfile loadSettingsProfile(const std::string & fileName)
 {
-    if (!args.actionSpecified())
+    try
     {
-        // The user did not explicitly specify an action on the command-line.
-        // Show the help screen.
-        args.showHelp = true;
+        if (fileName == "-")
+        {
+            std::string text((std::istreambuf_iterator<char>(std::cin)),
+                std::istreambuf_iterator<char>());
+            return ProgrammerSettingsProfile::parse(text);
+        }
+        return ProgrammerSettingsProfile::load(fileName);
+    }
+    catch (const std::runtime_error & error)
+    {
+        throw ExceptionWithExitCode(PAVRPGM_ERROR_BAD_ARGS, error.what());
     }
 }
 
-static void printProgrammerList(ProgrammerSelector & selector)
+static void adjustArguments(Arguments & args)
 {
-    for (const ProgrammerInstance & instance : selector.listProgrammers())
+    if (args.recordTraceSpecified && args.replayTraceSpecified)
     {
-        std::cout << std::left << std::setfill(' ');
-        std::cout << std::setw(17) << instance.getSerialNumber() + "," << " ";
-        std::cout << std::setw(45) << instance.getName();
-        std::cout << std::endl;
+        throw ExceptionWithExitCode(PAVRPGM_ERROR_BAD_ARGS,
+            "The --record-trace and --replay-trace options cannot be used together.");
     }
-}
+
+    if (args.multipleProgrammers())
+    {
+        if (args.recordTraceSpecified || args.replayTraceSpecified)
+        {
+            throw ExceptionWithExitCode(PAVRPGM_ERROR_BAD_ARGS,
+                "Traces can only be used with one programmer.");
+        }
+        if (args.watch)
+        {
+            throw ExceptionWithExitCode(PAVRPGM_ERROR_BAD_ARGS,
+                "The --watch option can only be used with one programmer.");
+        }
+        if (args.exportSettingsSpecified)
+        {
+            throw ExceptionWithExitCode(PAVRPGM_ERROR_BAD_ARGS,
+                "The --export-settings option can only be used with one programmer.");
+        }
+        if (args.printProgrammingPort || args.printTtlPort)
+        {
+            throw ExceptionWithExitCode(PAVRPGM_ERROR_BAD_ARGS,
+                "The --prog-port and --ttl-port options can only be used with one programmer.");
+        }
+    }
+
+    // Read the profile before talking to any programmers so that a mistake
+    // in it does not leave some of them changed.
+    if (args.importSettingsSpecified)
+    {
+        args.importProfile = loadSettingsProfile(args.importSettingsFile);
+    }
+
+    if (!args.actionSpecified())
+    {
+        // The user did not explicitly specify an action on the command-line.
+        // Show the help screen.
+        args.showHelp = true;
+    }
+}
+
+static void printProgrammerList(ProgrammerSelector & selector)
+{
+    for (const ProgrammerInstance & instance : selector.listProgrammers())
+    {
+        std::cout << std::left << std::setfill(' ');
+        std::cout << std::setw(17) << instance.getSerialNumber() + "," << " ";
+        std::cout << std::setw(45) << instance.getName();
+        std::cout << std::endl;
+    }
+}
 
 // [all-settings]
-static void printProgrammerStatus(ProgrammerSelector & selector)
+static std::string formatStatusText(const ProgrammerInstance & instance,
+    const std::string & firmwareVersion,
+    const ProgrammerDescriptorCacheEntry & portNames,
+    const ProgrammerSettings & settings, const ProgrammerVariables & variables)
 {
-    ProgrammerInstance instance = selector.selectProgrammer();
-    ProgrammerHandle handle(instance);
-    std::string firmwareVersion = handle.getFirmwareVersionString();
-    ProgrammerSettings settings = handle.getSettings();
-    ProgrammerVariables variables = handle.getVariables();
+    std::ostringstream out;
 
     // The output here is compatible with YAML so that people can more easily
     // write scripts that use it.
@@ -623,169 +1276,591 @@ static void printProgrammerStatus(ProgrammerSelector & selector)
     std::string maxFrequency = Programmer::getMaxFrequencyName(
         settings.ispFastestPeriod);
 
-    std::cout << std::left << std::setfill(' ');
+    out << std::left << std::setfill(' ');
 
-    std::cout << leftColumn << "Name: "
-              << handle.getInstance().getName() << std::endl;
+    out << leftColumn << "Name: "
+        << instance.getName() << '\n';
 
-    std::cout << leftColumn << "Serial number: "
-              << handle.getInstance().getSerialNumber() << std::endl;
+    out << leftColumn << "Serial number: "
+        << instance.getSerialNumber() << '\n';
 
-    std::cout << leftColumn << "Firmware version: "
-              << firmwareVersion << std::endl;
+    out << leftColumn << "Firmware version: "
+        << firmwareVersion << '\n';
 
-    std::cout << leftColumn << "Programming port: "
-              << handle.getInstance().tryGetProgrammingPortName() << std::endl;
+    out << leftColumn << "Programming port: "
+        << (portNames.programmingPortName.empty() ? "(unknown)" :
+            portNames.programmingPortName) << '\n';
 
-    std::cout << leftColumn << "TTL port: "
-              << handle.getInstance().tryGetTtlPortName() << std::endl;
+    out << leftColumn << "TTL port: "
+        << (portNames.ttlPortName.empty() ? "(unknown)" :
+            portNames.ttlPortName) << '\n';
 
-    std::cout << std::endl;
+    out << '\n';
 
-    std::cout << "Settings:" << std::endl;
+    out << "Settings:" << '\n';
 
-    std::cout << leftColumn << "  ISP frequency (kHz): "
-              << frequency << std::endl;
+    out << leftColumn << "  ISP frequency (kHz): "
+        << frequency << '\n';
 
-    std::cout << leftColumn << "  Max ISP frequency (kHz): "
-              << maxFrequency << std::endl;
+    out << leftColumn << "  Max ISP frequency (kHz): "
+        << maxFrequency << '\n';
 
-    std::cout << leftColumn << "  Regulator mode: "
-              << Programmer::convertRegulatorModeToString(settings.regulatorMode)
-              << std::endl;
+    out << leftColumn << "  Regulator mode: "
+        << Programmer::convertRegulatorModeToString(settings.regulatorMode)
+        << '\n';
 
-    std::cout << leftColumn << "  VCC output: "
-              << (settings.vccOutputEnabled ? "Enabled" : "Disabled") << std::endl;
+    out << leftColumn << "  VCC output: "
+        << (settings.vccOutputEnabled ? "Enabled" : "Disabled") << '\n';
 
-    std::cout << leftColumn << "  VCC output indicator: "
-              << (settings.vccOutputIndicator ? "Steady" : "Blinking") << std::endl;
+    out << leftColumn << "  VCC output indicator: "
+        << (settings.vccOutputIndicator ? "Steady" : "Blinking") << '\n';
 
-    std::cout << leftColumn << "  Line A function: "
-              << Programmer::convertLineFunctionToString(settings.lineAFunction)
-              << std::endl;
+    out << leftColumn << "  Line A function: "
+        << Programmer::convertLineFunctionToString(settings.lineAFunction)
+        << '\n';
 
-    std::cout << leftColumn << "  Line B function: "
-              << Programmer::convertLineFunctionToString(settings.lineBFunction)
-              << std::endl;
+    out << leftColumn << "  Line B function: "
+        << Programmer::convertLineFunctionToString(settings.lineBFunction)
+        << '\n';
 
-    std::cout << leftColumn << "  VCC/VDD maximum range (mV): "
-              << settings.vccVddMaxRange << std::endl;
+    out << leftColumn << "  VCC/VDD maximum range (mV): "
+        << settings.vccVddMaxRange << '\n';
 
-    std::cout << leftColumn << "  VCC 3.3 V minimum (mV): "
-              << settings.vcc3v3Min << std::endl;
+    out << leftColumn << "  VCC 3.3 V minimum (mV): "
+        << settings.vcc3v3Min << '\n';
 
-    std::cout << leftColumn << "  VCC 3.3 V maximum (mV): "
-              << settings.vcc3v3Max << std::endl;
+    out << leftColumn << "  VCC 3.3 V maximum (mV): "
+        << settings.vcc3v3Max << '\n';
 
-    std::cout << leftColumn << "  VCC 5 V minimum (mV): "
-              << settings.vcc5vMin << std::endl;
+    out << leftColumn << "  VCC 5 V minimum (mV): "
+        << settings.vcc5vMin << '\n';
 
-    std::cout << leftColumn << "  VCC 5 V maximum (mV): "
-              << settings.vcc5vMax << std::endl;
+    out << leftColumn << "  VCC 5 V maximum (mV): "
+        << settings.vcc5vMax << '\n';
 
-    std::cout << std::hex << std::uppercase;
+    out << std::hex << std::uppercase;
 
-    std::cout << leftColumn << "  STK500 hardware version: "
-              << settings.hardwareVersion << std::endl;
+    out << leftColumn << "  STK500 hardware version: "
+        << settings.hardwareVersion << '\n';
 
-    std::cout << leftColumn << "  STK500 software version: "
-              << settings.softwareVersionMajor << "."
-              << settings.softwareVersionMinor << std::endl;
+    out << leftColumn << "  STK500 software version: "
+        << settings.softwareVersionMajor << "."
+        << settings.softwareVersionMinor << '\n';
 
-    std::cout << std::dec;
+    out << std::dec;
 
-    std::cout << std::endl;
+    out << '\n';
 
     if (variables.hasResultsFromLastProgramming)
     {
-        std::cout << "Results from last programming:" << std::endl;
-        std::cout << leftColumn << "  Programming error: "
-                  << Programmer::convertProgrammingErrorToShortString(variables.programmingError)
-                  << std::endl;
-        std::cout << leftColumn << "  Target VCC measured minimum (mV): "
-                  << variables.targetVccMeasuredMinMv
-                  << std::endl;
-        std::cout << leftColumn << "  Target VCC measured maximum (mV): "
-                  << variables.targetVccMeasuredMaxMv
-                  << std::endl;
-        std::cout << leftColumn << "  Programmer VDD measured minimum (mV): "
-                  << variables.programmerVddMeasuredMinMv
-                  << std::endl;
-        std::cout << leftColumn << "  Programmer VDD measured maximum (mV): "
-                  << variables.programmerVddMeasuredMaxMv
-                  << std::endl;
+        out << "Results from last programming:" << '\n';
+        out << leftColumn << "  Programming error: "
+            << Programmer::convertProgrammingErrorToShortString(variables.programmingError)
+            << '\n';
+        out << leftColumn << "  Target VCC measured minimum (mV): "
+            << variables.targetVccMeasuredMinMv
+            << '\n';
+        out << leftColumn << "  Target VCC measured maximum (mV): "
+            << variables.targetVccMeasuredMaxMv
+            << '\n';
+        out << leftColumn << "  Programmer VDD measured minimum (mV): "
+            << variables.programmerVddMeasuredMinMv
+            << '\n';
+        out << leftColumn << "  Programmer VDD measured maximum (mV): "
+            << variables.programmerVddMeasuredMaxMv
+            << '\n';
     }
     else
     {
-        std::cout << leftColumn << "Results from last programming: "
-                  << "N/A" << std::endl;
+        out << leftColumn << "Results from last programming: "
+            << "N/A" << '\n';
     }
 
-    std::cout << std::endl;
+    out << '\n';
 
-    std::cout << "Current status:" << std::endl;
-    std::cout << leftColumn << "  Target VCC (mV): "
-              << variables.targetVccMv
-              << std::endl;
-    std::cout << leftColumn << "  Programmer VDD (mV): "
-              << variables.programmerVddMv
-              << std::endl;
-    std::cout << leftColumn << "  VDD regulator set point: "
-              << Programmer::convertRegulatorLevelToString(variables.regulatorLevel)
-              << std::endl;
+    out << "Current status:" << '\n';
+    out << leftColumn << "  Target VCC (mV): "
+        << variables.targetVccMv
+        << '\n';
+    out << leftColumn << "  Programmer VDD (mV): "
+        << variables.programmerVddMv
+        << '\n';
+    out << leftColumn << "  VDD regulator set point: "
+        << Programmer::convertRegulatorLevelToString(variables.regulatorLevel)
+        << '\n';
 
-    std::cout << leftColumn << "  Last device reset: "
-              << Programmer::convertDeviceResetToString(variables.lastDeviceReset)
-              << std::endl;
+    out << leftColumn << "  Last device reset: "
+        << Programmer::convertDeviceResetToString(variables.lastDeviceReset)
+        << '\n';
+
+    return out.str();
+}
+
+// Holds the values shown by --status so they can be written as JSON, YAML, or
+// key=value lines.  Each value belongs to the top level or to one section.
+// Values that are strings get quoted in JSON and YAML; the others (numbers,
+// true, false, and null) are written as they are.
+class StatusDocument
+{
+public:
+    void beginSection(const std::string & name)
+    {
+        section = name;
+    }
+
+    void endSection()
+    {
+        section.clear();
+    }
+
+    void addString(const std::string & key, const std::string & value)
+    {
+        fields.push_back(Field { section, key, value, true });
+    }
+
+    void addNumber(const std::string & key, uint32_t value)
+    {
+        fields.push_back(Field { section, key, std::to_string(value), false });
+    }
+
+    void addBool(const std::string & key, bool value)
+    {
+        fields.push_back(Field { section, key, value ? "true" : "false", false });
+    }
+
+    void addNull(const std::string & key)
+    {
+        fields.push_back(Field { section, key, "null", false });
+    }
+
+    std::string toJson() const
+    {
+        std::ostringstream out;
+        out << "{";
+        std::string openSection;
+        bool first = true;
+        for (const Field & field : fields)
+        {
+            if (field.section != openSection)
+            {
+                if (!openSection.empty()) { out << "\n  }"; }
+                openSection = field.section;
+                if (!openSection.empty())
+                {
+                    out << (first ? "" : ",") << "\n  "
+                        << quote(openSection) << ": {";
+                    first = true;
+                }
+            }
+            out << (first ? "" : ",") << "\n"
+                << (openSection.empty() ? "  " : "    ")
+                << quote(field.key) << ": " << formatValue(field);
+            first = false;
+        }
+        if (!openSection.empty()) { out << "\n  }"; }
+        out << "\n}\n";
+        return out.str();
+    }
+
+    std::string toYaml() const
+    {
+        std::ostringstream out;
+        std::string openSection;
+        for (const Field & field : fields)
+        {
+            if (field.section != openSection)
+            {
+                openSection = field.section;
+                if (!openSection.empty()) { out << openSection << ":\n"; }
+            }
+            out << (openSection.empty() ? "" : "  ")
+                << field.key << ": " << formatValue(field) << "\n";
+        }
+        return out.str();
+    }
+
+    // Writes one "section.key=value" line per value.  Strings are not quoted
+    // and null is written as nothing.
+    std::string toKeyValue() const
+    {
+        std::ostringstream out;
+        for (const Field & field : fields)
+        {
+            if (!field.section.empty()) { out << field.section << "."; }
+            out << field.key << "=";
+            if (field.quoted || field.value != "null") { out << field.value; }
+            out << "\n";
+        }
+        return out.str();
+    }
+
+private:
+    struct Field
+    {
+        std::string section;
+        std::string key;
+        std::string value;
+        bool quoted;
+    };
+
+    // Quotes a string for JSON.  The result is also a valid YAML string.
+    static std::string quote(const std::string & str)
+    {
+        std::string r = "\"";
+        for (char c : str)
+        {
+            if (c == '"' || c == '\\')
+            {
+                r += '\\';
+                r += c;
+            }
+            else if ((unsigned char)c < 0x20)
+            {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char)c);
+                r += escape;
+            }
+            else
+            {
+                r += c;
+            }
+        }
+        r += '"';
+        return r;
+    }
+
+    static std::string formatValue(const Field & field)
+    {
+        return field.quoted ? quote(field.value) : field.value;
+    }
+
+    std::string section;
+    std::vector<Field> fields;
+};
+
+static void addPortName(StatusDocument & doc, const std::string & key,
+    const std::string & portName)
+{
+    if (portName.empty())
+    {
+        doc.addNull(key);
+    }
+    else
+    {
+        doc.addString(key, portName);
+    }
+}
+
+// [all-settings]
+static StatusDocument buildStatusDocument(const ProgrammerInstance & instance,
+    const std::string & firmwareVersion,
+    const ProgrammerDescriptorCacheEntry & portNames,
+    const ProgrammerSettings & settings, const ProgrammerVariables & variables)
+{
+    StatusDocument doc;
+
+    doc.addString("name", instance.getName());
+    doc.addString("serial_number", instance.getSerialNumber());
+    doc.addString("firmware_version", firmwareVersion);
+    addPortName(doc, "programming_port", portNames.programmingPortName);
+    addPortName(doc, "ttl_port", portNames.ttlPortName);
+
+    doc.beginSection("settings");
+    doc.addString("isp_frequency_khz", Programmer::getFrequencyName(
+        settings.sckDuration, settings.ispFastestPeriod));
+    doc.addString("max_isp_frequency_khz", Programmer::getMaxFrequencyName(
+        settings.ispFastestPeriod));
+    doc.addString("regulator_mode",
+        Programmer::convertRegulatorModeToCString(settings.regulatorMode));
+    doc.addBool("vcc_output_enabled", settings.vccOutputEnabled);
+    doc.addString("vcc_output_indicator",
+        settings.vccOutputIndicator ? "steady" : "blinking");
+    doc.addString("line_a_function",
+        Programmer::convertLineFunctionToCString(settings.lineAFunction));
+    doc.addString("line_b_function",
+        Programmer::convertLineFunctionToCString(settings.lineBFunction));
+    doc.addNumber("vcc_vdd_max_range_mv", settings.vccVddMaxRange);
+    doc.addNumber("vcc_3v3_min_mv", settings.vcc3v3Min);
+    doc.addNumber("vcc_3v3_max_mv", settings.vcc3v3Max);
+    doc.addNumber("vcc_5v_min_mv", settings.vcc5vMin);
+    doc.addNumber("vcc_5v_max_mv", settings.vcc5vMax);
+    doc.addNumber("stk500_hardware_version", settings.hardwareVersion);
+    doc.addNumber("stk500_software_version_major", settings.softwareVersionMajor);
+    doc.addNumber("stk500_software_version_minor", settings.softwareVersionMinor);
+    doc.endSection();
+
+    if (variables.hasResultsFromLastProgramming)
+    {
+        doc.beginSection("last_programming");
+        doc.addString("programming_error",
+            Programmer::convertProgrammingErrorToShortString(variables.programmingError));
+        doc.addNumber("target_vcc_measured_min_mv", variables.targetVccMeasuredMinMv);
+        doc.addNumber("target_vcc_measured_max_mv", variables.targetVccMeasuredMaxMv);
+        doc.addNumber("programmer_vdd_measured_min_mv", variables.programmerVddMeasuredMinMv);
+        doc.addNumber("programmer_vdd_measured_max_mv", variables.programmerVddMeasuredMaxMv);
+        doc.endSection();
+    }
+    else
+    {
+        doc.addNull("last_programming");
+    }
+
+    doc.beginSection("status");
+    doc.addNumber("target_vcc_mv", variables.targetVccMv);
+    doc.addNumber("programmer_vdd_mv", variables.programmerVddMv);
+    doc.addString("regulator_level",
+        Programmer::convertRegulatorLevelToCString(variables.regulatorLevel));
+    doc.addString("last_device_reset",
+        Programmer::convertDeviceResetToString(variables.lastDeviceReset));
+    doc.endSection();
+
+    return doc;
+}
+
+static void addDigitalReadings(StatusDocument & doc,
+    const ProgrammerDigitalReadings & readings)
+{
+    doc.beginSection("digital_readings");
+    doc.addString("port_a", std::bitset<8>(readings.portA).to_string());
+    doc.addString("port_b", std::bitset<8>(readings.portB).to_string());
+    doc.addString("port_c", std::bitset<8>(readings.portC).to_string());
+    doc.endSection();
+}
+
+static void addRequestStats(StatusDocument & doc, const std::string & name,
+    const ProgrammerRequestStats & stats)
+{
+    const ProgrammerLatencyHistogram & latency = stats.latency;
+    if (latency.getCount() == 0) { return; }
+
+    doc.addNumber(name + "_count", (uint32_t)latency.getCount());
+    doc.addNumber(name + "_failures", stats.failures);
+    doc.addNumber(name + "_short", stats.shortTransfers);
+    doc.addNumber(name + "_latency_min_us", latency.getMin());
+    doc.addNumber(name + "_latency_p50_us", latency.getPercentile(50));
+    doc.addNumber(name + "_latency_p90_us", latency.getPercentile(90));
+    doc.addNumber(name + "_latency_p99_us", latency.getPercentile(99));
+    doc.addNumber(name + "_latency_max_us", latency.getMax());
+}
+
+static void addStats(StatusDocument & doc, const ProgrammerStats & stats)
+{
+    doc.beginSection("usb_transfer_stats");
+    addRequestStats(doc, "get_setting", stats.getSetting);
+    addRequestStats(doc, "set_setting", stats.setSetting);
+    addRequestStats(doc, "get_variable", stats.getVariable);
+    addRequestStats(doc, "digital_read", stats.digitalRead);
+    addRequestStats(doc, "get_descriptor", stats.getDescriptor);
+    doc.addNumber("retries", stats.retry.retries);
+    doc.addNumber("recovered", stats.retry.recovered);
+    doc.addNumber("exhausted", stats.retry.exhausted);
+    doc.addNumber("smoothed_rtt_us", stats.retry.smoothedRttUs);
+    doc.addNumber("timeout_ms", stats.retry.timeoutMs);
+    doc.endSection();
+}
+
+static void printProgrammerStatus(ProgrammerSelector & selector,
+    ProgrammerHandle & handle, const Arguments & args, std::ostream & out)
+{
+    const std::string & format = args.statusFormat;
+
+    // Read everything first so the output comes from one consistent snapshot
+    // and a failure does not leave a partial document behind.
+    std::string firmwareVersion = selector.getFirmwareVersionString(handle);
+    ProgrammerSettings settings = selector.getSettings(handle);
+    ProgrammerVariables variables = selector.getVariables(handle);
+    const ProgrammerInstance & instance = handle.getInstance();
+    ProgrammerDescriptorCacheEntry portNames = selector.tryGetPortNames(instance);
+
+    std::string output;
+    if (format == "text")
+    {
+        output = formatStatusText(instance, firmwareVersion, portNames,
+            settings, variables);
+    }
+    else
+    {
+        StatusDocument doc = buildStatusDocument(instance, firmwareVersion,
+            portNames, settings, variables);
+        if (args.digitalRead)
+        {
+            addDigitalReadings(doc, selector.digitalRead(handle));
+        }
+        if (args.showStats)
+        {
+            addStats(doc, handle.getStats());
+        }
+        if (format == "json") { output = doc.toJson(); }
+        else if (format == "yaml") { output = doc.toYaml(); }
+        else { output = doc.toKeyValue(); }
+    }
+
+    // Write the whole document at once.
+    out << output << std::flush;
 }
 
 // Print the name of the programming serial port (e.g. "COM 4").
-void printProgrammingPort(ProgrammerSelector & selector)
+void printProgrammingPort(ProgrammerSelector & selector, std::ostream & out)
 {
-    ProgrammerInstance instance = selector.selectProgrammer();
-    std::string programmingPortName = instance.getProgrammingPortName();
-    std::cout << programmingPortName << std::endl;
+    std::string programmingPortName = selector.getPortNames().programmingPortName;
+    out << programmingPortName << std::endl;
 }
 
-void printTtlPort(ProgrammerSelector & selector)
+void printTtlPort(ProgrammerSelector & selector, std::ostream & out)
 {
-    ProgrammerInstance instance = selector.selectProgrammer();
-    std::string programmingPortName = instance.getTtlPortName();
-    std::cout << programmingPortName << std::endl;
+    std::string ttlPortName = selector.getPortNames().ttlPortName;
+    out << ttlPortName << std::endl;
 }
 
-static void printDigitalReadings(ProgrammerSelector & selector)
+static void printDigitalReadings(ProgrammerSelector & selector,
+    ProgrammerHandle & handle, std::ostream & out)
+{
+    ProgrammerDigitalReadings readings = selector.digitalRead(handle);
+
+    out << "PORTA: " << std::bitset<8>(readings.portA) << std::endl;
+    out << "PORTB: " << std::bitset<8>(readings.portB) << std::endl;
+    out << "PORTC: " << std::bitset<8>(readings.portC) << std::endl;
+}
+
+static volatile std::sig_atomic_t watchInterrupted = 0;
+
+static void handleWatchInterrupt(int)
 {
-    ProgrammerHandle handle(selector.selectProgrammer());
-    ProgrammerDigitalReadings readings = handle.digitalRead();
+    watchInterrupted = 1;
+}
+
+static void writeWatchLine(const char * line, size_t length, size_t size)
+{
+    // The formatter truncates lines that do not fit, but ours always do.
+    if (length >= size) { length = size - 1; }
+    fwrite(line, 1, length, stdout);
+}
+
+// Keeps reading the programmer's variables and printing them with timestamps
+// until the user presses Ctrl+C or the requested number of samples have been
+// printed.  If the programmer disappears, failed samples are printed while we
+// wait for it to come back.
+static void watchVariables(ProgrammerSelector & selector,
+    ProgrammerHandle & handle, const Arguments & args)
+{
+    // Reconnecting would open the real device without the trace recorder or
+    // replayer, so only do it for plain USB or daemon handles.
+    bool usingTrace = args.recordTraceSpecified || args.replayTraceSpecified;
+    ProgrammerReconnectOptions reconnectOptions;
+    if (usingTrace) { reconnectOptions.timeoutMs = 0; }
+    reconnectOptions.open = [&selector](const std::string & serialNumber)
+    {
+        return selector.reopenProgrammer(serialNumber);
+    };
+    ResilientProgrammerHandle watchHandle(handle, reconnectOptions);
+
+    const uint32_t mask = PAVR2_VARIABLE_MASK_ALL;
+    const auto interval = std::chrono::microseconds(
+        (int64_t)std::llround(1000000 / args.watchRate));
+    const auto flushInterval = std::chrono::milliseconds(WATCH_FLUSH_INTERVAL_MS);
+
+    // Anything printed before this with std::cout must come out first.
+    std::cout.flush();
 
-    std::cout << "PORTA: " << std::bitset<8>(readings.portA) << std::endl;
-    std::cout << "PORTB: " << std::bitset<8>(readings.portB) << std::endl;
-    std::cout << "PORTC: " << std::bitset<8>(readings.portC) << std::endl;
+    char line[512];
+    if (!args.watchJson)
+    {
+        size_t length = programmerFormatSampleCsvHeader(line, sizeof(line), mask);
+        writeWatchLine(line, length, sizeof(line));
+    }
+
+    watchInterrupted = 0;
+    auto oldHandler = std::signal(SIGINT, handleWatchInterrupt);
+
+    auto startTime = std::chrono::steady_clock::now();
+    auto nextTime = startTime;
+    auto lastFlushTime = startTime;
+    uint32_t count = 0;
+    while (!watchInterrupted &&
+        !(args.watchCountSpecified && count >= args.watchCount))
+    {
+        ProgrammerSample sample;
+        sample.time = std::chrono::steady_clock::now();
+        try
+        {
+            sample.variables = watchHandle.getVariables(mask);
+        }
+        catch (const std::exception &)
+        {
+            // A replayed trace has simply ended.
+            if (args.replayTraceSpecified) { break; }
+            sample.failed = true;
+        }
+
+        size_t length;
+        if (args.watchJson)
+        {
+            length = programmerFormatSampleJson(line, sizeof(line),
+                sample, startTime);
+        }
+        else
+        {
+            length = programmerFormatSampleCsv(line, sizeof(line), mask,
+                sample, startTime);
+        }
+        writeWatchLine(line, length, sizeof(line));
+        count++;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastFlushTime >= flushInterval)
+        {
+            fflush(stdout);
+            lastFlushTime = now;
+        }
+
+        // If reading took longer than the interval, skip the samples we
+        // missed instead of trying to catch up.
+        nextTime += interval;
+        if (nextTime < now) { nextTime = now; }
+
+        // Sleep in short steps so that Ctrl+C is noticed quickly even at slow
+        // rates.
+        while (!watchInterrupted && now < nextTime)
+        {
+            std::this_thread::sleep_until(std::min(nextTime, now + flushInterval));
+            now = std::chrono::steady_clock::now();
+        }
+    }
+
+    if (oldHandler != SIG_ERR) { std::signal(SIGINT, oldHandler); }
+    fflush(stdout);
 }
 
 // [all-settings]
-static void applySettings(ProgrammerSelector & selector, const Arguments args)
+static void applySettings(ProgrammerHandle & handle, const Arguments args)
 {
     assert(args.settingsSpecified());
 
-    ProgrammerHandle handle(selector.selectProgrammer());
-
+    ProgrammerSettings settings;
     if (args.restoreDefaults)
     {
-        handle.restoreDefaults();
+        settings = handle.restoreDefaults().settings;
+    }
+    else
+    {
+        settings = handle.getSettings();
     }
 
-    ProgrammerSettings settings = handle.getSettings();
+    // The profile only changes our copy of the settings, and applySettings
+    // below only writes the ones that differ from what we just read.
+    if (args.importSettingsSpecified)
+    {
+        args.importProfile.applyTo(settings);
+    }
 
     if (args.maxFrequencySpecified)
     {
-        Programmer::setMaxFrequency(settings, args.maxFrequencyName);
+        Programmer::setFrequencyFromString(settings, args.maxFrequencyName, true);
     }
 
     if (args.frequencySpecified)
     {
-        Programmer::setFrequency(settings, args.frequencyName);
+        Programmer::setFrequencyFromString(settings, args.frequencyName, false);
     }
 
     if (args.regulatorModeSpecified)
@@ -856,6 +1931,254 @@ static void applySettings(ProgrammerSelector & selector, const Arguments args)
     handle.applySettings(settings);
 }
 
+static void printRequestStats(std::ostream & out, const char * name,
+    const ProgrammerRequestStats & stats)
+{
+    const ProgrammerLatencyHistogram & latency = stats.latency;
+    if (latency.getCount() == 0) { return; }
+
+    out << std::left << std::setfill(' ');
+    out << std::setw(20) << (std::string("  ") + name + ":")
+        << "count " << latency.getCount()
+        << ", failures " << stats.failures
+        << ", short " << stats.shortTransfers
+        << ", latency (us) min " << latency.getMin()
+        << ", p50 " << latency.getPercentile(50)
+        << ", p90 " << latency.getPercentile(90)
+        << ", p99 " << latency.getPercentile(99)
+        << ", max " << latency.getMax()
+        << std::endl;
+}
+
+static void printStats(const ProgrammerHandle & handle, std::ostream & out)
+{
+    ProgrammerStats stats = handle.getStats();
+    out << "USB transfer statistics:" << std::endl;
+    printRequestStats(out, "Get setting", stats.getSetting);
+    printRequestStats(out, "Set setting", stats.setSetting);
+    printRequestStats(out, "Get variable", stats.getVariable);
+    printRequestStats(out, "Digital read", stats.digitalRead);
+    printRequestStats(out, "Get descriptor", stats.getDescriptor);
+    out << std::setw(20) << "  Retry policy:"
+        << "retries " << stats.retry.retries
+        << ", recovered " << stats.retry.recovered
+        << ", exhausted " << stats.retry.exhausted
+        << ", smoothed RTT (us) " << stats.retry.smoothedRttUs
+        << ", timeout (ms) " << stats.retry.timeoutMs
+        << std::endl;
+}
+
+// Opens a handle to the selected programmer, or to a trace that is being
+// replayed.
+static ProgrammerHandle openProgrammer(ProgrammerSelector & selector,
+    const Arguments & args)
+{
+    if (args.replayTraceSpecified)
+    {
+        auto replayer = std::make_shared<ProgrammerTraceReplayer>(
+            args.replayTraceFile, args.replayTiming);
+        return ProgrammerHandle(replayer->getInstance(), replayer);
+    }
+
+    ProgrammerInstance instance = selector.selectProgrammer();
+
+    if (args.recordTraceSpecified)
+    {
+        auto recorder = std::make_shared<ProgrammerTraceRecorder>(
+            args.recordTraceFile, instance, selector.openTransport(instance));
+        return ProgrammerHandle(instance, recorder);
+    }
+
+    return selector.openHandle(instance);
+}
+
+// Saves the programmer's settings to a profile file, or prints them if the
+// file name is "-".
+static void exportSettings(ProgrammerHandle & handle,
+    const std::string & fileName, std::ostream & out)
+{
+    ProgrammerSettingsProfile profile(handle.getSettings());
+    if (fileName == "-")
+    {
+        out << profile.toString() << std::flush;
+    }
+    else
+    {
+        profile.save(fileName);
+    }
+}
+
+static void runHandleActions(ProgrammerSelector & selector,
+    ProgrammerHandle & handle, const Arguments & args, std::ostream & out)
+{
+    if (args.settingsSpecified())
+    {
+        applySettings(handle, args);
+    }
+
+    if (args.exportSettingsSpecified)
+    {
+        exportSettings(handle, args.exportSettingsFile, out);
+    }
+
+    if (args.showStatus)
+    {
+        printProgrammerStatus(selector, handle, args, out);
+    }
+
+    if (args.printProgrammingPort)
+    {
+        printProgrammingPort(selector, out);
+    }
+
+    if (args.printTtlPort)
+    {
+        printTtlPort(selector, out);
+    }
+
+    if (args.digitalRead && !args.statusDocument())
+    {
+        printDigitalReadings(selector, handle, out);
+    }
+
+    if (args.watch)
+    {
+        watchVariables(selector, handle, args);
+    }
+}
+
+// The output of the actions on one programmer when there are several.
+struct FleetReport
+{
+    std::string output;
+    std::string error;
+
+    // Output that goes to the standard error, like the statistics of a
+    // programmer whose status document could not be made.
+    std::string errorOutput;
+};
+
+// Prints each line of the text with the tag in front of it.
+static void printTagged(std::ostream & out, const std::string & tag,
+    const std::string & text)
+{
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        out << tag << ": " << line << '\n';
+    }
+}
+
+// Prints a document as an element of a JSON array or YAML sequence.
+static void printIndented(std::ostream & out, const std::string & firstPrefix,
+    const std::string & prefix, const std::string & text)
+{
+    std::istringstream lines(text);
+    std::string line;
+    bool first = true;
+    while (std::getline(lines, line))
+    {
+        if (!first) { out << '\n'; }
+        out << (first ? firstPrefix : prefix) << line;
+        first = false;
+    }
+}
+
+// Runs the actions on every selected programmer at the same time and prints
+// the results, tagged with the serial numbers.  Status documents in JSON or
+// YAML are combined into an array or sequence, and any other output has the
+// serial number in front of each line.  Returns the number of programmers
+// that failed.
+static size_t runFleetActions(ProgrammerSelector & selector,
+    const Arguments & args)
+{
+    std::vector<ProgrammerInstance> instances = selector.selectProgrammers();
+    ProgrammerFleet fleet(instances, [&](const ProgrammerInstance & instance)
+    {
+        return selector.openHandle(instance);
+    });
+
+    std::vector<ProgrammerFleetResult<FleetReport>> results =
+        fleet.run<FleetReport>([&](ProgrammerHandle & handle)
+    {
+        FleetReport report;
+        std::ostringstream out;
+        try
+        {
+            runHandleActions(selector, handle, args, out);
+        }
+        catch (const std::exception & e)
+        {
+            report.error = e.what();
+        }
+
+        // With a status document, the statistics are in it, and any other
+        // output would make the combined document invalid.
+        if (args.showStats && !args.statusDocument())
+        {
+            printStats(handle, out);
+        }
+        else if (args.showStats && report.error.size())
+        {
+            std::ostringstream errorOut;
+            printStats(handle, errorOut);
+            report.errorOutput = errorOut.str();
+        }
+        report.output = out.str();
+        return report;
+    });
+
+    bool json = args.showStatus && args.statusFormat == "json";
+    bool yaml = args.showStatus && args.statusFormat == "yaml";
+
+    std::ostringstream out;
+    size_t failures = 0;
+    if (json) { out << "[\n"; }
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const ProgrammerFleetResult<FleetReport> & result = results[i];
+        std::string error = result.succeeded() ? result.value.error : result.error;
+        if (error.size()) { failures++; }
+        printTagged(std::cerr, result.serialNumber, result.value.errorOutput);
+
+        if (json || yaml)
+        {
+            std::string document = result.value.output;
+            if (error.size())
+            {
+                StatusDocument errorDocument;
+                errorDocument.addString("serial_number", result.serialNumber);
+                errorDocument.addString("error", error);
+                document = json ? errorDocument.toJson() : errorDocument.toYaml();
+            }
+
+            if (json)
+            {
+                if (i) { out << ",\n"; }
+                printIndented(out, "  ", "  ", document);
+            }
+            else
+            {
+                printIndented(out, "- ", "  ", document);
+                out << '\n';
+            }
+        }
+        else
+        {
+            printTagged(out, result.serialNumber, result.value.output);
+            if (error.size())
+            {
+                std::cerr << result.serialNumber << ": Error: " << error << std::endl;
+            }
+        }
+    }
+    if (json) { out << "\n]\n"; }
+
+    std::cout << out.str() << std::flush;
+    return failures;
+}
+
 static void run(int argc, char ** argv)
 {
     Arguments args = parseArgs(argc, argv);
@@ -868,9 +2191,35 @@ static void run(int argc, char ** argv)
     }
 
     ProgrammerSelector selector;
-    if (args.serialNumberSpecified)
+    selector.specifySerialNumbers(args.serialNumbers);
+
+    // If the daemon is running, it already has the list of programmers and
+    // their descriptors, so asking it is faster than anything we could do
+    // ourselves.  It is not used with traces because it reads the status of
+    // the programmer itself, so those requests would be missing from the
+    // trace.
+    bool daemonUsed = false;
+#ifndef _WIN32
+    if (!args.noDaemon && !args.replayTraceSpecified &&
+        !args.recordTraceSpecified)
+    {
+        auto daemon = ProgrammerDaemonClient::connect(programmerDaemonGetSocketPath());
+        if (daemon)
+        {
+            selector.useDaemon(daemon);
+            daemonUsed = true;
+        }
+    }
+#endif
+
+    // The cache is not used with traces because the programmer would not be
+    // asked for the things we found in the cache, so they would be missing
+    // from the trace.  It is not needed with the daemon.
+    std::string cachePath = ProgrammerDescriptorCache::getDefaultPath();
+    if (!daemonUsed && args.useCache && !args.recordTraceSpecified &&
+        !args.replayTraceSpecified && !cachePath.empty())
     {
-        selector.specifySerialNumber(args.serialNumber);
+        selector.useDescriptorCache(cachePath);
     }
 
     if (args.showList)
@@ -879,29 +2228,60 @@ static void run(int argc, char ** argv)
         return;
     }
 
-    if (args.settingsSpecified())
+    size_t fleetFailures = 0;
+    if (args.multipleProgrammers() &&
+        (args.settingsSpecified() || args.showStatus || args.digitalRead))
     {
-        applySettings(selector, args);
+        fleetFailures = runFleetActions(selector, args);
     }
-
-    if (args.showStatus)
+    else if (args.settingsSpecified() || args.showStatus || args.digitalRead ||
+        args.watch || args.exportSettingsSpecified)
     {
-        printProgrammerStatus(selector);
-    }
+        // Open the programmer once and use the same handle for all of these
+        // actions.
+        ProgrammerHandle handle = openProgrammer(selector, args);
 
-    if (args.printProgrammingPort)
-    {
-        printProgrammingPort(selector);
-    }
+        try
+        {
+            runHandleActions(selector, handle, args, std::cout);
+        }
+        catch (...)
+        {
+            // The statistics are most interesting when something went wrong.
+            // If they were going to be in the status document, print them on
+            // the standard error instead of half a document.
+            if (args.showStats)
+            {
+                printStats(handle, args.statusDocument() ? std::cerr : std::cout);
+            }
+            throw;
+        }
 
-    if (args.printTtlPort)
+        if (args.showStats && !args.statusDocument())
+        {
+            printStats(handle, std::cout);
+        }
+    }
+    else
     {
-        printTtlPort(selector);
+        if (args.printProgrammingPort)
+        {
+            printProgrammingPort(selector, std::cout);
+        }
+
+        if (args.printTtlPort)
+        {
+            printTtlPort(selector, std::cout);
+        }
     }
 
-    if (args.digitalRead)
+    selector.saveDescriptorCache();
+
+    if (fleetFailures)
     {
-        printDigitalReadings(selector);
+        throw ExceptionWithExitCode(PAVRPGM_ERROR_OPERATION_FAILED,
+            "The actions failed on " + std::to_string(fleetFailures) +
+            " programmer" + (fleetFailures == 1 ? "" : "s") + ".");
     }
 }
 
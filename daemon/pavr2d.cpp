@@ -0,0 +1,83 @@
+#include <iostream>
+#include <string>
+#include <csignal>
+
+#include <pavrpgm_config.h>
+#include <programmer_daemon.h>
+
+static const char help[] =
+    DAEMON_NAME ": Pololu USB AVR Programmer v2 Daemon\n"
+    "Version " SOFTWARE_VERSION_STRING "\n"
+    "Usage: " DAEMON_NAME " [OPTIONS]\n"
+    "\n"
+    "Keeps the connected programmers open and lets " CLI_NAME " use them\n"
+    "through a Unix domain socket, which makes each run of " CLI_NAME " faster.\n"
+    "It runs in the foreground until it gets SIGINT or SIGTERM.\n"
+    "\n"
+    "Options:\n"
+    "  --socket PATH               Listen on PATH instead of the default socket.\n"
+    "  -h, --help                  Show this help screen.\n"
+    "\n"
+    "The default socket is $PAVR2D_SOCKET if it is set, or pavr2d.sock in\n"
+    "$XDG_RUNTIME_DIR, or /tmp/pavr2d-UID.sock.  " CLI_NAME " looks for the\n"
+    "daemon in the same place.\n"
+    "\n"
+    "For more help, see: " DOCUMENTATION_URL "\n"
+    "\n";
+
+static ProgrammerDaemonServer * server = NULL;
+
+static void handleStopSignal(int)
+{
+    if (server) { server->stop(); }
+}
+
+int main(int argc, char ** argv)
+{
+    std::string socketPath = programmerDaemonGetSocketPath();
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--socket")
+        {
+            if (i + 1 == argc)
+            {
+                std::cerr << "Error: Expected a path after '--socket'." << std::endl;
+                return 1;
+            }
+            socketPath = argv[++i];
+        }
+        else if (arg == "-h" || arg == "--help")
+        {
+            std::cout << help;
+            return 0;
+        }
+        else
+        {
+            std::cerr << "Error: Unknown option: '" << arg << "'." << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        ProgrammerDaemonServer daemon(socketPath);
+        server = &daemon;
+        std::signal(SIGINT, handleStopSignal);
+        std::signal(SIGTERM, handleStopSignal);
+        std::signal(SIGPIPE, SIG_IGN);
+
+        std::cout << "Listening on " << socketPath << std::endl;
+        daemon.run();
+        server = NULL;
+    }
+    catch (const std::exception & error)
+    {
+        server = NULL;
+        std::cerr << "Error: " << error.what() << std::endl;
+        return 2;
+    }
+
+    return 0;
+}
@@ -122,7 +122,8 @@ void MainController::restoreDefaultSettings()
     bool restoreSuccess = false;
     try
     {
-        model->deviceHandle.restoreDefaults();
+        // This also loads the new settings.
+        model->restoreDefaults();
         restoreSuccess = true;
     }
     catch (const std::exception & e)
@@ -130,8 +131,16 @@ void MainController::restoreDefaultSettings()
         showException(e, "There was an error resetting to the default settings.");
     }
 
-    // This takes care of reloading the settings and telling the view to update.
-    reloadSettings();
+    if (restoreSuccess)
+    {
+        view->handleSettingsChanged();
+    }
+    else
+    {
+        // This takes care of reloading the settings and telling the view to
+        // update.
+        reloadSettings();
+    }
 
     if (restoreSuccess)
     {
@@ -185,18 +194,11 @@ void MainController::update()
 
         if (deviceStillPresent)
         {
-            // Reload the variables from the device.
-            try
-            {
-                model->reloadVariables();
-            }
-            catch (const std::exception & e)
-            {
-                // Ignore the exception.  The model provides other ways to tell that
-                // the variable update failed, and the exact message is probably
-                // not that useful since it is probably just a generic problem with
-                // the USB connection.
-            }
+            // Get the newest variables read by the background sampler.  If
+            // reading them failed, the model tells the view, and the exact
+            // error is probably not that useful since it is probably just a
+            // generic problem with the USB connection.
+            model->takeVariablesFromSampler();
             view->handleVariablesChanged();
         }
         else
@@ -298,6 +300,14 @@ void MainController::reallyConnect()
         showException(e, "There was an error getting the status of the device.");
     }
 
+    // From now on, the variables are read in the background and update()
+    // picks them up.  The error dialogs above run an event loop, so update()
+    // might have disconnected us in the meantime.
+    if (model->connected())
+    {
+        model->startVariableSampler(UPDATE_INTERVAL_MS);
+    }
+
     view->handleModelChanged();
 }
 
@@ -4,12 +4,23 @@
 
 void MainModel::updateDeviceList()
 {
-    deviceList = programmerGetList();
+    if (deviceRegistry)
+    {
+        deviceRegistry->update();
+    }
+    else
+    {
+        // The registry scans the USB devices when it is created, so this can
+        // throw just like update() can.
+        deviceRegistry.reset(new ProgrammerRegistry());
+    }
+    deviceList = deviceRegistry->getList();
 }
 
 void MainModel::connect(const ProgrammerInstance & instance)
 {
     // Close the old handle in case one is already open.
+    variableSampler.reset();
     deviceHandle.close();
 
     connectionError = false;
@@ -43,6 +54,15 @@ void MainModel::reloadSettings()
     }
 }
 
+void MainModel::restoreDefaults()
+{
+    assert(connected());
+
+    // Any unapplied changes are lost either way.
+    settingsModified = false;
+    settings = deviceHandle.restoreDefaults().settings;
+}
+
 void MainModel::applySettings()
 {
     assert(connected());
@@ -66,6 +86,35 @@ void MainModel::reloadVariables()
     }
 }
 
+void MainModel::startVariableSampler(uint32_t intervalMs)
+{
+    assert(connected());
+
+    variableSampler.reset(new ProgrammerSampler(deviceHandle,
+        PAVR2_VARIABLE_MASK_ALL, std::chrono::milliseconds(intervalMs)));
+    variableSampler->start();
+}
+
+void MainModel::takeVariablesFromSampler()
+{
+    if (!variableSampler) { return; }
+
+    // We only care about the newest sample.
+    ProgrammerSample sample;
+    bool gotSample = false;
+    while (variableSampler->pop(sample))
+    {
+        gotSample = true;
+    }
+    if (!gotSample) { return; }
+
+    variablesUpdateFailed = sample.failed;
+    if (!sample.failed)
+    {
+        variables = sample.variables.variables;
+    }
+}
+
 void MainModel::reloadFirmwareVersionString()
 {
     try
@@ -103,6 +152,8 @@ void MainModel::setConnectionError(std::string errorMessage)
 
 void MainModel::disconnect()
 {
+    // Stop the sampler first because it shares the handle.
+    variableSampler.reset();
     deviceHandle.close();
     settingsModified = false;
 }
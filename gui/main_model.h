@@ -1,6 +1,10 @@
 #pragma once
 
 #include "programmer.h"
+#include "programmer_sampler.h"
+#include "programmer_registry.h"
+
+#include <memory>
 
 /** The model holds the state of the application and it knows how to perform
  * simple operations that change the state.  The model does not know about
@@ -13,6 +17,10 @@ public:
     /** Holds a list of the relevant devices that are connected to the computer. */
     std::vector<ProgrammerInstance> deviceList;
 
+    /** Keeps track of the connected devices using hotplug events, so that
+     * updating deviceList does not require scanning every USB device. */
+    std::unique_ptr<ProgrammerRegistry> deviceRegistry;
+
     /** Holds an open handle to a device or a null handle if we are not
      * connected. */
     ProgrammerHandle deviceHandle;
@@ -41,6 +49,11 @@ public:
      * to a USB error). */
     bool variablesUpdateFailed = false;
 
+    /** While we are connected, this reads the variables on a background
+     * thread so that the UI thread does not have to wait for the USB
+     * transfers. */
+    std::unique_ptr<ProgrammerSampler> variableSampler;
+
     /** The firmware version string, including any modification codes
      * (e.g. "1.07nc"). */
     std::string firmwareVersionString;
@@ -50,8 +63,11 @@ public:
 
     void updateDeviceList();
     void reloadSettings();
+    void restoreDefaults();
     void applySettings();
     void reloadVariables();
+    void startVariableSampler(uint32_t intervalMs);
+    void takeVariablesFromSampler();
     void reloadFirmwareVersionString();
 
     void connect(const ProgrammerInstance & instance);
@@ -2,6 +2,10 @@
 #include "main_controller.h"
 #include "main_model.h"
 
+#include "programmer_format.h"
+
+#include <cstdio>
+
 void MainView::init(const MainModel * model, MainController * controller)
 {
     this->model = model;
@@ -106,17 +110,16 @@ void MainView::handleDeviceChanged()
     }
 }
 
-/** Takes a number of millivolts and returns a string like "123 mV". */
-static std::string convertMvToString(uint32_t mv)
-{
-    return std::to_string(mv) + " mV";
-}
-
 void MainView::handleVariablesChanged()
 {
     const ProgrammerVariables & vars = model->variables;
 
-    window.setLastDeviceReset(Programmer::convertDeviceResetToString(vars.lastDeviceReset));
+    // This runs every time the variables are polled, so it formats everything
+    // into buffers on the stack instead of building strings.
+    char buffer[64];
+
+    programmerFormatDeviceReset(buffer, sizeof(buffer), vars.lastDeviceReset);
+    window.setLastDeviceReset(buffer);
 
     if (vars.programmingError == 0)
     {
@@ -124,37 +127,45 @@ void MainView::handleVariablesChanged()
     }
     else
     {
-        window.setProgrammingError(std::string("Error: ") +
-            Programmer::convertProgrammingErrorToShortString(vars.programmingError),
-            Programmer::convertProgrammingErrorToLongString(vars.programmingError));
+        size_t length = snprintf(buffer, sizeof(buffer), "Error: ");
+        programmerFormatProgrammingError(buffer + length,
+            sizeof(buffer) - length, vars.programmingError);
+        window.setProgrammingError(buffer,
+            Programmer::convertProgrammingErrorToLongCString(vars.programmingError));
     }
 
     // Uncomment this code to test that the GUI can show the longest error
     // message:
     // window.setProgrammingError(
-    //     Programmer::convertProgrammingErrorToShortString(PAVR2_PROGRAMMING_ERROR_SYNCH),
-    //     Programmer::convertProgrammingErrorToLongString(PAVR2_PROGRAMMING_ERROR_SYNCH));
+    //     Programmer::convertProgrammingErrorToShortCString(PAVR2_PROGRAMMING_ERROR_SYNCH),
+    //     Programmer::convertProgrammingErrorToLongCString(PAVR2_PROGRAMMING_ERROR_SYNCH));
 
     if (vars.hasResultsFromLastProgramming)
     {
-        window.setMeasuredVccMin(convertMvToString(vars.targetVccMeasuredMinMv));
-        window.setMeasuredVccMax(convertMvToString(vars.targetVccMeasuredMaxMv));
-        window.setMeasuredVddMin(convertMvToString(vars.programmerVddMeasuredMinMv));
-        window.setMeasuredVddMax(convertMvToString(vars.programmerVddMeasuredMaxMv));
+        programmerFormatMv(buffer, sizeof(buffer), vars.targetVccMeasuredMinMv);
+        window.setMeasuredVccMin(buffer);
+        programmerFormatMv(buffer, sizeof(buffer), vars.targetVccMeasuredMaxMv);
+        window.setMeasuredVccMax(buffer);
+        programmerFormatMv(buffer, sizeof(buffer), vars.programmerVddMeasuredMinMv);
+        window.setMeasuredVddMin(buffer);
+        programmerFormatMv(buffer, sizeof(buffer), vars.programmerVddMeasuredMaxMv);
+        window.setMeasuredVddMax(buffer);
     }
     else
     {
-        std::string value = "N/A";
+        const char * value = "N/A";
         window.setMeasuredVccMin(value);
         window.setMeasuredVccMax(value);
         window.setMeasuredVddMin(value);
         window.setMeasuredVddMax(value);
     }
 
-    window.setCurrentVcc(convertMvToString(vars.targetVccMv));
-    window.setCurrentVdd(convertMvToString(vars.programmerVddMv));
+    programmerFormatMv(buffer, sizeof(buffer), vars.targetVccMv);
+    window.setCurrentVcc(buffer);
+    programmerFormatMv(buffer, sizeof(buffer), vars.programmerVddMv);
+    window.setCurrentVdd(buffer);
     window.setRegulatorLevel(
-        Programmer::convertRegulatorLevelToString(vars.regulatorLevel));
+        Programmer::convertRegulatorLevelToCString(vars.regulatorLevel));
 
     // Note: It would be nice to display some error indication if
     // model->variablesUpdateFailed is true.
@@ -1,7 +1,7 @@
 #include "frequency_validator.h"
 
 void FrequencyValidator::setAllowedFrequencies(
-    const std::vector<ProgrammerFrequency> & allowedFrequencies)
+    ProgrammerFrequencyTable allowedFrequencies)
 {
     this->allowedFrequencies = allowedFrequencies;
 }
@@ -129,18 +129,12 @@ void FrequencyValidator::fixup(QString & input) const
         }
     }
 
-    // Convert the frequency to a period in the native units of the programmer
-    // (one twelfth microseconds).
-    double period_approximation = 12000 / value;
-
-    // Find the first frequency that is lower than this.
-    for (const ProgrammerFrequency & freq : allowedFrequencies)
+    // Find the fastest frequency that does not exceed this.
+    int32_t index = programmerFrequencyFindAtMost(allowedFrequencies, value * 1000);
+    if (index >= 0)
     {
-        if (freq.period >= period_approximation - 0.00001)
-        {
-            input = QString(freq.name) + " kHz";
-            return;
-        }
+        input = QString(allowedFrequencies[index].name) + " kHz";
+        return;
     }
 
     // Nothing we have is low enough; just use the lowest frequency.
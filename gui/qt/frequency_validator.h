@@ -9,7 +9,9 @@
  * correct the user's input so it matches one of the allowed input values.
  *
  * You must call setAllowedFrequencies with a sorted (descending) list of
- * frequencies before the other methods will do anything useful.
+ * frequencies before the other methods will do anything useful.  Numbers that
+ * are not in the list are rounded down to an allowed frequency with
+ * programmerFrequencyFindAtMost.
  *
  * This class assumes that we want to have the suffix " kHz" after the
  * frequency. */
@@ -21,10 +23,10 @@ public:
 
     /** Note: For the purposes of fixup(), the table provided to this function
      * must be sorted by the frequency in kHz, descending. */
-    void setAllowedFrequencies(const std::vector<ProgrammerFrequency> &);
+    void setAllowedFrequencies(ProgrammerFrequencyTable);
 
     void setDefaultFrequency(const ProgrammerFrequency &);
 private:
-    std::vector<ProgrammerFrequency> allowedFrequencies;
+    ProgrammerFrequencyTable allowedFrequencies;
     ProgrammerFrequency defaultFrequency;
 };
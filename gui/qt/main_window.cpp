@@ -174,64 +174,64 @@ void MainWindow::setTtlPort(const std::string & portName)
     ttlPortValue->setText(QString(portName.c_str()));
 }
 
-void MainWindow::setLastDeviceReset(const std::string & lastDeviceReset)
+void MainWindow::setLastDeviceReset(const char * lastDeviceReset)
 {
-    lastDeviceResetValue->setText(QString(lastDeviceReset.c_str()));
+    lastDeviceResetValue->setText(QString(lastDeviceReset));
 }
 
-void MainWindow::setProgrammingError(const std::string & shortMessage,
-    const std::string & details)
+void MainWindow::setProgrammingError(const char * shortMessage,
+    const char * details)
 {
-    QString text = shortMessage.c_str();
-    if (!details.empty())
+    QString text = shortMessage;
+    if (details[0])
     {
         text += "\n";
-        text += details.c_str();
+        text += details;
     }
     programmingErrorValue->setText(text);
 }
 
-void MainWindow::setMeasuredVccMin(const std::string & voltage)
+void MainWindow::setMeasuredVccMin(const char * voltage)
 {
-    measuredVccMinValue->setText(QString(voltage.c_str()));
+    measuredVccMinValue->setText(QString(voltage));
 }
 
-void MainWindow::setMeasuredVccMax(const std::string & voltage)
+void MainWindow::setMeasuredVccMax(const char * voltage)
 {
-    measuredVccMaxValue->setText(QString(voltage.c_str()));
+    measuredVccMaxValue->setText(QString(voltage));
 }
 
-void MainWindow::setMeasuredVddMin(const std::string & voltage)
+void MainWindow::setMeasuredVddMin(const char * voltage)
 {
-    measuredVddMinValue->setText(QString(voltage.c_str()));
+    measuredVddMinValue->setText(QString(voltage));
 }
 
-void MainWindow::setMeasuredVddMax(const std::string & voltage)
+void MainWindow::setMeasuredVddMax(const char * voltage)
 {
-    measuredVddMaxValue->setText(QString(voltage.c_str()));
+    measuredVddMaxValue->setText(QString(voltage));
 }
 
-void MainWindow::setCurrentVcc(const std::string & voltage)
+void MainWindow::setCurrentVcc(const char * voltage)
 {
-    currentVccValue->setText(QString(voltage.c_str()));
+    currentVccValue->setText(QString(voltage));
 }
 
-void MainWindow::setCurrentVdd(const std::string & voltage)
+void MainWindow::setCurrentVdd(const char * voltage)
 {
-    currentVddValue->setText(QString(voltage.c_str()));
+    currentVddValue->setText(QString(voltage));
 }
 
-void MainWindow::setRegulatorLevel(const std::string & level)
+void MainWindow::setRegulatorLevel(const char * level)
 {
-    currentRegulatorLevelValue->setText(QString(level.c_str()));
+    currentRegulatorLevelValue->setText(QString(level));
 }
 
 void MainWindow::configureIspFrequencyControls(
-    const std::vector<ProgrammerFrequency> & allowedFrequencyTable,
-    const std::vector<ProgrammerFrequency> & suggestedFrequencyTable,
+    ProgrammerFrequencyTable allowedFrequencyTable,
+    ProgrammerFrequencyTable suggestedFrequencyTable,
     const ProgrammerFrequency & defaultFrequency,
-    const std::vector<ProgrammerFrequency> & allowedMaxFrequencyTable,
-    const std::vector<ProgrammerFrequency> & suggestedMaxFrequencyTable,
+    ProgrammerFrequencyTable allowedMaxFrequencyTable,
+    ProgrammerFrequencyTable suggestedMaxFrequencyTable,
     const ProgrammerFrequency & defaultMaxFrequency)
 {
     QString suffix = " kHz";
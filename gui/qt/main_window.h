@@ -68,22 +68,22 @@ public:
     void setFirmwareVersion(const std::string & firmwareVersion);
     void setProgPort(const std::string & portName);
     void setTtlPort(const std::string & portName);
-    void setLastDeviceReset(const std::string & lastDeviceReset);
-    void setProgrammingError(const std::string & shortMessage, const std::string & details);
-    void setMeasuredVccMin(const std::string & voltage);
-    void setMeasuredVccMax(const std::string & voltage);
-    void setMeasuredVddMin(const std::string & voltage);
-    void setMeasuredVddMax(const std::string & voltage);
-    void setCurrentVcc(const std::string & voltage);
-    void setCurrentVdd(const std::string & voltage);
-    void setRegulatorLevel(const std::string & level);
+    void setLastDeviceReset(const char * lastDeviceReset);
+    void setProgrammingError(const char * shortMessage, const char * details);
+    void setMeasuredVccMin(const char * voltage);
+    void setMeasuredVccMax(const char * voltage);
+    void setMeasuredVddMin(const char * voltage);
+    void setMeasuredVddMax(const char * voltage);
+    void setCurrentVcc(const char * voltage);
+    void setCurrentVdd(const char * voltage);
+    void setRegulatorLevel(const char * level);
 
     void configureIspFrequencyControls(
-        const std::vector<ProgrammerFrequency> & allowedFrequencyTable,
-        const std::vector<ProgrammerFrequency> & suggestedFrequencyTable,
+        ProgrammerFrequencyTable allowedFrequencyTable,
+        ProgrammerFrequencyTable suggestedFrequencyTable,
         const ProgrammerFrequency & defaultFrequency,
-        const std::vector<ProgrammerFrequency> & allowedMaxFrequencyTable,
-        const std::vector<ProgrammerFrequency> & suggestedMaxFrequencyTable,
+        ProgrammerFrequencyTable allowedMaxFrequencyTable,
+        ProgrammerFrequencyTable suggestedMaxFrequencyTable,
         const ProgrammerFrequency & defaultMaxFrequency);
 
     void setIspFrequency(const std::string & frequency);
@@ -14,10 +14,14 @@
 #include <libusbp.hpp>
 #include <vector>
 #include <string>
+#include <memory>
+#include <atomic>
 #include <cstdint>
 
 #include "pavr2_protocol.h"
 #include "programmer_frequency_tables.h"
+#include "programmer_transport.h"
+#include "programmer_stats.h"
 
 /** The maximum firmware major version supported by this program.  If we make a
  * breaking change in the firmware, we can use this to be sure that old software
@@ -27,6 +31,17 @@
 struct ProgrammerSettings;
 struct ProgrammerVariables;
 
+/** The values of the SCK_DURATION and ISP_FASTEST_PERIOD settings that select
+ * a particular ISP frequency. */
+struct ProgrammerFrequencySetting
+{
+    uint32_t sckDuration = 0;
+
+    // This is only meaningful if sckDuration is 0.  Otherwise, the frequency
+    // does not depend on ISP_FASTEST_PERIOD, so it can be left alone.
+    uint32_t ispFastestPeriod = 0;
+};
+
 class Programmer
 {
 public:
@@ -36,19 +51,66 @@ public:
     // This is only used by the programmer if SCK_DURATION is 0.
     static std::string getMaxFrequencyName(uint32_t ispFastestPeriod);
 
+    // Same as getMaxFrequencyName, but returns the element of
+    // programmerFullMaxFrequencyTable, which has the period too.
+    static const ProgrammerFrequency & getMaxFrequency(uint32_t ispFastestPeriod);
+
     // Sets the maximum frequency by its name.  The name must exactly match
     // one of the allowed values.
-    static void setMaxFrequency(ProgrammerSettings &, std::string maxFrequencyName);
+    static void setMaxFrequency(ProgrammerSettings &, const std::string & maxFrequencyName);
+
+    // Sets the maximum frequency by its period, in twelfths of a microsecond.
+    // The period must be one of the allowed values.
+    static void setMaxFrequencyPeriod(ProgrammerSettings &, uint32_t period);
 
     // Gets the name (string with a number of kHz) of the frequency actually
     // being used by the programmer, which depends on two parameters:
     // SCK_DURATION and ISP_FASTEST_PERIOD.
     static std::string getFrequencyName(uint32_t sckDuration, uint32_t ispFastestPeriod);
 
+    // Same as getFrequencyName, but returns the table element, which has the
+    // period too.
+    static const ProgrammerFrequency & getFrequency(uint32_t sckDuration,
+        uint32_t ispFastestPeriod);
+
     // Sets the actual frequency being used by the programmer by its name.  The
     // name must exactly match one of the allowed values.  This function always
     // sets SCK_DURATION, and it only sets ISP_FASTEST_PERIOD if necessary.
-    static void setFrequency(ProgrammerSettings &, std::string frequencyName);
+    static void setFrequency(ProgrammerSettings &, const std::string & frequencyName);
+
+    // Same as setFrequency, but takes the period of the frequency in twelfths
+    // of a microsecond instead of its name.
+    static void setFrequencyPeriod(ProgrammerSettings &, uint32_t period);
+
+    // Finds the fastest allowed frequency that does not exceed the specified
+    // frequency (in Hz), which does not need to be one of the allowed values.
+    // Throws an exception if all the allowed frequencies are faster.
+    static ProgrammerFrequencySetting findFrequencyAtMost(double frequencyHz);
+
+    // Like findFrequencyAtMost, but for the maximum frequency.  Returns the
+    // ISP_FASTEST_PERIOD value.
+    static uint32_t findMaxFrequencyAtMost(double frequencyHz);
+
+    // Sets the frequency to the result of findFrequencyAtMost.
+    static void setFrequencyAtMost(ProgrammerSettings &, double frequencyHz);
+
+    // Sets the maximum frequency to the result of findMaxFrequencyAtMost.
+    static void setMaxFrequencyAtMost(ProgrammerSettings &, double frequencyHz);
+
+    // Splits a frequency like "1500", "1.5MHz", or "114 kHz" into the number
+    // and the number of Hz in the unit.  A number without a suffix is in kHz.
+    // The suffix is not case-sensitive.  Returns false if the frequency is
+    // invalid.
+    static bool splitFrequency(const std::string & frequency,
+        std::string & number, double & unitHz);
+
+    // Sets the frequency (or the maximum frequency if max is true) from a
+    // string that splitFrequency accepts.  If the string is one of the names
+    // in our tables, that frequency is used exactly, even though the name is
+    // rounded.  Otherwise, we use the fastest allowed frequency that does not
+    // exceed it.  Throws an exception if the string is invalid or too low.
+    static void setFrequencyFromString(ProgrammerSettings &,
+        const std::string & frequency, bool max);
 
     static std::string convertProgrammingErrorToShortString(uint8_t programmingError);
 
@@ -64,6 +126,16 @@ public:
     static std::string convertRegulatorLevelToString(uint8_t regulatorLevel);
 
     static std::string convertLineFunctionToString(uint8_t lineFunction);
+
+    // These are like the functions above, but they return pointers to string
+    // literals so they never allocate memory.  For unknown codes, the ones
+    // that would return "Unknown code N." return NULL instead.
+    static const char * convertProgrammingErrorToShortCString(uint8_t programmingError);
+    static const char * convertProgrammingErrorToLongCString(uint8_t programmingError);
+    static const char * convertDeviceResetToCString(uint8_t deviceReset);
+    static const char * convertRegulatorModeToCString(uint8_t regulatorMode);
+    static const char * convertRegulatorLevelToCString(uint8_t regulatorLevel);
+    static const char * convertLineFunctionToCString(uint8_t lineFunction);
 };
 
 class ProgrammerInstance
@@ -80,6 +152,7 @@ public:
     std::string getOsId() const;
 
     std::string getSerialNumber() const;
+    uint16_t getProductId() const;
     uint16_t getFirmwareVersion() const;
 
     // Returns a string like "1.03", not including any firmware modification codes.
@@ -114,6 +187,22 @@ private:
 
 std::vector<ProgrammerInstance> programmerGetList();
 
+/** Finds the programmer with the specified serial number, or returns a null
+ * instance if it is not connected.  On Linux, this checks sysfs first, so it
+ * returns quickly without enumerating USB devices if the programmer is not
+ * connected.  If it is connected, this still calls
+ * libusbp::list_connected_devices() because libusbp cannot open a device by
+ * its sysfs path; the sysfs match only saves us from opening and querying the
+ * other programmers in that list. */
+ProgrammerInstance programmerFindBySerial(const std::string & serialNumber);
+
+/** The names of each programmer's serial ports are looked up once and
+ * remembered.  This function forgets the names for the device with the
+ * specified OS ID, and should be called when the device is removed.
+ * programmerGetList() does this automatically for devices that are no longer
+ * connected. */
+void programmerForgetPortNames(const std::string & osId);
+
 // [all-settings]
 struct ProgrammerSettings
 {
@@ -134,6 +223,14 @@ struct ProgrammerSettings
     uint32_t softwareVersionMinor = 0;
 };
 
+struct ProgrammerSettingsSnapshot
+{
+    ProgrammerSettings settings;
+
+    // The time it took to read the settings from the device.
+    uint32_t readTimeUs = 0;
+};
+
 struct ProgrammerVariables
 {
     uint8_t lastDeviceReset = 0;
@@ -149,6 +246,38 @@ struct ProgrammerVariables
     bool inProgrammingMode = 0;
 };
 
+/** Returns the bit that selects the variable with the specified
+ * PAVR2_VARIABLE_* ID in the mask passed to ProgrammerHandle::getVariables. */
+#define PAVR2_VARIABLE_MASK(id) ((uint32_t)1 << (id))
+
+/** Selects all of the variables. */
+#define PAVR2_VARIABLE_MASK_ALL 0x7FE
+
+/** Selects the variables needed to compute hasResultsFromLastProgramming. */
+#define PAVR2_VARIABLE_MASK_LAST_PROGRAMMING ( \
+    PAVR2_VARIABLE_MASK(PAVR2_VARIABLE_PROGRAMMING_ERROR) | \
+    PAVR2_VARIABLE_MASK(PAVR2_VARIABLE_TARGET_VCC_MEASURED_MIN) | \
+    PAVR2_VARIABLE_MASK(PAVR2_VARIABLE_TARGET_VCC_MEASURED_MAX) | \
+    PAVR2_VARIABLE_MASK(PAVR2_VARIABLE_PROGRAMMER_VDD_MEASURED_MIN) | \
+    PAVR2_VARIABLE_MASK(PAVR2_VARIABLE_PROGRAMMER_VDD_MEASURED_MAX))
+
+/** Holds the variables that were read by ProgrammerHandle::getVariables(mask).
+ * Fields that were not read are zero.  hasResultsFromLastProgramming is only
+ * valid if all the variables in PAVR2_VARIABLE_MASK_LAST_PROGRAMMING were
+ * read. */
+struct ProgrammerPartialVariables
+{
+    // Uses the same bits as the mask passed to getVariables.
+    uint32_t validMask = 0;
+
+    ProgrammerVariables variables;
+
+    bool isValid(uint8_t id) const
+    {
+        return validMask & PAVR2_VARIABLE_MASK(id);
+    }
+};
+
 struct ProgrammerDigitalReadings
 {
     uint8_t portA;
@@ -156,19 +285,79 @@ struct ProgrammerDigitalReadings
     uint8_t portC;
 };
 
+/** Controls how ProgrammerHandle times out and retries control transfers.
+ *
+ * The timeout adapts to the round-trip time measured from successful
+ * transfers: it is the smoothed round-trip time plus four times its mean
+ * deviation (like TCP), limited to be between minTimeoutMs and maxTimeoutMs.
+ * Before any transfer succeeds, initialTimeoutMs is used.
+ *
+ * Failed device-to-host requests, which only read data, are retried up to
+ * maxRetries times.  The first retry happens after backoffMs, and that delay
+ * doubles for each retry after that.  If a transfer timed out, the timeout is
+ * doubled (up to maxTimeoutMs) before retrying.  Transfers that failed because
+ * the device was disconnected are never retried.
+ *
+ * Host-to-device requests, like the ones that change settings, are never
+ * retried, so they use initialTimeoutMs if the adapted timeout is shorter. */
+struct ProgrammerRetryPolicy
+{
+    uint32_t initialTimeoutMs = 300;
+    uint32_t minTimeoutMs = 50;
+    uint32_t maxTimeoutMs = 1000;
+    uint32_t maxRetries = 2;
+    uint32_t backoffMs = 5;
+};
+
+/** Controls how ProgrammerHandle::restoreDefaults waits for the programmer
+ * to finish reinitializing its settings.
+ *
+ * The first poll happens firstPollDelayUs after the request to restore the
+ * defaults is sent.  The delay doubles after each poll, up to maxPollDelayUs,
+ * so a programmer that finishes quickly is noticed quickly without flooding
+ * one that takes longer.  If the settings are still not initialized after
+ * timeoutMs, restoreDefaults throws an exception.
+ *
+ * If cancel is not null, restoreDefaults checks it before each poll and
+ * throws an exception if it is true.  It can be set from another thread. */
+struct ProgrammerRestoreOptions
+{
+    uint32_t firstPollDelayUs = 1000;
+    uint32_t maxPollDelayUs = 10000;
+    uint32_t timeoutMs = 300;
+    const std::atomic<bool> * cancel = nullptr;
+};
+
+/** The result of ProgrammerHandle::restoreDefaults. */
+struct ProgrammerRestoreResult
+{
+    // The time from sending the request to restore the defaults until the
+    // programmer reported that its settings were initialized.
+    uint32_t settleTimeUs = 0;
+
+    // The default settings, read from the programmer after it settled.
+    ProgrammerSettings settings;
+};
+
 class ProgrammerHandle
 {
 public:
     ProgrammerHandle();
+
+    // Opens a USB handle to the specified programmer.
     explicit ProgrammerHandle(ProgrammerInstance);
 
+    // Uses the specified transport to communicate with the programmer instead
+    // of opening a USB handle.
+    ProgrammerHandle(ProgrammerInstance, std::shared_ptr<ProgrammerTransport>);
+
     void close();
 
     const ProgrammerInstance & getInstance() const;
 
     operator bool() const
     {
-        return handle;
+        return (bool)transport;
     }
 
     // Returns the firmware version string, including any modification
@@ -176,22 +365,68 @@ public:
     std::string getFirmwareVersionString();
 
     ProgrammerSettings getSettings();
+
+    // Reads all the settings and reports how long that took.  getSettings()
+    // is a shortcut for this.
+    ProgrammerSettingsSnapshot getSettingsSnapshot();
+
     void validateSettings(const ProgrammerSettings &);
+
+    // Writes the specified settings to the device.  This only sends the
+    // settings that differ from the last known state of the device, which is
+    // remembered from previous calls to getSettings() and applySettings().
+    // Another program might have changed the settings since then, so if they
+    // were last read more than a second ago, this reads them again first.
     void applySettings(const ProgrammerSettings &);
-    void restoreDefaults();
+
+    // Restores the default settings and waits until the programmer finishes
+    // initializing them, then reads them back.
+    ProgrammerRestoreResult restoreDefaults(
+        const ProgrammerRestoreOptions & = ProgrammerRestoreOptions());
+
+    // Forgets the last known state of the device's settings, so the next call
+    // to applySettings() reads them again before deciding what to write.  Call
+    // this if something else might have changed the settings on the device.
+    void invalidateSettingsShadow();
 
     ProgrammerVariables getVariables();
 
+    // Reads only the variables selected by the mask, which should be made by
+    // combining PAVR2_VARIABLE_MASK values.  This is useful for monitoring a
+    // few variables at a high rate.
+    ProgrammerPartialVariables getVariables(uint32_t mask);
+
     ProgrammerDigitalReadings digitalRead();
 
+    // Returns statistics about the latency and failures of the control
+    // transfers made with this handle so far.
+    ProgrammerStats getStats() const;
+
+    void setRetryPolicy(const ProgrammerRetryPolicy &);
+    ProgrammerRetryPolicy getRetryPolicy() const;
+
 private:
+    void controlTransfer(ProgrammerRequestStats ProgrammerStats::* requestStats,
+        uint8_t requestType, uint8_t request, uint16_t value, uint16_t index,
+        void * buffer, uint16_t length, size_t * transferred);
+    void recordShortTransfer(ProgrammerRequestStats ProgrammerStats::* requestStats);
+
     uint8_t getRawSetting(uint8_t id);
     void setRawSetting(uint8_t id, uint8_t value);
+    void updateRawSetting(uint8_t id, uint8_t value);
     uint8_t getRawVariable(uint8_t id);
 
     std::string cachedFirmwareVersion;
-    libusbp::generic_handle handle;
+
+    std::shared_ptr<ProgrammerTransport> transport;
     ProgrammerInstance instance;
+
+    // Holds the statistics, the retry policy, the round-trip time estimate and
+    // the last known settings of the device, with a mutex to protect them
+    // since transfers can happen on several threads at once.  Copies of the
+    // handle share it because they share the transport.
+    struct TransferState;
+    std::shared_ptr<TransferState> transferState;
 };
 
 // Returns true if a Pololu USB AVR Programmer (pgm03a) is connected
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "programmer.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/** Runs ProgrammerHandle operations on a dedicated I/O thread, so the threads
+ * that request them never have to wait for USB transfers.
+ *
+ * Every operation is added to a queue and run in order.  Each one returns a
+ * std::shared_future that becomes ready when the operation finishes; if the
+ * operation throws an exception, the future holds it.  Optionally, a callback
+ * can be passed, which gets called on the I/O thread with the same future
+ * once it is ready, so calling get() on it will not block.  Exceptions thrown
+ * by callbacks are ignored.
+ *
+ * The public functions of this class are safe to call from any thread,
+ * including shutdown(), but the object must not be destroyed by a callback.
+ *
+ * The I/O thread uses its own copy of the handle, which shares the transport
+ * of the original. */
+class AsyncProgrammerHandle
+{
+public:
+    template <typename T>
+    using Callback = std::function<void (std::shared_future<T>)>;
+
+    explicit AsyncProgrammerHandle(const ProgrammerHandle &);
+
+    AsyncProgrammerHandle(const AsyncProgrammerHandle &) = delete;
+    AsyncProgrammerHandle & operator=(const AsyncProgrammerHandle &) = delete;
+
+    /** Calls shutdown(). */
+    ~AsyncProgrammerHandle();
+
+    /** Finishes the operations that are already queued and stops the I/O
+     * thread.  Operations requested after this fail right away. */
+    void shutdown();
+
+    std::shared_future<ProgrammerSettings> getSettings(
+        Callback<ProgrammerSettings> = nullptr);
+
+    std::shared_future<void> applySettings(const ProgrammerSettings &,
+        Callback<void> = nullptr);
+
+    std::shared_future<ProgrammerVariables> getVariables(
+        Callback<ProgrammerVariables> = nullptr);
+
+    std::shared_future<ProgrammerDigitalReadings> digitalRead(
+        Callback<ProgrammerDigitalReadings> = nullptr);
+
+    std::shared_future<ProgrammerRestoreResult> restoreDefaults(
+        const ProgrammerRestoreOptions & = ProgrammerRestoreOptions(),
+        Callback<ProgrammerRestoreResult> = nullptr);
+
+    /** Queues an arbitrary operation, which takes a ProgrammerHandle & and
+     * returns a T. */
+    template <typename T, typename Operation>
+    std::shared_future<T> run(Operation operation, Callback<T> callback = nullptr)
+    {
+        auto task = std::make_shared<std::packaged_task<T ()>>(
+            [this, operation]() { return operation(handle); });
+        std::shared_future<T> future = task->get_future().share();
+
+        bool queued = enqueue([task, future, callback]()
+        {
+            (*task)();
+            if (callback)
+            {
+                try { callback(future); } catch (...) { }
+            }
+        });
+
+        if (!queued)
+        {
+            // We were shut down, so make the future hold an exception.
+            std::packaged_task<T ()> failed([]() -> T
+            {
+                throw std::runtime_error("The asynchronous handle was shut down.");
+            });
+            future = failed.get_future().share();
+            failed();
+            if (callback)
+            {
+                try { callback(future); } catch (...) { }
+            }
+        }
+        return future;
+    }
+
+private:
+    bool enqueue(std::function<void ()>);
+    void runThread();
+
+    // Only used by the I/O thread.
+    ProgrammerHandle handle;
+
+    std::mutex mutex;
+    std::condition_variable queueChanged;
+    std::deque<std::function<void ()>> queue;
+    bool stopping = false;
+    std::thread thread;
+};
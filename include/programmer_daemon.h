@@ -0,0 +1,231 @@
+#pragma once
+
+#include "programmer.h"
+#include "programmer_async.h"
+#include "programmer_registry.h"
+#include "programmer_transport.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** pavr2d is a small daemon that keeps the connected programmers open and
+ * lets other processes use them through a Unix domain socket, so that they
+ * do not have to scan the USB devices, open a programmer, and read its
+ * descriptors every time they start.
+ *
+ * Clients can ask the daemon for a programmer's settings, variables, digital
+ * readings, and firmware version, identified by serial number, and it reads
+ * them with its own open handle, so each of those costs one round trip on the
+ * socket.  Clients can also send it individual control transfers, which
+ * means every other ProgrammerHandle feature works the same through the
+ * daemon.  Requests from different clients never contend for the USB
+ * interface because the daemon does the requests for each programmer one at
+ * a time, on a thread of its own, so a programmer that stops responding does
+ * not hold up the others.
+ *
+ * Responses to GET_DESCRIPTOR requests never change while a programmer stays
+ * connected, so the daemon remembers them.  It also remembers the settings
+ * for up to a second after reading them, and forgets them whenever a client
+ * sends a control transfer that might change them.  If another program
+ * changes the settings without going through the daemon, the daemon can
+ * report the old values for up to a second.
+ *
+ * The daemon is only built on Unix-like systems, so this header must not be
+ * used on Windows. */
+
+/** Returns the path of the socket that the daemon listens on by default:
+ * $PAVR2D_SOCKET if it is set, or pavr2d.sock in $XDG_RUNTIME_DIR, or a
+ * per-user file in /tmp. */
+std::string programmerDaemonGetSocketPath();
+
+/** A programmer that the daemon has open.  The instance has no USB device,
+ * like the ones from ProgrammerSimulator, so the port names are provided
+ * separately.  They are empty if the daemon could not determine them. */
+struct ProgrammerDaemonDevice
+{
+    ProgrammerInstance instance;
+    std::string programmingPortName;
+    std::string ttlPortName;
+};
+
+/** A connection to the daemon.  The functions of this class can be called from
+ * several threads at once; the requests are sent one at a time. */
+class ProgrammerDaemonClient
+{
+public:
+    /** Connects to the daemon listening on the specified socket.  Returns null
+     * if no daemon is running there, or if the socket or the daemon belongs to
+     * another user, or other users can access the socket. */
+    static std::shared_ptr<ProgrammerDaemonClient> connect(
+        const std::string & socketPath);
+
+    ProgrammerDaemonClient(const ProgrammerDaemonClient &) = delete;
+    ProgrammerDaemonClient & operator=(const ProgrammerDaemonClient &) = delete;
+
+    ~ProgrammerDaemonClient();
+
+    /** Returns the programmers that are connected to the computer. */
+    std::vector<ProgrammerDaemonDevice> getList();
+
+    /** Performs a control transfer on the programmer with the specified serial
+     * number.  Works like ProgrammerTransport::controlTransfer. */
+    void controlTransfer(const std::string & serialNumber,
+        uint8_t requestType, uint8_t request, uint16_t value, uint16_t index,
+        void * buffer, uint16_t length, size_t * transferred);
+
+    /** These work like the ProgrammerHandle functions with the same names,
+     * using the daemon's handle for the programmer with the specified serial
+     * number.  They throw ProgrammerTransportError if the daemon could not
+     * read the programmer. */
+    std::string getFirmwareVersionString(const std::string & serialNumber);
+    ProgrammerSettings getSettings(const std::string & serialNumber);
+    ProgrammerVariables getVariables(const std::string & serialNumber);
+    ProgrammerDigitalReadings digitalRead(const std::string & serialNumber);
+
+private:
+    explicit ProgrammerDaemonClient(int socket);
+
+    std::string request(const std::string & message);
+    std::string requestForDevice(const std::string & message);
+    void disconnect();
+
+    std::mutex mutex;
+    int socket;
+};
+
+/** Sends control transfers for one programmer through the daemon. */
+class ProgrammerDaemonTransport : public ProgrammerTransport
+{
+public:
+    ProgrammerDaemonTransport(std::shared_ptr<ProgrammerDaemonClient>,
+        const std::string & serialNumber);
+
+    void controlTransfer(uint8_t requestType, uint8_t request,
+        uint16_t value, uint16_t index,
+        void * buffer, uint16_t length, size_t * transferred) override;
+
+    // The daemon uses the default timeout for every transfer, so setTimeout
+    // is ignored.
+
+private:
+    std::shared_ptr<ProgrammerDaemonClient> client;
+    std::string serialNumber;
+};
+
+/** The daemon itself.  It uses a ProgrammerRegistry to keep track of the
+ * programmers, and opens each one the first time a client uses it.
+ *
+ * run() handles all of the clients on the calling thread.  The requests for
+ * each programmer run on the I/O thread of an AsyncProgrammerHandle, and the
+ * requests from each client are handled one at a time so the responses come
+ * back in order. */
+class ProgrammerDaemonServer
+{
+public:
+    /** Starts listening on the specified socket.  Throws an exception if
+     * another daemon is already listening there. */
+    explicit ProgrammerDaemonServer(const std::string & socketPath);
+
+    ProgrammerDaemonServer(const ProgrammerDaemonServer &) = delete;
+    ProgrammerDaemonServer & operator=(const ProgrammerDaemonServer &) = delete;
+
+    /** Closes every connection and removes the socket file. */
+    ~ProgrammerDaemonServer();
+
+    /** Serves clients until stop() is called. */
+    void run();
+
+    /** Makes run() return soon.  This can be called from another thread or
+     * from a signal handler. */
+    void stop();
+
+private:
+    // The things the daemon remembers about a programmer.  Only used on the
+    // programmer's I/O thread.
+    struct DeviceCache
+    {
+        // Responses to GET_DESCRIPTOR requests, indexed by wValue, wIndex,
+        // and wLength.
+        std::map<uint64_t, std::string> descriptors;
+
+        bool settingsValid = false;
+        ProgrammerSettings settings;
+        std::chrono::steady_clock::time_point settingsTime;
+    };
+
+    struct Device
+    {
+        ProgrammerInstance instance;
+        std::string programmingPortName;
+        std::string ttlPortName;
+
+        // These are created the first time a client uses the programmer.
+        std::shared_ptr<ProgrammerTransport> transport;
+        std::shared_ptr<AsyncProgrammerHandle> handle;
+        std::shared_ptr<DeviceCache> cache;
+    };
+
+    struct Connection
+    {
+        int socket;
+        uint64_t id;
+        std::string input;
+        std::string output;
+
+        // True while one of this client's requests is running on an I/O
+        // thread.
+        bool busy = false;
+    };
+
+    // A response made on an I/O thread, waiting to be sent by run().
+    struct Completion
+    {
+        uint64_t connectionId;
+        std::string response;
+
+        // If the programmer was disconnected, run() closes the handle so the
+        // programmer gets opened again when it comes back.
+        bool disconnected = false;
+        std::string serialNumber;
+        std::weak_ptr<AsyncProgrammerHandle> handle;
+    };
+
+    // Runs on a programmer's I/O thread and returns the response.
+    typedef std::function<std::string (ProgrammerHandle &,
+        ProgrammerTransport &, DeviceCache &)> DeviceOperation;
+
+    void addDevice(const ProgrammerInstance &);
+    void removeDevice(const ProgrammerInstance &);
+    Device * findDevice(const std::string & serialNumber);
+    void acceptConnection();
+    bool readConnection(Connection &);
+    bool handleInput(Connection &);
+    bool writeConnection(Connection &);
+    void handleRequest(Connection &, const std::string & message);
+    std::string handleList();
+    void startOperation(Connection &, const std::string & serialNumber,
+        DeviceOperation);
+    void finishOperation(Completion);
+    void handleCompletions();
+
+    std::string socketPath;
+    int listenSocket = -1;
+    std::vector<Connection> connections;
+    uint64_t nextConnectionId = 0;
+
+    // The I/O threads put their responses here and write a byte to the pipe
+    // to wake up run().
+    int wakePipe[2] = { -1, -1 };
+    std::mutex completionMutex;
+    std::vector<Completion> completions;
+
+    ProgrammerRegistry registry;
+    std::map<std::string, Device> devices;
+    std::atomic<bool> stopping;
+};
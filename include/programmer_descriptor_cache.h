@@ -0,0 +1,73 @@
+#pragma once
+
+#include "programmer.h"
+
+#include <string>
+#include <vector>
+
+/** Facts about a programmer that take a while to look up but never change
+ * while the same programmer stays plugged into the same USB port. */
+struct ProgrammerDescriptorCacheEntry
+{
+    // The firmware version string from
+    // ProgrammerHandle::getFirmwareVersionString, or empty if unknown.
+    std::string firmwareVersionString;
+
+    // The serial port names, or empty if unknown.
+    std::string programmingPortName;
+    std::string ttlPortName;
+};
+
+/** A cache file that remembers ProgrammerDescriptorCacheEntry objects between
+ * runs of the software.
+ *
+ * Entries are keyed by the serial number, OS ID, and firmware version (USB
+ * device revision) of the programmer, so an entry is ignored if a different
+ * programmer is plugged into the same port or the firmware is upgraded.
+ * Serial port names are also checked to make sure that the port still exists
+ * and, on Linux, that it still belongs to the same USB device, because the
+ * names get reused.
+ *
+ * The cache is only an optimization: a missing or corrupt file is treated as
+ * an empty cache, and errors while saving are ignored.  The file is replaced
+ * atomically, so several processes can use it at the same time. */
+class ProgrammerDescriptorCache
+{
+public:
+    /** Returns the path of the cache file in the user's cache directory
+     * ($XDG_CACHE_HOME, ~/.cache, or %LOCALAPPDATA%), or an empty string if
+     * there is no suitable directory. */
+    static std::string getDefaultPath();
+
+    /** Loads the cache from the specified file. */
+    explicit ProgrammerDescriptorCache(const std::string & path);
+
+    /** Looks up the specified programmer.  Returns true and sets the entry
+     * if it is found.  Stale entries are removed. */
+    bool lookup(const ProgrammerInstance &, ProgrammerDescriptorCacheEntry &);
+
+    /** Adds or replaces the entry for the specified programmer. */
+    void store(const ProgrammerInstance &, const ProgrammerDescriptorCacheEntry &);
+
+    /** Removes the entries for any programmers not in the specified list,
+     * which should contain every programmer that is connected. */
+    void prune(const std::vector<ProgrammerInstance> & connected);
+
+    /** Writes the cache back to its file if it was changed. */
+    void save();
+
+private:
+    struct Record
+    {
+        std::string serialNumber;
+        std::string osId;
+        uint16_t firmwareVersion;
+        ProgrammerDescriptorCacheEntry entry;
+    };
+
+    std::vector<Record>::iterator find(const ProgrammerInstance &);
+
+    std::string path;
+    std::vector<Record> records;
+    bool modified = false;
+};
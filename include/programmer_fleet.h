@@ -0,0 +1,138 @@
+#pragma once
+
+#include "programmer.h"
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** The result of running an operation on one programmer in a
+ * ProgrammerFleet.  If the operation failed, error holds the message of the
+ * exception and value holds nothing useful. */
+template <typename T>
+struct ProgrammerFleetResult
+{
+    std::string serialNumber;
+    std::string error;
+    T value = T();
+
+    bool succeeded() const
+    {
+        return error.empty();
+    }
+};
+
+/** Holds handles to many programmers and runs operations on all of them at
+ * the same time, using a pool of threads.
+ *
+ * Each operation returns one result per programmer, in the same order as the
+ * instances that were passed to the constructor.  A failure on one programmer
+ * does not affect the others.  If a programmer could not be opened, every
+ * operation on it fails with the error from opening it.
+ *
+ * Operations on the same fleet must not be run from more than one thread at a
+ * time. */
+class ProgrammerFleet
+{
+public:
+    typedef std::function<ProgrammerHandle (const ProgrammerInstance &)> Opener;
+
+    /** Opens every programmer returned by programmerGetList().  If threadCount
+     * is 0, one thread per programmer is used, up to a limit. */
+    explicit ProgrammerFleet(size_t threadCount = 0);
+
+    /** Opens the specified programmers. */
+    explicit ProgrammerFleet(const std::vector<ProgrammerInstance> &,
+        size_t threadCount = 0);
+
+    /** Opens the specified programmers with a custom function, for example
+     * to talk to them through a different transport.  The function is called
+     * from several threads at once. */
+    ProgrammerFleet(const std::vector<ProgrammerInstance> &, Opener,
+        size_t threadCount = 0);
+
+    ProgrammerFleet(const ProgrammerFleet &) = delete;
+    ProgrammerFleet & operator=(const ProgrammerFleet &) = delete;
+
+    ~ProgrammerFleet();
+
+    size_t size() const
+    {
+        return members.size();
+    }
+
+    /** Returns the result of opening each programmer. */
+    std::vector<ProgrammerFleetResult<bool>> getOpenResults() const;
+
+    std::vector<ProgrammerFleetResult<ProgrammerSettings>> getSettings();
+
+    /** Applies the same settings to every programmer.  The value of each
+     * result is true if it succeeded. */
+    std::vector<ProgrammerFleetResult<bool>> applySettings(
+        const ProgrammerSettings &);
+
+    std::vector<ProgrammerFleetResult<ProgrammerVariables>> getVariables();
+
+    std::vector<ProgrammerFleetResult<ProgrammerRestoreResult>> restoreDefaults(
+        const ProgrammerRestoreOptions & = ProgrammerRestoreOptions());
+
+    /** Runs an operation, which takes a ProgrammerHandle & and returns a T, on
+     * every programmer that was opened successfully. */
+    template <typename T, typename Operation>
+    std::vector<ProgrammerFleetResult<T>> run(Operation operation)
+    {
+        std::vector<ProgrammerFleetResult<T>> results(members.size());
+        forEach([&](size_t i)
+        {
+            Member & member = members[i];
+            results[i].serialNumber = member.instance.getSerialNumber();
+            if (!member.handle)
+            {
+                results[i].error = member.openError;
+                return;
+            }
+            try
+            {
+                results[i].value = operation(member.handle);
+            }
+            catch (const std::exception & e)
+            {
+                results[i].error = e.what();
+            }
+            catch (...)
+            {
+                results[i].error = "An unknown error occurred.";
+            }
+        });
+        return results;
+    }
+
+private:
+    struct Member
+    {
+        ProgrammerInstance instance;
+        ProgrammerHandle handle;
+        std::string openError;
+    };
+
+    void startThreads(size_t threadCount);
+    void forEach(const std::function<void (size_t)> & task);
+    void runWorker();
+
+    std::vector<Member> members;
+
+    // The thread pool.  forEach() publishes a task and the workers take
+    // indices from nextIndex until they run out.
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable taskReady;
+    std::condition_variable taskDone;
+    const std::function<void (size_t)> * task = nullptr;
+    size_t nextIndex = 0;
+    size_t remaining = 0;
+    bool stopping = false;
+};
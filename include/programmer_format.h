@@ -0,0 +1,44 @@
+#pragma once
+
+#include "programmer_sampler.h"
+
+#include <chrono>
+#include <cstddef>
+
+/** These functions write text about the programmer into a buffer supplied by
+ * the caller, without allocating any memory, so they can be used in loops that
+ * display or log samples at a high rate.
+ *
+ * Like snprintf, each one returns the length of the full text, not counting
+ * the null terminator.  If that is greater than or equal to the size of the
+ * buffer, the text was truncated.  The buffer is always null-terminated
+ * unless its size is 0.  The functions that write a line end it with a
+ * newline. */
+
+/** Writes a voltage like "123 mV". */
+size_t programmerFormatMv(char * buffer, size_t size, uint32_t mv);
+
+/** Writes the output of Programmer::convertDeviceResetToString. */
+size_t programmerFormatDeviceReset(char * buffer, size_t size,
+    uint8_t deviceReset);
+
+/** Writes the output of Programmer::convertProgrammingErrorToShortString. */
+size_t programmerFormatProgrammingError(char * buffer, size_t size,
+    uint8_t programmingError);
+
+/** Writes the header line of a CSV file for samples of the variables selected
+ * by mask.  The first column is the time in seconds. */
+size_t programmerFormatSampleCsvHeader(char * buffer, size_t size,
+    uint32_t mask);
+
+/** Writes a sample as a CSV line with the columns from
+ * programmerFormatSampleCsvHeader.  The time is measured from startTime.
+ * If the sample failed, the other columns are empty. */
+size_t programmerFormatSampleCsv(char * buffer, size_t size, uint32_t mask,
+    const ProgrammerSample &, std::chrono::steady_clock::time_point startTime);
+
+/** Writes a sample as a JSON object on one line (JSON Lines format), with the
+ * same names as the CSV columns.  If the sample failed, the object has
+ * "failed": true instead of the variables. */
+size_t programmerFormatSampleJson(char * buffer, size_t size,
+    const ProgrammerSample &, std::chrono::steady_clock::time_point startTime);
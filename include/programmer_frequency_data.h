@@ -0,0 +1,834 @@
+/** The data in this file was auto-generated.  See
+ * programmer_frequency_tables.h for comments explaining these tables.
+ *
+ * Do not include this file directly; include programmer_frequency_tables.h.
+ * The tables are constexpr, so they are initialized at compile time and can
+ * be used in constant expressions. */
+
+#pragma once
+
+struct ProgrammerFrequencyData
+{
+    static constexpr ProgrammerFrequency stk500[256] =
+    {
+        {7, "1714"},
+        {27, "444"},
+        {105, "114"},
+        {209, "57.4"},
+        {189, "63.5"},
+        {228, "52.6"},
+        {268, "44.8"},
+        {306, "39.2"},
+        {346, "34.7"},
+        {386, "31.1"},
+        {424, "28.3"},
+        {464, "25.9"},
+        {502, "23.9"},
+        {544, "22.1"},
+        {584, "20.5"},
+        {624, "19.2"},
+        {664, "18.1"},
+        {704, "17.0"},
+        {736, "16.3"},
+        {776, "15.5"},
+        {816, "14.7"},
+        {856, "14.0"},
+        {896, "13.4"},
+        {936, "12.8"},
+        {976, "12.3"},
+        {1016, "11.8"},
+        {1056, "11.4"},
+        {1088, "11.0"},
+        {1128, "10.6"},
+        {1168, "10.3"},
+        {1208, "9.93"},
+        {1248, "9.62"},
+        {1288, "9.32"},
+        {1328, "9.04"},
+        {1368, "8.77"},
+        {1400, "8.57"},
+        {1440, "8.33"},
+        {1480, "8.11"},
+        {1520, "7.89"},
+        {1560, "7.69"},
+        {1600, "7.50"},
+        {1640, "7.32"},
+        {1680, "7.14"},
+        {1720, "6.98"},
+        {1752, "6.85"},
+        {1792, "6.70"},
+        {1832, "6.55"},
+        {1872, "6.41"},
+        {1912, "6.28"},
+        {1952, "6.15"},
+        {1992, "6.02"},
+        {2032, "5.91"},
+        {2080, "5.77"},
+        {2112, "5.68"},
+        {2144, "5.60"},
+        {2208, "5.43"},
+        {2240, "5.36"},
+        {2272, "5.28"},
+        {2304, "5.21"},
+        {2368, "5.07"},
+        {2400, "5.00"},
+        {2432, "4.93"},
+        {2464, "4.87"},
+        {2496, "4.81"},
+        {2560, "4.69"},
+        {2592, "4.63"},
+        {2624, "4.57"},
+        {2656, "4.52"},
+        {2720, "4.41"},
+        {2752, "4.36"},
+        {2784, "4.31"},
+        {2816, "4.26"},
+        {2848, "4.21"},
+        {2912, "4.12"},
+        {2944, "4.08"},
+        {2976, "4.03"},
+        {3008, "3.99"},
+        {3072, "3.91"},
+        {3104, "3.87"},
+        {3136, "3.83"},
+        {3168, "3.79"},
+        {3200, "3.75"},
+        {3264, "3.68"},
+        {3296, "3.64"},
+        {3328, "3.61"},
+        {3360, "3.57"},
+        {3392, "3.54"},
+        {3456, "3.47"},
+        {3488, "3.44"},
+        {3520, "3.41"},
+        {3552, "3.38"},
+        {3616, "3.32"},
+        {3648, "3.29"},
+        {3680, "3.26"},
+        {3712, "3.23"},
+        {3744, "3.21"},
+        {3808, "3.15"},
+        {3840, "3.13"},
+        {3872, "3.10"},
+        {3904, "3.07"},
+        {3968, "3.02"},
+        {4000, "3.00"},
+        {4032, "2.98"},
+        {4064, "2.95"},
+        {4096, "2.93"},
+        {4160, "2.88"},
+        {4192, "2.86"},
+        {4224, "2.84"},
+        {4256, "2.82"},
+        {4320, "2.78"},
+        {4352, "2.76"},
+        {4384, "2.74"},
+        {4416, "2.72"},
+        {4448, "2.70"},
+        {4512, "2.66"},
+        {4544, "2.64"},
+        {4576, "2.62"},
+        {4608, "2.60"},
+        {4672, "2.57"},
+        {4704, "2.55"},
+        {4736, "2.53"},
+        {4768, "2.52"},
+        {4800, "2.50"},
+        {4864, "2.47"},
+        {4896, "2.45"},
+        {4928, "2.44"},
+        {4960, "2.42"},
+        {5024, "2.39"},
+        {5056, "2.37"},
+        {5088, "2.36"},
+        {5120, "2.34"},
+        {5152, "2.33"},
+        {5216, "2.30"},
+        {5248, "2.29"},
+        {5280, "2.27"},
+        {5312, "2.26"},
+        {5376, "2.23"},
+        {5408, "2.22"},
+        {5440, "2.21"},
+        {5472, "2.19"},
+        {5504, "2.18"},
+        {5568, "2.16"},
+        {5600, "2.14"},
+        {5632, "2.13"},
+        {5664, "2.12"},
+        {5728, "2.09"},
+        {5760, "2.08"},
+        {5792, "2.07"},
+        {5824, "2.06"},
+        {5856, "2.05"},
+        {5920, "2.03"},
+        {5952, "2.02"},
+        {5984, "2.01"},
+        {6016, "1.995"},
+        {6080, "1.974"},
+        {6112, "1.963"},
+        {6144, "1.953"},
+        {6176, "1.943"},
+        {6208, "1.933"},
+        {6272, "1.913"},
+        {6304, "1.904"},
+        {6336, "1.894"},
+        {6368, "1.884"},
+        {6400, "1.875"},
+        {6464, "1.856"},
+        {6496, "1.847"},
+        {6528, "1.838"},
+        {6560, "1.829"},
+        {6624, "1.812"},
+        {6656, "1.803"},
+        {6688, "1.794"},
+        {6720, "1.786"},
+        {6752, "1.777"},
+        {6816, "1.761"},
+        {6848, "1.752"},
+        {6880, "1.744"},
+        {6912, "1.736"},
+        {6976, "1.720"},
+        {7008, "1.712"},
+        {7040, "1.705"},
+        {7072, "1.697"},
+        {7104, "1.689"},
+        {7168, "1.674"},
+        {7200, "1.667"},
+        {7232, "1.659"},
+        {7264, "1.652"},
+        {7328, "1.638"},
+        {7360, "1.630"},
+        {7392, "1.623"},
+        {7424, "1.616"},
+        {7456, "1.609"},
+        {7520, "1.596"},
+        {7552, "1.589"},
+        {7584, "1.582"},
+        {7616, "1.576"},
+        {7680, "1.563"},
+        {7712, "1.556"},
+        {7744, "1.550"},
+        {7776, "1.543"},
+        {7808, "1.537"},
+        {7872, "1.524"},
+        {7904, "1.518"},
+        {7936, "1.512"},
+        {7968, "1.506"},
+        {8032, "1.494"},
+        {8064, "1.488"},
+        {8096, "1.482"},
+        {8128, "1.476"},
+        {8160, "1.471"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+        {8192, "1.465"},
+    };
+
+    static constexpr ProgrammerFrequency fullMax[256] =
+    {
+        {2, "6000"},
+        {2, "6000"},
+        {2, "6000"},
+        {3, "4000"},
+        {4, "3000"},
+        {5, "2400"},
+        {6, "2000"},
+        {7, "1714"},
+        {8, "1500"},
+        {9, "1333"},
+        {10, "1200"},
+        {11, "1091"},
+        {12, "1000"},
+        {13, "923"},
+        {14, "857"},
+        {15, "800"},
+        {16, "750"},
+        {17, "706"},
+        {18, "667"},
+        {19, "632"},
+        {20, "600"},
+        {21, "571"},
+        {22, "545"},
+        {23, "522"},
+        {24, "500"},
+        {25, "480"},
+        {26, "462"},
+        {27, "444"},
+        {28, "429"},
+        {29, "414"},
+        {30, "400"},
+        {31, "387"},
+        {32, "375"},
+        {33, "364"},
+        {34, "353"},
+        {35, "343"},
+        {36, "333"},
+        {37, "324"},
+        {38, "316"},
+        {39, "308"},
+        {40, "300"},
+        {41, "293"},
+        {42, "286"},
+        {43, "279"},
+        {44, "273"},
+        {45, "267"},
+        {46, "261"},
+        {47, "255"},
+        {48, "250"},
+        {49, "245"},
+        {50, "240"},
+        {51, "235"},
+        {52, "231"},
+        {53, "226"},
+        {54, "222"},
+        {55, "218"},
+        {56, "214"},
+        {57, "211"},
+        {58, "207"},
+        {59, "203"},
+        {60, "200"},
+        {61, "197"},
+        {62, "194"},
+        {63, "190"},
+        {64, "188"},
+        {65, "185"},
+        {66, "182"},
+        {67, "179"},
+        {68, "176"},
+        {69, "174"},
+        {70, "171"},
+        {71, "169"},
+        {72, "167"},
+        {73, "164"},
+        {74, "162"},
+        {75, "160"},
+        {76, "158"},
+        {77, "156"},
+        {78, "154"},
+        {79, "152"},
+        {80, "150"},
+        {81, "148"},
+        {82, "146"},
+        {83, "145"},
+        {84, "143"},
+        {85, "141"},
+        {86, "140"},
+        {87, "138"},
+        {88, "136"},
+        {89, "135"},
+        {90, "133"},
+        {91, "132"},
+        {92, "130"},
+        {93, "129"},
+        {94, "128"},
+        {95, "126"},
+        {96, "125"},
+        {97, "124"},
+        {98, "122"},
+        {99, "121"},
+        {100, "120"},
+        {101, "119"},
+        {102, "118"},
+        {103, "117"},
+        {104, "115"},
+        {105, "114"},
+        {106, "113"},
+        {107, "112"},
+        {108, "111"},
+        {109, "110"},
+        {110, "109"},
+        {111, "108"},
+        {112, "107"},
+        {113, "106"},
+        {114, "105"},
+        {115, "104"},
+        {116, "103"},
+        {117, "103"},
+        {118, "102"},
+        {119, "101"},
+        {120, "100"},
+        {121, "99.2"},
+        {122, "98.4"},
+        {123, "97.6"},
+        {124, "96.8"},
+        {125, "96.0"},
+        {126, "95.2"},
+        {127, "94.5"},
+        {128, "93.8"},
+        {129, "93.0"},
+        {130, "92.3"},
+        {131, "91.6"},
+        {132, "90.9"},
+        {133, "90.2"},
+        {134, "89.6"},
+        {135, "88.9"},
+        {136, "88.2"},
+        {137, "87.6"},
+        {138, "87.0"},
+        {139, "86.3"},
+        {140, "85.7"},
+        {141, "85.1"},
+        {142, "84.5"},
+        {143, "83.9"},
+        {144, "83.3"},
+        {145, "82.8"},
+        {146, "82.2"},
+        {147, "81.6"},
+        {148, "81.1"},
+        {149, "80.5"},
+        {150, "80.0"},
+        {151, "79.5"},
+        {152, "78.9"},
+        {153, "78.4"},
+        {154, "77.9"},
+        {155, "77.4"},
+        {156, "76.9"},
+        {157, "76.4"},
+        {158, "75.9"},
+        {159, "75.5"},
+        {160, "75.0"},
+        {161, "74.5"},
+        {162, "74.1"},
+        {163, "73.6"},
+        {164, "73.2"},
+        {165, "72.7"},
+        {166, "72.3"},
+        {167, "71.9"},
+        {168, "71.4"},
+        {169, "71.0"},
+        {170, "70.6"},
+        {171, "70.2"},
+        {172, "69.8"},
+        {173, "69.4"},
+        {174, "69.0"},
+        {175, "68.6"},
+        {176, "68.2"},
+        {177, "67.8"},
+        {178, "67.4"},
+        {179, "67.0"},
+        {180, "66.7"},
+        {181, "66.3"},
+        {182, "65.9"},
+        {183, "65.6"},
+        {184, "65.2"},
+        {185, "64.9"},
+        {186, "64.5"},
+        {187, "64.2"},
+        {188, "63.8"},
+        {189, "63.5"},
+        {190, "63.2"},
+        {191, "62.8"},
+        {192, "62.5"},
+        {193, "62.2"},
+        {194, "61.9"},
+        {195, "61.5"},
+        {196, "61.2"},
+        {197, "60.9"},
+        {198, "60.6"},
+        {199, "60.3"},
+        {200, "60.0"},
+        {201, "59.7"},
+        {202, "59.4"},
+        {203, "59.1"},
+        {204, "58.8"},
+        {205, "58.5"},
+        {206, "58.3"},
+        {207, "58.0"},
+        {208, "57.7"},
+        {209, "57.4"},
+        {210, "57.1"},
+        {211, "56.9"},
+        {212, "56.6"},
+        {213, "56.3"},
+        {214, "56.1"},
+        {215, "55.8"},
+        {216, "55.6"},
+        {217, "55.3"},
+        {218, "55.0"},
+        {219, "54.8"},
+        {220, "54.5"},
+        {221, "54.3"},
+        {222, "54.1"},
+        {223, "53.8"},
+        {224, "53.6"},
+        {225, "53.3"},
+        {226, "53.1"},
+        {227, "52.9"},
+        {228, "52.6"},
+        {229, "52.4"},
+        {230, "52.2"},
+        {231, "51.9"},
+        {232, "51.7"},
+        {233, "51.5"},
+        {234, "51.3"},
+        {235, "51.1"},
+        {236, "50.8"},
+        {237, "50.6"},
+        {238, "50.4"},
+        {239, "50.2"},
+        {240, "50.0"},
+        {241, "49.8"},
+        {242, "49.6"},
+        {243, "49.4"},
+        {244, "49.2"},
+        {245, "49.0"},
+        {246, "48.8"},
+        {247, "48.6"},
+        {248, "48.4"},
+        {249, "48.2"},
+        {250, "48.0"},
+        {251, "47.8"},
+        {252, "47.6"},
+        {253, "47.4"},
+        {254, "47.2"},
+        {255, "47.1"},
+    };
+
+    static constexpr ProgrammerFrequency allowedMax[25] =
+    {
+        {2, "6000"},
+        {3, "4000"},
+        {4, "3000"},
+        {5, "2400"},
+        {6, "2000"},
+        {7, "1714"},
+        {8, "1500"},
+        {9, "1333"},
+        {10, "1200"},
+        {11, "1091"},
+        {12, "1000"},
+        {13, "923"},
+        {14, "857"},
+        {15, "800"},
+        {16, "750"},
+        {17, "706"},
+        {18, "667"},
+        {19, "632"},
+        {20, "600"},
+        {21, "571"},
+        {22, "545"},
+        {23, "522"},
+        {24, "500"},
+        {25, "480"},
+        {26, "462"},
+    };
+
+    static constexpr ProgrammerFrequency suggestedMax[8] =
+    {
+        {4, "3000"},
+        {5, "2400"},
+        {6, "2000"},
+        {7, "1714"},
+        {8, "1500"},
+        {10, "1200"},
+        {12, "1000"},
+        {16, "750"},
+    };
+
+    static constexpr ProgrammerFrequency allowed[234] =
+    {
+        {2, "6000"},
+        {3, "4000"},
+        {4, "3000"},
+        {5, "2400"},
+        {6, "2000"},
+        {7, "1714"},
+        {8, "1500"},
+        {9, "1333"},
+        {10, "1200"},
+        {11, "1091"},
+        {12, "1000"},
+        {13, "923"},
+        {14, "857"},
+        {15, "800"},
+        {16, "750"},
+        {17, "706"},
+        {18, "667"},
+        {19, "632"},
+        {20, "600"},
+        {21, "571"},
+        {22, "545"},
+        {23, "522"},
+        {24, "500"},
+        {25, "480"},
+        {26, "462"},
+        {27, "444"},
+        {105, "114"},
+        {189, "63.5"},
+        {209, "57.4"},
+        {228, "52.6"},
+        {268, "44.8"},
+        {306, "39.2"},
+        {346, "34.7"},
+        {386, "31.1"},
+        {424, "28.3"},
+        {464, "25.9"},
+        {502, "23.9"},
+        {544, "22.1"},
+        {584, "20.5"},
+        {624, "19.2"},
+        {664, "18.1"},
+        {704, "17.0"},
+        {736, "16.3"},
+        {776, "15.5"},
+        {816, "14.7"},
+        {856, "14.0"},
+        {896, "13.4"},
+        {936, "12.8"},
+        {976, "12.3"},
+        {1016, "11.8"},
+        {1056, "11.4"},
+        {1088, "11.0"},
+        {1128, "10.6"},
+        {1168, "10.3"},
+        {1208, "9.93"},
+        {1248, "9.62"},
+        {1288, "9.32"},
+        {1328, "9.04"},
+        {1368, "8.77"},
+        {1400, "8.57"},
+        {1440, "8.33"},
+        {1480, "8.11"},
+        {1520, "7.89"},
+        {1560, "7.69"},
+        {1600, "7.50"},
+        {1640, "7.32"},
+        {1680, "7.14"},
+        {1720, "6.98"},
+        {1752, "6.85"},
+        {1792, "6.70"},
+        {1832, "6.55"},
+        {1872, "6.41"},
+        {1912, "6.28"},
+        {1952, "6.15"},
+        {1992, "6.02"},
+        {2032, "5.91"},
+        {2080, "5.77"},
+        {2112, "5.68"},
+        {2144, "5.60"},
+        {2208, "5.43"},
+        {2240, "5.36"},
+        {2272, "5.28"},
+        {2304, "5.21"},
+        {2368, "5.07"},
+        {2400, "5.00"},
+        {2432, "4.93"},
+        {2464, "4.87"},
+        {2496, "4.81"},
+        {2560, "4.69"},
+        {2592, "4.63"},
+        {2624, "4.57"},
+        {2656, "4.52"},
+        {2720, "4.41"},
+        {2752, "4.36"},
+        {2784, "4.31"},
+        {2816, "4.26"},
+        {2848, "4.21"},
+        {2912, "4.12"},
+        {2944, "4.08"},
+        {2976, "4.03"},
+        {3008, "3.99"},
+        {3072, "3.91"},
+        {3104, "3.87"},
+        {3136, "3.83"},
+        {3168, "3.79"},
+        {3200, "3.75"},
+        {3264, "3.68"},
+        {3296, "3.64"},
+        {3328, "3.61"},
+        {3360, "3.57"},
+        {3392, "3.54"},
+        {3456, "3.47"},
+        {3488, "3.44"},
+        {3520, "3.41"},
+        {3552, "3.38"},
+        {3616, "3.32"},
+        {3648, "3.29"},
+        {3680, "3.26"},
+        {3712, "3.23"},
+        {3744, "3.21"},
+        {3808, "3.15"},
+        {3840, "3.13"},
+        {3872, "3.10"},
+        {3904, "3.07"},
+        {3968, "3.02"},
+        {4000, "3.00"},
+        {4032, "2.98"},
+        {4064, "2.95"},
+        {4096, "2.93"},
+        {4160, "2.88"},
+        {4192, "2.86"},
+        {4224, "2.84"},
+        {4256, "2.82"},
+        {4320, "2.78"},
+        {4352, "2.76"},
+        {4384, "2.74"},
+        {4416, "2.72"},
+        {4448, "2.70"},
+        {4512, "2.66"},
+        {4544, "2.64"},
+        {4576, "2.62"},
+        {4608, "2.60"},
+        {4672, "2.57"},
+        {4704, "2.55"},
+        {4736, "2.53"},
+        {4768, "2.52"},
+        {4800, "2.50"},
+        {4864, "2.47"},
+        {4896, "2.45"},
+        {4928, "2.44"},
+        {4960, "2.42"},
+        {5024, "2.39"},
+        {5056, "2.37"},
+        {5088, "2.36"},
+        {5120, "2.34"},
+        {5152, "2.33"},
+        {5216, "2.30"},
+        {5248, "2.29"},
+        {5280, "2.27"},
+        {5312, "2.26"},
+        {5376, "2.23"},
+        {5408, "2.22"},
+        {5440, "2.21"},
+        {5472, "2.19"},
+        {5504, "2.18"},
+        {5568, "2.16"},
+        {5600, "2.14"},
+        {5632, "2.13"},
+        {5664, "2.12"},
+        {5728, "2.09"},
+        {5760, "2.08"},
+        {5792, "2.07"},
+        {5824, "2.06"},
+        {5856, "2.05"},
+        {5920, "2.03"},
+        {5952, "2.02"},
+        {5984, "2.01"},
+        {6016, "1.995"},
+        {6080, "1.974"},
+        {6112, "1.963"},
+        {6144, "1.953"},
+        {6176, "1.943"},
+        {6208, "1.933"},
+        {6272, "1.913"},
+        {6304, "1.904"},
+        {6336, "1.894"},
+        {6368, "1.884"},
+        {6400, "1.875"},
+        {6464, "1.856"},
+        {6496, "1.847"},
+        {6528, "1.838"},
+        {6560, "1.829"},
+        {6624, "1.812"},
+        {6656, "1.803"},
+        {6688, "1.794"},
+        {6720, "1.786"},
+        {6752, "1.777"},
+        {6816, "1.761"},
+        {6848, "1.752"},
+        {6880, "1.744"},
+        {6912, "1.736"},
+        {6976, "1.720"},
+        {7008, "1.712"},
+        {7040, "1.705"},
+        {7072, "1.697"},
+        {7104, "1.689"},
+        {7168, "1.674"},
+        {7200, "1.667"},
+        {7232, "1.659"},
+        {7264, "1.652"},
+        {7328, "1.638"},
+        {7360, "1.630"},
+        {7392, "1.623"},
+        {7424, "1.616"},
+        {7456, "1.609"},
+        {7520, "1.596"},
+        {7552, "1.589"},
+        {7584, "1.582"},
+        {7616, "1.576"},
+        {7680, "1.563"},
+        {7712, "1.556"},
+        {7744, "1.550"},
+        {7776, "1.543"},
+        {7808, "1.537"},
+        {7872, "1.524"},
+        {7904, "1.518"},
+        {7936, "1.512"},
+        {7968, "1.506"},
+        {8032, "1.494"},
+        {8064, "1.488"},
+        {8096, "1.482"},
+        {8128, "1.476"},
+        {8160, "1.471"},
+        {8192, "1.465"},
+    };
+
+    static constexpr ProgrammerFrequency suggested[16] =
+    {
+        {4, "3000"},
+        {5, "2400"},
+        {6, "2000"},
+        {7, "1714"},
+        {8, "1500"},
+        {10, "1200"},
+        {12, "1000"},
+        {16, "750"},
+        {27, "444"},
+        {105, "114"},
+        {424, "28.3"},
+        {856, "14.0"},
+        {1720, "6.98"},
+        {3456, "3.47"},
+        {6880, "1.744"},
+        {8192, "1.465"},
+    };
+
+    static constexpr ProgrammerFrequency defaultFrequency = {105, "114"};
+
+    static constexpr ProgrammerFrequency defaultMaxFrequency = {7, "1714"};
+};
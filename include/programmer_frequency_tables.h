@@ -1,7 +1,7 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <vector>
 
 struct ProgrammerFrequency
 {
@@ -13,6 +13,46 @@ struct ProgrammerFrequency
     const char * name;
 };
 
+/** A read-only view of one of the frequency tables below.  It can be indexed
+ * and iterated over like a std::vector, and it can be used in constant
+ * expressions. */
+class ProgrammerFrequencyTable
+{
+public:
+    constexpr ProgrammerFrequencyTable()
+        : data_(nullptr), size_(0)
+    {
+    }
+
+    template <size_t N>
+    constexpr ProgrammerFrequencyTable(const ProgrammerFrequency (&array)[N])
+        : data_(array), size_(N)
+    {
+    }
+
+    constexpr size_t size() const { return size_; }
+    constexpr bool empty() const { return size_ == 0; }
+
+    constexpr const ProgrammerFrequency & operator[](size_t index) const
+    {
+        return data_[index];
+    }
+
+    constexpr const ProgrammerFrequency & back() const
+    {
+        return data_[size_ - 1];
+    }
+
+    constexpr const ProgrammerFrequency * begin() const { return data_; }
+    constexpr const ProgrammerFrequency * end() const { return data_ + size_; }
+
+private:
+    const ProgrammerFrequency * data_;
+    size_t size_;
+};
+
+#include "programmer_frequency_data.h"
+
 /** This table defines how the meaning of the SCK_DURATION parameter of the
  * programmer's firmware works.
  *
@@ -35,7 +75,8 @@ struct ProgrammerFrequency
  * HOWEVER, an exception to the rule above is that we cannot have frequencies
  * below 1.465 kHz, so any frequency below that gets rounded.
  */
-extern const std::vector<ProgrammerFrequency> programmerStk500FrequencyTable;
+constexpr ProgrammerFrequencyTable programmerStk500FrequencyTable =
+    ProgrammerFrequencyData::stk500;
 
 /** This table defines the meaning of the ISP_FASTEST_PERIOD parameter of the
  * programmer's firmware.
@@ -47,7 +88,8 @@ extern const std::vector<ProgrammerFrequency> programmerStk500FrequencyTable;
  *
  *    frequency = (12 MHz) / index
  */
-extern const std::vector<ProgrammerFrequency> programmerFullMaxFrequencyTable;
+constexpr ProgrammerFrequencyTable programmerFullMaxFrequencyTable =
+    ProgrammerFrequencyData::fullMax;
 
 /** This table holds the set of frequencies that the software allows you to set
  * for the "Max ISP Frequency" setting, which corresponds to the
@@ -56,7 +98,8 @@ extern const std::vector<ProgrammerFrequency> programmerFullMaxFrequencyTable;
  * This table could also be computed by selecting the elements from
  * programmerFullMaxFrequencyTable that have a period between
  * PAVR2_ISP_FASTEST_PERIOD_MIN and PAVR2_ISP_FASTEST_PERIOD_MAX. */
-extern const std::vector<ProgrammerFrequency> programmerAllowedMaxFrequencyTable;
+constexpr ProgrammerFrequencyTable programmerAllowedMaxFrequencyTable =
+    ProgrammerFrequencyData::allowedMax;
 
 /** This table holds a useful subset of programmerAllowedMaxFrequencyTable.
  * This allows us to show a nice selection of choices in a user interface
@@ -64,7 +107,8 @@ extern const std::vector<ProgrammerFrequency> programmerAllowedMaxFrequencyTable
  *
  * This table could also be computed by taking all the frequencies in both
  * programmerSuggestedFrequencyTable and programmerAllowedMaxFrequencyTable. */
-extern const std::vector<ProgrammerFrequency> programmerSuggestedMaxFrequencyTable;
+constexpr ProgrammerFrequencyTable programmerSuggestedMaxFrequencyTable =
+    ProgrammerFrequencyData::suggestedMax;
 
 /** This table holds the set of frequencies that the software allows you to set
  * for the "ISP Frequency" setting, which is related to two firmware parameters:
@@ -74,16 +118,47 @@ extern const std::vector<ProgrammerFrequency> programmerSuggestedMaxFrequencyTab
  * programmerStk500FrequencyTable, prepending the table with
  * programmerAllowedMaxFrequencyTable, removing the duplicates at the end, and
  * sorting the table in descending order by frequency. */
-extern const std::vector<ProgrammerFrequency> programmerAllowedFrequencyTable;
+constexpr ProgrammerFrequencyTable programmerAllowedFrequencyTable =
+    ProgrammerFrequencyData::allowed;
 
 /** This table holds a useful subset of programmerAllowedFrequencyTable.  The highest
  * frequencies are picked somewhat arbitrarily.  Many of these frequencies were
  * picked to match the user interface of Atmel Studio, which has notches for
  * theose frequencies that make them easy to select by just using the mouse. */
-extern const std::vector<ProgrammerFrequency> programmerSuggestedFrequencyTable;
+constexpr ProgrammerFrequencyTable programmerSuggestedFrequencyTable =
+    ProgrammerFrequencyData::suggested;
 
 /** The default frequency of the firmware. */
-extern const ProgrammerFrequency programmerDefaultFrequency;
+constexpr ProgrammerFrequency programmerDefaultFrequency =
+    ProgrammerFrequencyData::defaultFrequency;
 
 /** The default max frequency of the firmware. */
-extern const ProgrammerFrequency programmerDefaultMaxFrequency;
+constexpr ProgrammerFrequency programmerDefaultMaxFrequency =
+    ProgrammerFrequencyData::defaultMaxFrequency;
+
+/** The functions below find frequencies in the tables above in constant time.
+ * The first call builds an index, which lives in static memory (there are no
+ * heap allocations), and throws an exception in the unlikely case that the
+ * index cannot be built.  They return the index of the first matching element
+ * in the table, or -1 if there is none. */
+
+int32_t programmerStk500FrequencyFindByName(const char * name);
+int32_t programmerStk500FrequencyFindByPeriod(uint32_t period);
+int32_t programmerAllowedMaxFrequencyFindByName(const char * name);
+
+/** This one does not need an index because the periods in
+ * programmerAllowedMaxFrequencyTable are consecutive. */
+constexpr int32_t programmerAllowedMaxFrequencyFindByPeriod(uint32_t period)
+{
+    return (period >= programmerAllowedMaxFrequencyTable[0].period &&
+        period <= programmerAllowedMaxFrequencyTable.back().period) ?
+        (int32_t)(period - programmerAllowedMaxFrequencyTable[0].period) : -1;
+}
+
+/** Searches a table that is sorted by period, like
+ * programmerAllowedFrequencyTable, for the fastest frequency that does not
+ * exceed the specified frequency in Hz.  This uses a binary search.  Returns
+ * the index of the frequency, or -1 if every frequency in the table is too
+ * fast. */
+int32_t programmerFrequencyFindAtMost(ProgrammerFrequencyTable table,
+    double frequencyHz);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "programmer.h"
+
+#include <map>
+#include <string>
+
+/** A settings profile is a small text file that holds some or all of the
+ * settings of a programmer, so the same settings can be applied to many
+ * programmers.  It looks like this:
+ *
+ *     # Pololu USB AVR Programmer v2 settings profile
+ *     profile_version: 1
+ *     isp_frequency_khz: 114
+ *     regulator_mode: auto
+ *     line_a_function: dtr-reset
+ *
+ * The profile_version line must come before the settings.  Each setting can
+ * only appear once, and settings that are not in the profile are left alone
+ * when it is applied.  The names of the settings are the same as in the JSON
+ * and YAML output of the command-line utility, and the values are like the
+ * ones its options accept.  Frequencies are names from the frequency tables,
+ * resolved with Programmer::setFrequency and Programmer::setMaxFrequency.
+ *
+ * Every value is checked when the profile is parsed, so applying a profile
+ * never fails. */
+class ProgrammerSettingsProfile
+{
+public:
+    /** Makes an empty profile. */
+    ProgrammerSettingsProfile();
+
+    /** Makes a profile that has every setting. */
+    explicit ProgrammerSettingsProfile(const ProgrammerSettings &);
+
+    /** Parses the text of a profile.  Throws an exception that says which
+     * line is wrong if the profile is invalid. */
+    static ProgrammerSettingsProfile parse(const std::string & text);
+
+    /** Reads and parses a profile file. */
+    static ProgrammerSettingsProfile load(const std::string & fileName);
+
+    std::string toString() const;
+
+    void save(const std::string & fileName) const;
+
+    bool empty() const
+    {
+        return values.empty();
+    }
+
+    /** Changes the settings that are in the profile.  If the other settings
+     * were read from the programmer, ProgrammerHandle::applySettings will
+     * then only write the ones that actually differ. */
+    void applyTo(ProgrammerSettings &) const;
+
+private:
+    // The values of the settings in the profile, indexed by name.
+    std::map<std::string, std::string> values;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "programmer.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct udev;
+struct udev_monitor;
+struct udev_device;
+
+/** Keeps an up-to-date list of the connected programmers without scanning
+ * every USB device on the system each time the list is needed.
+ *
+ * The list is built once by the constructor.  On Linux, the registry then
+ * listens for hotplug events from udev with a libudev monitor.  Removals are
+ * applied directly to the list, and the USB devices are only scanned again
+ * when a device with our vendor ID is added, so unrelated devices being
+ * plugged in or unplugged cost almost nothing.
+ *
+ * On other operating systems, or if the monitor cannot be created (for
+ * example, because udev is not running), every call to update() simply scans
+ * the USB devices again like programmerGetList() does.
+ *
+ * The registry does not start any threads.  Events are only processed, and
+ * callbacks only called, from inside update(). */
+class ProgrammerRegistry
+{
+public:
+    typedef std::function<void (const ProgrammerInstance &)> Callback;
+
+    ProgrammerRegistry();
+
+    ProgrammerRegistry(const ProgrammerRegistry &) = delete;
+    ProgrammerRegistry & operator=(const ProgrammerRegistry &) = delete;
+
+    ~ProgrammerRegistry();
+
+    /** Processes any pending hotplug events without waiting for more. */
+    void update();
+
+    /** Discards the list and scans the USB devices again. */
+    void rescan();
+
+    const std::vector<ProgrammerInstance> & getList() const
+    {
+        return list;
+    }
+
+    /** Returns true if the registry is receiving hotplug events, and false if
+     * update() falls back to scanning the USB devices. */
+    bool isEventDriven() const
+    {
+        return monitor != NULL;
+    }
+
+    /** Sets a function to be called from update() or rescan() for each
+     * programmer added to the list. */
+    void onAdded(Callback);
+
+    /** Sets a function to be called from update() or rescan() for each
+     * programmer removed from the list. */
+    void onRemoved(Callback);
+
+private:
+    void openMonitor();
+    void closeMonitor();
+    bool handleEvent(struct udev_device *);
+    void remove(const std::string & osId);
+
+    std::vector<ProgrammerInstance> list;
+    Callback addedCallback;
+    Callback removedCallback;
+    struct udev * udev = NULL;
+    struct udev_monitor * monitor = NULL;
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "programmer.h"
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+/** Controls how ResilientProgrammerHandle recovers from losing the
+ * connection to the programmer. */
+struct ProgrammerReconnectOptions
+{
+    // How long to wait for the programmer to come back, measured from the
+    // first failure of an operation.
+    uint32_t timeoutMs = 5000;
+
+    // How long to wait between attempts to find and open the programmer.
+    uint32_t pollIntervalMs = 10;
+
+    // If true, the settings from the last successful call to applySettings
+    // are applied again after reconnecting, in case the programmer lost them.
+    bool restoreSettings = false;
+
+    // Finds and opens the programmer with the specified serial number,
+    // returning a closed handle if it is not present.  If this is not set,
+    // programmerFindBySerial is used.  This is mainly useful for testing.
+    std::function<ProgrammerHandle (const std::string & serialNumber)> open;
+};
+
+/** Wraps a ProgrammerHandle and transparently reconnects to the programmer if
+ * it re-enumerates, e.g. because of a glitch on a USB hub or a brown-out
+ * reset.
+ *
+ * When an operation fails because a transfer failed (other than being
+ * rejected with a STALL or failing with PROGRAMMER_TRANSPORT_ERROR_NO_RESPONSE),
+ * the handle is closed and the programmer with the same serial number is
+ * opened again as soon as it reappears.  Then the operation is retried.  If the programmer does not come back within the
+ * timeout, the operation throws the original error.
+ *
+ * Operations other than reading are retried too, so they should be ones that
+ * are safe to do twice.  All of the operations provided here are.
+ *
+ * Like ProgrammerHandle, this class must not be used from several threads at
+ * once. */
+class ResilientProgrammerHandle
+{
+public:
+    explicit ResilientProgrammerHandle(const ProgrammerHandle &,
+        const ProgrammerReconnectOptions & = ProgrammerReconnectOptions());
+
+    /** Returns the current handle.  It changes when the programmer is
+     * reconnected, and it is closed while the programmer is missing. */
+    const ProgrammerHandle & getHandle() const
+    {
+        return handle;
+    }
+
+    const std::string & getSerialNumber() const
+    {
+        return serialNumber;
+    }
+
+    /** Returns the number of times the programmer was reconnected. */
+    uint32_t getReconnectCount() const
+    {
+        return reconnectCount;
+    }
+
+    /** Sets a function to be called after each reconnection. */
+    void onReconnect(std::function<void ()>);
+
+    ProgrammerSettings getSettings();
+
+    void applySettings(const ProgrammerSettings &);
+
+    ProgrammerRestoreResult restoreDefaults(
+        const ProgrammerRestoreOptions & = ProgrammerRestoreOptions());
+
+    ProgrammerVariables getVariables();
+
+    ProgrammerPartialVariables getVariables(uint32_t mask);
+
+    ProgrammerDigitalReadings digitalRead();
+
+    /** Runs an arbitrary operation, which takes a ProgrammerHandle & and
+     * returns a T, reconnecting and retrying it as needed.  T must be default
+     * constructible. */
+    template <typename T, typename Operation>
+    T run(Operation operation)
+    {
+        T result = T();
+        runWithRecovery([&](ProgrammerHandle & h) { result = operation(h); });
+        return result;
+    }
+
+private:
+    void runWithRecovery(const std::function<void (ProgrammerHandle &)> &);
+    void reconnect(std::chrono::steady_clock::time_point deadline);
+    bool tryReconnect();
+
+    ProgrammerHandle handle;
+    std::string serialNumber;
+    ProgrammerReconnectOptions options;
+    ProgrammerRetryPolicy retryPolicy;
+    std::function<void ()> reconnectCallback;
+    uint32_t reconnectCount = 0;
+
+    bool hasLastSettings = false;
+    ProgrammerSettings lastSettings;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "programmer.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** A timestamped reading of some of the programmer's variables. */
+struct ProgrammerSample
+{
+    // The time when the sampler started reading the variables.
+    std::chrono::steady_clock::time_point time;
+
+    // True if reading the variables failed.  In that case, variables holds
+    // nothing valid.
+    bool failed = false;
+
+    ProgrammerPartialVariables variables;
+};
+
+/** Polls the variables of a programmer at a fixed rate on its own thread and
+ * stores the samples in a lock-free ring buffer, so the thread that consumes
+ * them never has to wait for USB transfers.
+ *
+ * The sampler uses its own copy of the handle.  The copy shares the transport
+ * of the original handle, so the original can still be used (e.g. to apply
+ * settings) on another thread while the sampler is running.  The device will
+ * not be released until the sampler is destroyed.
+ *
+ * The ring buffer has a single producer (the sampler thread) and supports a
+ * single consumer, which is any one thread that calls pop().  If the consumer
+ * falls behind and the buffer fills up, new samples are dropped. */
+class ProgrammerSampler
+{
+public:
+    /** mask selects the variables to read, as in
+     * ProgrammerHandle::getVariables(uint32_t).  capacity is the maximum number
+     * of samples that can wait in the buffer. */
+    ProgrammerSampler(const ProgrammerHandle &, uint32_t mask,
+        std::chrono::microseconds interval, size_t capacity = 256);
+
+    ProgrammerSampler(const ProgrammerSampler &) = delete;
+    ProgrammerSampler & operator=(const ProgrammerSampler &) = delete;
+
+    /** Stops the sampler thread if it is running. */
+    ~ProgrammerSampler();
+
+    void start();
+
+    /** Stops the sampler thread and waits for it to finish.  Samples in the
+     * buffer can still be popped afterwards. */
+    void stop();
+
+    /** Removes the oldest sample from the buffer and stores it in the
+     * argument.  Returns false if the buffer is empty. */
+    bool pop(ProgrammerSample &);
+
+    /** Returns the number of samples that were dropped because the buffer was
+     * full. */
+    uint64_t getDroppedCount() const;
+
+private:
+    void run();
+    void push(const ProgrammerSample &);
+
+    ProgrammerHandle handle;
+    uint32_t mask;
+    std::chrono::microseconds interval;
+
+    // The ring buffer has one more slot than its capacity so that a full
+    // buffer can be distinguished from an empty one.  writeIndex is only
+    // changed by the sampler thread and readIndex only by the consumer.
+    std::vector<ProgrammerSample> buffer;
+    std::atomic<size_t> writeIndex;
+    std::atomic<size_t> readIndex;
+    std::atomic<uint64_t> droppedCount;
+
+    std::thread thread;
+    std::mutex stopMutex;
+    std::condition_variable stopCondition;
+    bool stopRequested = false;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "programmer.h"
+
+#include <mutex>
+#include <chrono>
+
+/** Simulates the firmware of a Pololu USB AVR Programmer v2 (pgm04a) so that
+ * the library and the programs built on it can be tested and benchmarked
+ * without any hardware.
+ *
+ * The simulator models the settings table (including the NOT_INITIALIZED
+ * handshake used by ProgrammerHandle::restoreDefaults), the variables, the
+ * PAVR2_REQUEST_DIGITAL_READ request, and the firmware modification string.
+ * Any other request fails the same way a stalled request would.
+ *
+ * Example:
+ *
+ *   auto simulator = std::make_shared<ProgrammerSimulator>();
+ *   ProgrammerHandle handle(simulator->getInstance(), simulator);
+ */
+class ProgrammerSimulator : public ProgrammerTransport
+{
+public:
+    explicit ProgrammerSimulator(std::string serialNumber = "00000000");
+
+    /** Returns an instance that describes the simulated programmer.  It does
+     * not refer to a real USB device, so the port name functions will return
+     * errors. */
+    ProgrammerInstance getInstance() const;
+
+    void controlTransfer(uint8_t requestType, uint8_t request,
+        uint16_t value, uint16_t index,
+        void * buffer, uint16_t length, size_t * transferred) override;
+
+    /** Sets how long each control transfer takes.  Transfers made from
+     * different threads at the same time overlap each other.  If the latency
+     * is longer than the timeout, transfers fail with LIBUSBP_ERROR_TIMEOUT. */
+    void setLatency(std::chrono::microseconds);
+
+    void setTimeout(uint32_t timeoutMs) override;
+
+    /** Makes the next count transfers fail with LIBUSBP_ERROR_TIMEOUT after
+     * the normal latency, like a device on a busy hub might. */
+    void failNextTransfers(uint32_t count);
+
+    /** Makes every later transfer fail with LIBUSBP_ERROR_DEVICE_DISCONNECTED,
+     * like a programmer that was unplugged or re-enumerated.  A simulator
+     * cannot be reconnected, so use a new one to simulate the programmer
+     * coming back. */
+    void disconnect();
+
+    /** Sets how long the simulated firmware takes to finish restoring its
+     * default settings after being asked to. */
+    void setRestoreDefaultsTime(std::chrono::microseconds);
+
+    uint8_t getRawSetting(uint8_t id) const;
+    void setRawSetting(uint8_t id, uint8_t value);
+
+    uint8_t getRawVariable(uint8_t id) const;
+    void setRawVariable(uint8_t id, uint8_t value);
+
+    void setDigitalReadings(const ProgrammerDigitalReadings &);
+
+    /** Returns the number of control transfers that have been attempted. */
+    uint32_t getTransferCount() const;
+
+private:
+    void restoreDefaultSettings();
+    void handleGetSetting(uint16_t index, uint8_t * buffer, uint16_t length,
+        size_t * transferred);
+    void handleSetSetting(uint16_t value, uint16_t index);
+
+    mutable std::mutex mutex;
+
+    std::string serialNumber;
+    std::chrono::microseconds latency;
+    std::chrono::microseconds timeout;
+    uint32_t pendingFailures = 0;
+    bool disconnected = false;
+    std::chrono::microseconds restoreDefaultsTime;
+    std::chrono::steady_clock::time_point restoreDefaultsDoneTime;
+
+    uint8_t settings[PAVR2_SETTING_VCC_5V_MAX + 1];
+    uint8_t variables[PAVR2_VARIABLE_IN_PROGRAMMING_MODE + 1];
+    ProgrammerDigitalReadings digitalReadings;
+    uint32_t transferCount = 0;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/** Records a distribution of latencies (in microseconds) using buckets in the
+ * style of an HDR histogram: values below 32 get their own buckets, and each
+ * power of two above that is split into 32 equal buckets.  This means any
+ * recorded value can be reported with an error of about 3% while only using a
+ * fixed, small amount of memory. */
+class ProgrammerLatencyHistogram
+{
+public:
+    ProgrammerLatencyHistogram();
+
+    void record(uint32_t us);
+
+    uint64_t getCount() const { return count; }
+    uint32_t getMin() const { return count ? min : 0; }
+    uint32_t getMax() const { return max; }
+    uint32_t getMean() const { return count ? sum / count : 0; }
+
+    /** Returns an upper bound for the specified percentile (0 to 100) of the
+     * recorded values, or 0 if nothing was recorded. */
+    uint32_t getPercentile(double percentile) const;
+
+    ProgrammerLatencyHistogram & operator+=(const ProgrammerLatencyHistogram &);
+
+private:
+    std::vector<uint32_t> buckets;
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint32_t min = 0;
+    uint32_t max = 0;
+};
+
+/** Statistics about one type of request sent to the programmer. */
+struct ProgrammerRequestStats
+{
+    // The latency of every attempted transfer, including failed ones.
+    ProgrammerLatencyHistogram latency;
+
+    // The number of transfers that failed with an error.
+    uint32_t failures = 0;
+
+    // The number of transfers that returned less data than expected.
+    uint32_t shortTransfers = 0;
+
+    ProgrammerRequestStats & operator+=(const ProgrammerRequestStats &);
+};
+
+/** Counters kept by the retry policy of a ProgrammerHandle.  See
+ * ProgrammerRetryPolicy. */
+struct ProgrammerRetryStats
+{
+    // The number of times a failed transfer was attempted again.
+    uint32_t retries = 0;
+
+    // The number of transfers that succeeded after being retried.
+    uint32_t recovered = 0;
+
+    // The number of transfers that still failed after all allowed retries.
+    uint32_t exhausted = 0;
+
+    // The smoothed round-trip time of successful transfers.
+    uint32_t smoothedRttUs = 0;
+
+    // The timeout currently used for transfers.
+    uint32_t timeoutMs = 0;
+
+    ProgrammerRetryStats & operator+=(const ProgrammerRetryStats &);
+};
+
+/** Statistics about all the control transfers made by a ProgrammerHandle.  See
+ * ProgrammerHandle::getStats(). */
+struct ProgrammerStats
+{
+    ProgrammerRequestStats getSetting;
+    ProgrammerRequestStats setSetting;
+    ProgrammerRequestStats getVariable;
+    ProgrammerRequestStats digitalRead;
+    ProgrammerRequestStats getDescriptor;
+
+    ProgrammerRetryStats retry;
+
+    ProgrammerStats & operator+=(const ProgrammerStats &);
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "programmer.h"
+
+#include <fstream>
+#include <mutex>
+#include <chrono>
+
+/** The programmer trace format records every control transfer made with a
+ * ProgrammerHandle so that the same session can be replayed later without any
+ * hardware.  All numbers are little-endian.
+ *
+ * Header:
+ *   8 bytes: "PAVR2TRC"
+ *   uint16: format version (2)
+ *   uint16: USB product ID
+ *   uint16: firmware version (BCD, from the USB device descriptor)
+ *   uint8: length of the serial number, followed by the serial number
+ *
+ * Each record:
+ *   uint64: time when the transfer started, in microseconds since the
+ *     start of the trace
+ *   uint32: time the transfer took, in microseconds
+ *   uint8: bmRequestType
+ *   uint8: bRequest
+ *   uint16: wValue
+ *   uint16: wIndex
+ *   uint16: wLength
+ *   uint8: 0 if the transfer succeeded, 1 if it failed
+ *   If it succeeded:
+ *     uint16: number of bytes transferred, followed by those bytes if this
+ *       was a device-to-host transfer
+ *   If it failed:
+ *     uint32: libusbp error code, or 0 if unknown (not in version 1)
+ *     uint16: length of the error message, followed by the message
+ */
+
+/** Passes control transfers through to another transport and records them
+ * in a trace file. */
+class ProgrammerTraceRecorder : public ProgrammerTransport
+{
+public:
+    ProgrammerTraceRecorder(const std::string & fileName,
+        const ProgrammerInstance &, std::shared_ptr<ProgrammerTransport>);
+
+    void controlTransfer(uint8_t requestType, uint8_t request,
+        uint16_t value, uint16_t index,
+        void * buffer, uint16_t length, size_t * transferred) override;
+
+    void setTimeout(uint32_t timeoutMs) override;
+
+private:
+    std::shared_ptr<ProgrammerTransport> transport;
+    std::chrono::steady_clock::time_point startTime;
+    std::mutex mutex;
+    std::ofstream file;
+};
+
+/** Answers control transfers using the responses stored in a trace file.
+ *
+ * Requests are matched to records by their bmRequestType, bRequest, wValue
+ * and wIndex, using the earliest record that has not been used yet.  This
+ * allows replaying traces of sessions where several requests were in flight
+ * at once, which might complete in a different order each time. */
+class ProgrammerTraceReplayer : public ProgrammerTransport
+{
+public:
+    /** If recordedTiming is true, each response is delayed until the time it
+     * arrived when the trace was recorded, measured from the first transfer,
+     * so both the gaps between transfers and their durations are reproduced.
+     * Otherwise, transfers finish immediately. */
+    explicit ProgrammerTraceReplayer(const std::string & fileName,
+        bool recordedTiming = false);
+
+    /** Returns an instance that describes the programmer that was used to
+     * make the trace.  It does not refer to a real USB device. */
+    ProgrammerInstance getInstance() const;
+
+    void controlTransfer(uint8_t requestType, uint8_t request,
+        uint16_t value, uint16_t index,
+        void * buffer, uint16_t length, size_t * transferred) override;
+
+private:
+    struct Record
+    {
+        uint64_t timestampUs;
+        uint32_t durationUs;
+        uint8_t requestType;
+        uint8_t request;
+        uint16_t value;
+        uint16_t index;
+        bool failed;
+        uint32_t errorCode;
+        std::string data;  // response bytes or error message
+        bool used;
+    };
+
+    bool recordedTiming;
+    uint16_t productId;
+    uint16_t firmwareVersion;
+    std::string serialNumber;
+
+    std::mutex mutex;
+    std::vector<Record> records;
+    size_t firstUnused = 0;
+
+    // The time of the first transfer, which corresponds to the earliest
+    // timestamp in the trace.
+    uint64_t firstTimestampUs = 0;
+    bool started = false;
+    std::chrono::steady_clock::time_point startTime;
+};
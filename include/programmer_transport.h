@@ -0,0 +1,92 @@
+#pragma once
+
+#include <libusbp.hpp>
+#include <stdexcept>
+#include <string>
+#include <mutex>
+#include <cstdint>
+
+/** An error code used by transports that cannot answer a request at all,
+ * like ProgrammerTraceReplayer when the trace has no more responses for it.
+ * Retrying the transfer or reconnecting to the programmer would not help.  It
+ * is chosen to not overlap the libusbp error codes. */
+#define PROGRAMMER_TRANSPORT_ERROR_NO_RESPONSE 0x10000
+
+/** This exception is thrown by a ProgrammerTransport when a control transfer
+ * fails.  The code is one of the libusbp error codes (e.g.
+ * LIBUSBP_ERROR_TIMEOUT), PROGRAMMER_TRANSPORT_ERROR_NO_RESPONSE, or 0 if the
+ * cause of the error is not known.
+ *
+ * ProgrammerHandle also throws this, with a more descriptive message and the
+ * same code, when one of its operations fails because a transfer failed. */
+class ProgrammerTransportError : public std::runtime_error
+{
+public:
+    explicit ProgrammerTransportError(const std::string & message,
+        uint32_t code = 0)
+        : std::runtime_error(message), code(code)
+    {
+    }
+
+    uint32_t getCode() const noexcept
+    {
+        return code;
+    }
+
+    bool hasCode(uint32_t code) const noexcept
+    {
+        return code != 0 && this->code == code;
+    }
+
+private:
+    uint32_t code;
+};
+
+/** ProgrammerHandle uses this interface for all of its communication with the
+ * programmer.  The normal implementation is ProgrammerUsbTransport, which talks
+ * to a real device, but other implementations (like ProgrammerSimulator) allow
+ * the rest of the code to run without any hardware.
+ *
+ * Implementations must allow controlTransfer to be called from several threads
+ * at once, because copies of a ProgrammerHandle share their transport and can
+ * be used from different threads. */
+class ProgrammerTransport
+{
+public:
+    virtual ~ProgrammerTransport() {}
+
+    /** Performs a control transfer on endpoint 0.  The arguments have the same
+     * meaning as in libusbp::generic_handle::control_transfer.  The transferred
+     * pointer can be NULL.  Throws ProgrammerTransportError if the transfer
+     * fails. */
+    virtual void controlTransfer(uint8_t requestType, uint8_t request,
+        uint16_t value, uint16_t index,
+        void * buffer, uint16_t length, size_t * transferred) = 0;
+
+    /** Sets how long a control transfer may take before it fails with
+     * LIBUSBP_ERROR_TIMEOUT.  This applies to transfers started afterwards.
+     * Transports without timeouts can ignore this. */
+    virtual void setTimeout(uint32_t timeoutMs)
+    {
+        (void)timeoutMs;
+    }
+};
+
+/** Sends control transfers to a real programmer over USB. */
+class ProgrammerUsbTransport : public ProgrammerTransport
+{
+public:
+    explicit ProgrammerUsbTransport(const libusbp::generic_interface &);
+
+    void controlTransfer(uint8_t requestType, uint8_t request,
+        uint16_t value, uint16_t index,
+        void * buffer, uint16_t length, size_t * transferred) override;
+
+    void setTimeout(uint32_t timeoutMs) override;
+
+private:
+    // libusbp reads the timeout of the handle when a transfer starts, so
+    // this is held during transfers and while changing the timeout.
+    std::mutex mutex;
+    libusbp::generic_handle handle;
+};
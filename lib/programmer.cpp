@@ -1,7 +1,18 @@
 #include <cassert>
+#include <algorithm>
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <map>
+#include <iterator>
 #include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+#ifdef __linux__
+#include <dirent.h>
+#endif
 
 #include <programmer.h>
 #include <pavrpgm_config.h>
@@ -19,41 +30,15 @@ static const uint32_t maxRepresentableVoltage = 255 * PAVR2_VOLTAGE_UNITS;
 #define MAX_REPRESENTABLE_VOLTAGE_STR "8160 mV"
 #endif
 
-// Searches for a frequency with the given name inside a vector of frequencies
-// and returns its index.  Returns -1 if it is not found.
-static int32_t frequencyFindByName(
-    const std::vector<ProgrammerFrequency> & table,
-    int32_t start, int32_t end,
-    std::string name)
-{
-    for(int32_t i = start; i <= end; i++)
-    {
-        if (table[i].name == name)
-        {
-            return i;
-        }
-    }
-    return -1;
-}
-
-// Look up a frequency in the list of options that are a user can select when
-// they are setting the "Max ISP Frequency" setting.
-static int32_t allowedMaxFrequencyFind(std::string name)
-{
-    return frequencyFindByName(programmerAllowedMaxFrequencyTable,
-        0, programmerAllowedMaxFrequencyTable.size() - 1, name);
-}
+// applySettings() only trusts its copy of the device's settings if they were
+// read this recently, because another program might have changed them since.
+static const uint32_t settingsShadowMaxAgeMs = 1000;
 
-static int32_t stk500FrequencyFind(std::string name)
-{
-    return frequencyFindByName(programmerStk500FrequencyTable, 0, 255, name);
-}
-
-std::string Programmer::getMaxFrequencyName(uint32_t ispFastestPeriod)
+const ProgrammerFrequency & Programmer::getMaxFrequency(uint32_t ispFastestPeriod)
 {
     if (ispFastestPeriod <= 255)
     {
-        return programmerFullMaxFrequencyTable[ispFastestPeriod].name;
+        return programmerFullMaxFrequencyTable[ispFastestPeriod];
     }
     else
     {
@@ -61,10 +46,15 @@ std::string Programmer::getMaxFrequencyName(uint32_t ispFastestPeriod)
     }
 }
 
+std::string Programmer::getMaxFrequencyName(uint32_t ispFastestPeriod)
+{
+    return getMaxFrequency(ispFastestPeriod).name;
+}
+
 void Programmer::setMaxFrequency(ProgrammerSettings & settings,
-    std::string maxFrequencyName)
+    const std::string & maxFrequencyName)
 {
-    int32_t index = allowedMaxFrequencyFind(maxFrequencyName);
+    int32_t index = programmerAllowedMaxFrequencyFindByName(maxFrequencyName.c_str());
 
     if (index < 0)
     {
@@ -76,18 +66,30 @@ void Programmer::setMaxFrequency(ProgrammerSettings & settings,
     settings.ispFastestPeriod = programmerAllowedMaxFrequencyTable[index].period;
 }
 
-std::string Programmer::getFrequencyName(uint32_t sckDuration,
+void Programmer::setMaxFrequencyPeriod(ProgrammerSettings & settings,
+    uint32_t period)
+{
+    if (programmerAllowedMaxFrequencyFindByPeriod(period) < 0)
+    {
+        throw std::runtime_error("Invalid maximum frequency period: " +
+            std::to_string(period) + ".");
+    }
+
+    settings.ispFastestPeriod = period;
+}
+
+const ProgrammerFrequency & Programmer::getFrequency(uint32_t sckDuration,
     uint32_t ispFastestPeriod)
 {
     if (sckDuration == 0)
     {
         // When SCK_DURATION is 0, that means that the frequency is controlled
         // by the ISP_FASTEST_PERIOD setting.
-        return getMaxFrequencyName(ispFastestPeriod);
+        return getMaxFrequency(ispFastestPeriod);
     }
     else if (sckDuration <= 255)
     {
-        return programmerStk500FrequencyTable[sckDuration].name;
+        return programmerStk500FrequencyTable[sckDuration];
     }
     else
     {
@@ -95,10 +97,20 @@ std::string Programmer::getFrequencyName(uint32_t sckDuration,
     }
 }
 
-void Programmer::setFrequency(ProgrammerSettings & settings, std::string frequencyName)
+std::string Programmer::getFrequencyName(uint32_t sckDuration,
+    uint32_t ispFastestPeriod)
+{
+    return getFrequency(sckDuration, ispFastestPeriod).name;
+}
+
+// Finds the settings for a frequency, given the index of the first element
+// with that frequency in the STK500 table and in the allowed max frequency
+// table, or -1 if there is none.  Returns false if the frequency is not
+// achievable.
+static bool frequencySettingForIndices(int32_t stk500Index,
+    int32_t allowedMaxIndex, ProgrammerFrequencySetting & setting)
 {
-    int32_t index = stk500FrequencyFind(frequencyName);
-    if (index > 0)
+    if (stk500Index > 0)
     {
         // The comparison above is "> 0" on purpose.  If index == 0, it means that
         // we that we found the first element, which is really just a dummy element.
@@ -107,29 +119,163 @@ void Programmer::setFrequency(ProgrammerSettings & settings, std::string frequen
 
         // This is a frequency we can achieve by just setting the SCK_DURATION
         // parameter, so do that.
-        settings.sckDuration = index;
+        setting.sckDuration = stk500Index;
+        setting.ispFastestPeriod = 0;
+        return true;
     }
-    else
+    else if (allowedMaxIndex >= 0)
+    {
+        // This is a frequency we can achieve by setting SCK_DURATION to 0,
+        // which means to use ISP_FASTEST_PERIOD, and then setting the
+        // ISP_FASTEST_PERIOD.
+        setting.sckDuration = 0;
+        setting.ispFastestPeriod =
+            programmerAllowedMaxFrequencyTable[allowedMaxIndex].period;
+        return true;
+    }
+    return false;
+}
+
+static void applyFrequencySetting(ProgrammerSettings & settings,
+    const ProgrammerFrequencySetting & setting)
+{
+    settings.sckDuration = setting.sckDuration;
+    if (setting.sckDuration == 0)
+    {
+        settings.ispFastestPeriod = setting.ispFastestPeriod;
+    }
+}
+
+void Programmer::setFrequency(ProgrammerSettings & settings,
+    const std::string & frequencyName)
+{
+    const char * name = frequencyName.c_str();
+    ProgrammerFrequencySetting setting;
+    if (!frequencySettingForIndices(
+        programmerStk500FrequencyFindByName(name),
+        programmerAllowedMaxFrequencyFindByName(name), setting))
     {
-        index = allowedMaxFrequencyFind(frequencyName);
+        throw std::runtime_error(
+            std::string("Invalid frequency name: '") + frequencyName + "'.");
+    }
+    applyFrequencySetting(settings, setting);
+}
 
-        if (index >= 0)
+void Programmer::setFrequencyPeriod(ProgrammerSettings & settings,
+    uint32_t period)
+{
+    ProgrammerFrequencySetting setting;
+    if (!frequencySettingForIndices(
+        programmerStk500FrequencyFindByPeriod(period),
+        programmerAllowedMaxFrequencyFindByPeriod(period), setting))
+    {
+        throw std::runtime_error("Invalid frequency period: " +
+            std::to_string(period) + ".");
+    }
+    applyFrequencySetting(settings, setting);
+}
+
+ProgrammerFrequencySetting Programmer::findFrequencyAtMost(double frequencyHz)
+{
+    int32_t index = programmerFrequencyFindAtMost(
+        programmerAllowedFrequencyTable, frequencyHz);
+    if (index < 0)
+    {
+        throw std::runtime_error(std::string(
+            "The frequency is too low.  The lowest allowed frequency is ") +
+            programmerAllowedFrequencyTable.back().name + " kHz.");
+    }
+
+    uint32_t period = programmerAllowedFrequencyTable[index].period;
+    ProgrammerFrequencySetting setting;
+    bool found = frequencySettingForIndices(
+        programmerStk500FrequencyFindByPeriod(period),
+        programmerAllowedMaxFrequencyFindByPeriod(period), setting);
+    assert(found);
+    (void)found;
+    return setting;
+}
+
+uint32_t Programmer::findMaxFrequencyAtMost(double frequencyHz)
+{
+    int32_t index = programmerFrequencyFindAtMost(
+        programmerAllowedMaxFrequencyTable, frequencyHz);
+    if (index < 0)
+    {
+        throw std::runtime_error(std::string(
+            "The maximum frequency is too low.  The lowest allowed maximum "
+            "frequency is ") + programmerAllowedMaxFrequencyTable.back().name +
+            " kHz.");
+    }
+    return programmerAllowedMaxFrequencyTable[index].period;
+}
+
+void Programmer::setFrequencyAtMost(ProgrammerSettings & settings,
+    double frequencyHz)
+{
+    applyFrequencySetting(settings, findFrequencyAtMost(frequencyHz));
+}
+
+void Programmer::setMaxFrequencyAtMost(ProgrammerSettings & settings,
+    double frequencyHz)
+{
+    settings.ispFastestPeriod = findMaxFrequencyAtMost(frequencyHz);
+}
+
+bool Programmer::splitFrequency(const std::string & frequency,
+    std::string & number, double & unitHz)
+{
+    size_t suffixStart = frequency.find_first_not_of("0123456789.");
+    number = frequency.substr(0, suffixStart);
+
+    std::string suffix;
+    if (suffixStart != std::string::npos)
+    {
+        for (char c : frequency.substr(suffixStart))
         {
-            // This is a frequency we can achieve by setting SCK_DURATION to 0,
-            // which means to use ISP_FASTEST_PERIOD, and then setting the
-            // ISP_FASTEST_PERIOD.
-            settings.sckDuration = 0;
-            settings.ispFastestPeriod = programmerAllowedMaxFrequencyTable[index].period;
+            if (c != ' ') { suffix += std::tolower(c); }
         }
-        else
+    }
+
+    if (suffix == "" || suffix == "k" || suffix == "khz") { unitHz = 1000; }
+    else if (suffix == "m" || suffix == "mhz") { unitHz = 1000000; }
+    else if (suffix == "hz") { unitHz = 1; }
+    else { return false; }
+
+    if (number.empty() || number.find('.') != number.rfind('.')) { return false; }
+    if (number == ".") { return false; }
+    return true;
+}
+
+void Programmer::setFrequencyFromString(ProgrammerSettings & settings,
+    const std::string & frequency, bool max)
+{
+    std::string number;
+    double unitHz = 0;
+    if (!splitFrequency(frequency, number, unitHz))
+    {
+        throw std::runtime_error("Invalid frequency: '" + frequency + "'.");
+    }
+
+    if (unitHz == 1000)
+    {
+        const char * name = number.c_str();
+        bool isName = programmerAllowedMaxFrequencyFindByName(name) >= 0 ||
+            (!max && programmerStk500FrequencyFindByName(name) > 0);
+        if (isName)
         {
-            throw std::runtime_error(
-                std::string("Invalid frequency name: '") + frequencyName + "'.");
+            if (max) { setMaxFrequency(settings, number); }
+            else { setFrequency(settings, number); }
+            return;
         }
     }
+
+    double frequencyHz = std::stod(number) * unitHz;
+    if (max) { setMaxFrequencyAtMost(settings, frequencyHz); }
+    else { setFrequencyAtMost(settings, frequencyHz); }
 }
 
-std::string Programmer::convertProgrammingErrorToShortString(uint8_t programmingError)
+const char * Programmer::convertProgrammingErrorToShortCString(uint8_t programmingError)
 {
     switch (programmingError)
     {
@@ -155,11 +301,18 @@ std::string Programmer::convertProgrammingErrorToShortString(uint8_t programming
         return "Programmer power error.";
 
     default:
-        return std::string("Unknown code ") + std::to_string(programmingError) + ".";
+        return NULL;
     }
 }
 
-std::string Programmer::convertProgrammingErrorToLongString(uint8_t programmingError)
+std::string Programmer::convertProgrammingErrorToShortString(uint8_t programmingError)
+{
+    const char * str = convertProgrammingErrorToShortCString(programmingError);
+    if (str) { return str; }
+    return std::string("Unknown code ") + std::to_string(programmingError) + ".";
+}
+
+const char * Programmer::convertProgrammingErrorToLongCString(uint8_t programmingError)
 {
     switch (programmingError)
     {
@@ -200,7 +353,12 @@ std::string Programmer::convertProgrammingErrorToLongString(uint8_t programmingE
     }
 }
 
-std::string Programmer::convertDeviceResetToString(uint8_t deviceReset)
+std::string Programmer::convertProgrammingErrorToLongString(uint8_t programmingError)
+{
+    return convertProgrammingErrorToLongCString(programmingError);
+}
+
+const char * Programmer::convertDeviceResetToCString(uint8_t deviceReset)
 {
     switch(deviceReset)
     {
@@ -226,11 +384,18 @@ std::string Programmer::convertDeviceResetToString(uint8_t deviceReset)
         return "Stack underflow";
 
     default:
-        return std::string("Unknown code ") + std::to_string(deviceReset) + ".";
+        return NULL;
     }
 }
 
-std::string Programmer::convertRegulatorModeToString(uint8_t regulatorMode)
+std::string Programmer::convertDeviceResetToString(uint8_t deviceReset)
+{
+    const char * str = convertDeviceResetToCString(deviceReset);
+    if (str) { return str; }
+    return std::string("Unknown code ") + std::to_string(deviceReset) + ".";
+}
+
+const char * Programmer::convertRegulatorModeToCString(uint8_t regulatorMode)
 {
     switch (regulatorMode)
     {
@@ -240,13 +405,23 @@ std::string Programmer::convertRegulatorModeToString(uint8_t regulatorMode)
     }
 }
 
-std::string Programmer::convertRegulatorLevelToString(uint8_t regulatorLevel)
+std::string Programmer::convertRegulatorModeToString(uint8_t regulatorMode)
+{
+    return convertRegulatorModeToCString(regulatorMode);
+}
+
+const char * Programmer::convertRegulatorLevelToCString(uint8_t regulatorLevel)
 {
     // The levels are a subset of the modes.
-    return convertRegulatorModeToString(regulatorLevel);
+    return convertRegulatorModeToCString(regulatorLevel);
 }
 
-std::string Programmer::convertLineFunctionToString(uint8_t lineFunction)
+std::string Programmer::convertRegulatorLevelToString(uint8_t regulatorLevel)
+{
+    return convertRegulatorLevelToCString(regulatorLevel);
+}
+
+const char * Programmer::convertLineFunctionToCString(uint8_t lineFunction)
 {
     switch (lineFunction)
     {
@@ -260,6 +435,11 @@ std::string Programmer::convertLineFunctionToString(uint8_t lineFunction)
     }
 }
 
+std::string Programmer::convertLineFunctionToString(uint8_t lineFunction)
+{
+    return convertLineFunctionToCString(lineFunction);
+}
+
 ProgrammerInstance::ProgrammerInstance()
 {
 }
@@ -307,6 +487,11 @@ std::string ProgrammerInstance::getSerialNumber() const
     return serialNumber;
 }
 
+uint16_t ProgrammerInstance::getProductId() const
+{
+    return productId;
+}
+
 uint16_t ProgrammerInstance::getFirmwareVersion() const
 {
     return firmwareVersion;
@@ -335,16 +520,77 @@ uint8_t ProgrammerInstance::getFirmwareVersionMinor() const
     return bcdToDecimal(firmwareVersion & 0xFF);
 }
 
+// The names of a programmer's serial ports.  Finding them requires looking
+// through the operating system's list of devices, so we remember them for
+// each device, keyed by OS ID.
+struct PortNames
+{
+    std::string serialNumber;
+    std::string programmingPortName;
+    std::string ttlPortName;
+};
+
+static std::mutex portNameCacheMutex;
+static std::map<std::string, PortNames> portNameCache;
+
+static PortNames getPortNames(const ProgrammerInstance & instance)
+{
+    std::string osId = instance.getOsId();
+
+    {
+        std::lock_guard<std::mutex> lock(portNameCacheMutex);
+        auto it = portNameCache.find(osId);
+        if (it != portNameCache.end() &&
+            it->second.serialNumber == instance.getSerialNumber())
+        {
+            return it->second;
+        }
+    }
+
+    // Look up both ports at once because callers usually want both.  If
+    // either one fails, this throws and nothing is cached, because the ports
+    // might just not be ready yet.
+    PortNames names;
+    names.serialNumber = instance.getSerialNumber();
+    names.programmingPortName =
+        libusbp::serial_port(instance.usbDevice, 1, true).get_name();
+    names.ttlPortName =
+        libusbp::serial_port(instance.usbDevice, 3, true).get_name();
+
+    std::lock_guard<std::mutex> lock(portNameCacheMutex);
+    portNameCache[osId] = names;
+    return names;
+}
+
+// Forgets the port names of any device not in the list.
+static void prunePortNames(const std::vector<ProgrammerInstance> & list)
+{
+    std::lock_guard<std::mutex> lock(portNameCacheMutex);
+    for (auto it = portNameCache.begin(); it != portNameCache.end(); )
+    {
+        bool present = false;
+        for (const ProgrammerInstance & instance : list)
+        {
+            if (instance.getOsId() == it->first) { present = true; break; }
+        }
+        it = present ? std::next(it) : portNameCache.erase(it);
+    }
+}
+
+void programmerForgetPortNames(const std::string & osId)
+{
+    std::lock_guard<std::mutex> lock(portNameCacheMutex);
+    portNameCache.erase(osId);
+}
+
 std::string ProgrammerInstance::getProgrammingPortName() const
 {
-    libusbp::serial_port port(usbDevice, 1, true);
-    return port.get_name();
+    return getPortNames(*this).programmingPortName;
 }
 
 std::string ProgrammerInstance::getTtlPortName() const
 {
-    libusbp::serial_port port(usbDevice, 3, true);
-    return port.get_name();
+    return getPortNames(*this).ttlPortName;
 }
 
 std::string ProgrammerInstance::tryGetProgrammingPortName() const
@@ -371,71 +617,214 @@ std::string ProgrammerInstance::tryGetTtlPortName() const
     }
 }
 
+// If the device is a programmer, makes an instance for it and returns true.
+static bool createInstance(const libusbp::device & device,
+    ProgrammerInstance & instance)
+{
+    if (device.get_vendor_id() != PAVR2_USB_VENDOR_ID) { return false; }
+
+    uint16_t productId = device.get_product_id();
+
+    bool isProgrammer =
+        productId == PAVR2_USB_PRODUCT_ID_V2 ||
+        productId == PAVR2_USB_PRODUCT_ID_V2_1;
+
+    if (!isProgrammer) { return false; }
+
+    libusbp::generic_interface usbInterface;
+    try
+    {
+        uint8_t interfaceNumber = 0;
+        bool composite = true;
+        usbInterface = libusbp::generic_interface(device, interfaceNumber, composite);
+    }
+    catch(const libusbp::error & error)
+    {
+        if (error.has_code(LIBUSBP_ERROR_NOT_READY))
+        {
+            // An error occurred that is normal if the interface is simply
+            // not ready to use yet.  Silently ignore it.
+            return false;
+        }
+        throw;
+    }
+    instance = ProgrammerInstance(device, usbInterface, productId,
+        device.get_serial_number(), device.get_revision());
+    return true;
+}
+
 std::vector<ProgrammerInstance> programmerGetList()
 {
     std::vector<ProgrammerInstance> list;
     for (const libusbp::device & device : libusbp::list_connected_devices())
     {
-        if (device.get_vendor_id() != PAVR2_USB_VENDOR_ID) { continue; }
+        ProgrammerInstance instance;
+        if (createInstance(device, instance))
+        {
+            list.push_back(instance);
+        }
+    }
+    prunePortNames(list);
+    return list;
+}
 
-        uint16_t productId = device.get_product_id();
+#ifdef __linux__
 
-        bool isProgrammer =
-            productId == PAVR2_USB_PRODUCT_ID_V2 ||
-            productId == PAVR2_USB_PRODUCT_ID_V2_1;
+// Reads the first line of a small file in sysfs.  Returns false if the file
+// could not be read.
+static bool readSysfsAttribute(const std::string & path, std::string & value)
+{
+    FILE * file = fopen(path.c_str(), "r");
+    if (file == NULL) { return false; }
+    char buffer[256];
+    bool success = fgets(buffer, sizeof(buffer), file) != NULL;
+    fclose(file);
+    if (!success) { return false; }
+    value = buffer;
+    while (value.size() && (value.back() == '\n' || value.back() == '\r'))
+    {
+        value.pop_back();
+    }
+    return true;
+}
 
-        if (!isProgrammer) { continue; }
+// Looks for a programmer with the specified serial number by reading a few
+// attributes of each USB device in sysfs, which is much faster than creating a
+// libusbp::device for each one.  Returns 1 and sets the sysfs path if it is
+// found, 0 if it is not, or -1 if sysfs could not be read.
+static int sysfsFindBySerial(const std::string & serialNumber,
+    std::string & sysPath)
+{
+    const std::string base = "/sys/bus/usb/devices/";
+    DIR * dir = opendir(base.c_str());
+    if (dir == NULL) { return -1; }
 
-        libusbp::generic_interface usbInterface;
-        try
+    int result = 0;
+    while (struct dirent * entry = readdir(dir))
+    {
+        // Skip ".", "..", and interfaces like "1-2:1.0".
+        std::string name = entry->d_name;
+        if (name[0] == '.' || name.find(':') != std::string::npos) { continue; }
+
+        std::string path = base + name + "/";
+        std::string vendor, product, serial;
+        if (!readSysfsAttribute(path + "idVendor", vendor)) { continue; }
+        if (strtoul(vendor.c_str(), NULL, 16) != PAVR2_USB_VENDOR_ID) { continue; }
+        if (!readSysfsAttribute(path + "idProduct", product)) { continue; }
+        uint32_t productId = strtoul(product.c_str(), NULL, 16);
+        if (productId != PAVR2_USB_PRODUCT_ID_V2 &&
+            productId != PAVR2_USB_PRODUCT_ID_V2_1)
         {
-            uint8_t interfaceNumber = 0;
-            bool composite = true;
-            usbInterface = libusbp::generic_interface(device, interfaceNumber, composite);
+            continue;
         }
-        catch(const libusbp::error & error)
+        if (!readSysfsAttribute(path + "serial", serial)) { continue; }
+        if (serial != serialNumber) { continue; }
+
+        // libusbp uses the canonical path as the OS ID.
+        char * realPath = realpath(path.c_str(), NULL);
+        if (realPath == NULL) { result = -1; break; }
+        sysPath = realPath;
+        free(realPath);
+        while (sysPath.size() > 1 && sysPath.back() == '/') { sysPath.pop_back(); }
+        result = 1;
+        break;
+    }
+    closedir(dir);
+    return result;
+}
+
+#endif
+
+ProgrammerInstance programmerFindBySerial(const std::string & serialNumber)
+{
+    std::string sysPath;
+#ifdef __linux__
+    int found = sysfsFindBySerial(serialNumber, sysPath);
+    if (found == 0)
+    {
+        // sysfs lists the same devices that libusbp would, so there is no
+        // need to ask libusbp.
+        return ProgrammerInstance();
+    }
+    if (found != 1) { sysPath.clear(); }
+#endif
+
+    // libusbp cannot open a device by path, so we still have to get its list.
+    std::vector<libusbp::device> devices = libusbp::list_connected_devices();
+
+    if (sysPath.size())
+    {
+        // Only look closely at the device we want.  If it is not usable yet,
+        // looking at the others would not help.
+        for (const libusbp::device & device : devices)
         {
-            if (error.has_code(LIBUSBP_ERROR_NOT_READY))
+            if (device.get_os_id() != sysPath) { continue; }
+            ProgrammerInstance instance;
+            if (createInstance(device, instance) &&
+                instance.getSerialNumber() == serialNumber)
             {
-                // An error occurred that is normal if the interface is simply
-                // not ready to use yet.  Silently ignore it.
-                continue;
+                return instance;
             }
-            throw;
+            return ProgrammerInstance();
         }
-        ProgrammerInstance instance(device, usbInterface, productId,
-            device.get_serial_number(), device.get_revision());
-        list.push_back(instance);
     }
-    return list;
+
+    // Fall back to checking every programmer in the same list.
+    for (const libusbp::device & device : devices)
+    {
+        ProgrammerInstance instance;
+        if (createInstance(device, instance) &&
+            instance.getSerialNumber() == serialNumber)
+        {
+            return instance;
+        }
+    }
+    return ProgrammerInstance();
 }
 
 ProgrammerHandle::ProgrammerHandle()
 {
 }
 
-ProgrammerHandle::ProgrammerHandle(ProgrammerInstance instance)
+static void checkFirmwareVersionSupported(const ProgrammerInstance & instance)
 {
-    assert(instance);
-
     if (instance.getFirmwareVersionMajor() > PAVR2_FIRMWARE_VERSION_MAJOR_MAX)
     {
         throw std::runtime_error(
             "The device has new firmware that is not supported by this software.  "
             "Try using the latest version of this software from " DOCUMENTATION_URL);
     }
+}
+
+ProgrammerHandle::ProgrammerHandle(ProgrammerInstance instance)
+{
+    assert(instance);
+
+    checkFirmwareVersionSupported(instance);
 
     this->instance = instance;
-    handle = libusbp::generic_handle(instance.usbInterface);
+    transport = std::make_shared<ProgrammerUsbTransport>(instance.usbInterface);
+    transferState = std::make_shared<TransferState>();
+    setRetryPolicy(ProgrammerRetryPolicy());
+}
+
+ProgrammerHandle::ProgrammerHandle(ProgrammerInstance instance,
+    std::shared_ptr<ProgrammerTransport> transport)
+{
+    assert(transport);
 
-    // Set a timeout for all control transfers to prevent the CLI from hanging
-    // indefinitely if something goes wrong with the USB communication.
-    handle.set_timeout(0, 300);
+    checkFirmwareVersionSupported(instance);
+
+    this->instance = instance;
+    this->transport = transport;
+    transferState = std::make_shared<TransferState>();
+    setRetryPolicy(ProgrammerRetryPolicy());
 }
 
 void ProgrammerHandle::close()
 {
-    handle.close();
+    transport.reset();
+    transferState.reset();
     instance = ProgrammerInstance();
 }
 
@@ -444,23 +833,273 @@ const ProgrammerInstance & ProgrammerHandle::getInstance() const
     return instance;
 }
 
+struct ProgrammerHandle::TransferState
+{
+    std::mutex mutex;
+    ProgrammerStats stats;
+    ProgrammerRetryPolicy policy;
+
+    // The smoothed round-trip time and its mean deviation, or 0 if no
+    // transfer has succeeded yet.
+    uint32_t srttUs = 0;
+    uint32_t rttVarUs = 0;
+
+    // The number of host-to-device transfers in progress, and the timeout
+    // that the transport is currently using.
+    uint32_t writesInProgress = 0;
+    uint32_t transportTimeoutMs = 0;
+
+    // A copy of the raw settings we believe the device has, indexed by setting
+    // ID.  Bit N of settingsShadowMask is 1 if settingsShadow[N] is known.
+    uint8_t settingsShadow[PAVR2_SETTING_VCC_5V_MAX + 1];
+    uint32_t settingsShadowMask = 0;
+
+    // When all of the settings were last read from the device, if
+    // settingsShadowRead is true.
+    bool settingsShadowRead = false;
+    std::chrono::steady_clock::time_point settingsShadowReadTime;
+
+    uint32_t computeTimeoutMs() const;
+    void updateTransportTimeout(ProgrammerTransport &);
+    void beginWrite(ProgrammerTransport &);
+    void endWrite(ProgrammerTransport &);
+    void recordSuccess(ProgrammerTransport &,
+        ProgrammerRequestStats ProgrammerStats::*, uint32_t us, uint32_t attempt);
+    bool recordFailure(ProgrammerTransport &,
+        ProgrammerRequestStats ProgrammerStats::*, uint32_t us,
+        const ProgrammerTransportError &, bool retryable, uint32_t attempt,
+        uint32_t & backoffMs);
+};
+
+// Computes a timeout from the round-trip time the same way TCP does: the
+// smoothed RTT plus four times its mean deviation.
+uint32_t ProgrammerHandle::TransferState::computeTimeoutMs() const
+{
+    if (srttUs == 0) { return policy.initialTimeoutMs; }
+
+    uint32_t timeoutMs = (srttUs + 4 * rttVarUs + 999) / 1000;
+    if (timeoutMs < policy.minTimeoutMs) { timeoutMs = policy.minTimeoutMs; }
+    if (timeoutMs > policy.maxTimeoutMs) { timeoutMs = policy.maxTimeoutMs; }
+    return timeoutMs;
+}
+
+// Gives the transport the timeout from the statistics, or the initial timeout
+// if that is longer and a host-to-device transfer is in progress.  Those are
+// never retried, so a timeout adapted to how fast reads complete could make
+// a slower write fail.  The caller must hold the mutex; the transport is
+// updated while holding it so that the calls from different threads cannot
+// happen in the wrong order.
+void ProgrammerHandle::TransferState::updateTransportTimeout(
+    ProgrammerTransport & transport)
+{
+    uint32_t timeoutMs = stats.retry.timeoutMs;
+    if (writesInProgress && timeoutMs < policy.initialTimeoutMs)
+    {
+        timeoutMs = policy.initialTimeoutMs;
+    }
+    if (timeoutMs != transportTimeoutMs)
+    {
+        transportTimeoutMs = timeoutMs;
+        transport.setTimeout(timeoutMs);
+    }
+}
+
+void ProgrammerHandle::TransferState::beginWrite(ProgrammerTransport & transport)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    writesInProgress++;
+    updateTransportTimeout(transport);
+}
+
+void ProgrammerHandle::TransferState::endWrite(ProgrammerTransport & transport)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    writesInProgress--;
+    updateTransportTimeout(transport);
+}
+
+// Records a successful transfer and updates the round-trip time estimate and
+// the transport's timeout.
+void ProgrammerHandle::TransferState::recordSuccess(
+    ProgrammerTransport & transport,
+    ProgrammerRequestStats ProgrammerStats::* requestStats,
+    uint32_t us, uint32_t attempt)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    (stats.*requestStats).latency.record(us);
+    if (attempt > 0) { stats.retry.recovered++; }
+
+    if (srttUs == 0)
+    {
+        srttUs = us ? us : 1;
+        rttVarUs = us / 2;
+    }
+    else
+    {
+        int32_t error = (int32_t)us - (int32_t)srttUs;
+        srttUs += error / 8;
+        if (srttUs == 0) { srttUs = 1; }
+        rttVarUs += ((int32_t)(error < 0 ? -error : error) - (int32_t)rttVarUs) / 4;
+    }
+    stats.retry.smoothedRttUs = srttUs;
+
+    // Lengthen the timeout right away, but only shorten it when it changes a
+    // lot, because changing it might take a system call.
+    uint32_t timeoutMs = computeTimeoutMs();
+    uint32_t & currentMs = stats.retry.timeoutMs;
+    if (timeoutMs > currentMs || timeoutMs < currentMs * 3 / 4)
+    {
+        currentMs = timeoutMs;
+        updateTransportTimeout(transport);
+    }
+}
+
+// Records a failed transfer.  Returns true if the transfer should be retried
+// after waiting for backoffMs.  Before returning true, this lengthens the
+// transport's timeout if the transfer timed out.
+bool ProgrammerHandle::TransferState::recordFailure(
+    ProgrammerTransport & transport,
+    ProgrammerRequestStats ProgrammerStats::* requestStats,
+    uint32_t us, const ProgrammerTransportError & error, bool retryable,
+    uint32_t attempt, uint32_t & backoffMs)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    ProgrammerRequestStats & requestStatsRef = stats.*requestStats;
+    requestStatsRef.latency.record(us);
+    requestStatsRef.failures++;
+
+    backoffMs = 0;
+
+    // There is no point in retrying if the device is gone or the transport
+    // cannot answer the request.
+    if (!retryable || error.hasCode(LIBUSBP_ERROR_DEVICE_DISCONNECTED) ||
+        error.hasCode(PROGRAMMER_TRANSPORT_ERROR_NO_RESPONSE))
+    {
+        return false;
+    }
+
+    if (attempt >= policy.maxRetries)
+    {
+        if (attempt > 0) { stats.retry.exhausted++; }
+        return false;
+    }
+
+    // If the device is just slower than we thought, give it more time.
+    if (error.hasCode(LIBUSBP_ERROR_TIMEOUT) &&
+        stats.retry.timeoutMs < policy.maxTimeoutMs)
+    {
+        uint32_t timeoutMs = stats.retry.timeoutMs * 2;
+        if (timeoutMs > policy.maxTimeoutMs) { timeoutMs = policy.maxTimeoutMs; }
+        stats.retry.timeoutMs = timeoutMs;
+        updateTransportTimeout(transport);
+    }
+
+    stats.retry.retries++;
+    backoffMs = policy.backoffMs << attempt;
+    return true;
+}
+
+// Performs a control transfer, applying the retry policy and recording its
+// latency and whether it failed in the specified member of the statistics.
+void ProgrammerHandle::controlTransfer(
+    ProgrammerRequestStats ProgrammerStats::* requestStats,
+    uint8_t requestType, uint8_t request, uint16_t value, uint16_t index,
+    void * buffer, uint16_t length, size_t * transferred)
+{
+    // Device-to-host requests only read data, so it is safe to retry them.
+    // The others get one attempt, with at least the initial timeout.
+    bool retryable = requestType & 0x80;
+    if (!retryable) { transferState->beginWrite(*transport); }
+
+    for (uint32_t attempt = 0; ; attempt++)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        auto elapsedUs = [&]() -> uint32_t
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - startTime).count();
+        };
+
+        bool failed = false;
+        uint32_t backoffMs = 0;
+        try
+        {
+            transport->controlTransfer(requestType, request, value, index,
+                buffer, length, transferred);
+        }
+        catch (const ProgrammerTransportError & error)
+        {
+            bool retry = transferState->recordFailure(*transport, requestStats,
+                elapsedUs(), error, retryable, attempt, backoffMs);
+            if (!retry)
+            {
+                if (!retryable) { transferState->endWrite(*transport); }
+                throw;
+            }
+            failed = true;
+        }
+
+        if (!failed)
+        {
+            transferState->recordSuccess(*transport, requestStats,
+                elapsedUs(), attempt);
+            if (!retryable) { transferState->endWrite(*transport); }
+            return;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(backoffMs));
+    }
+}
+
+void ProgrammerHandle::recordShortTransfer(
+    ProgrammerRequestStats ProgrammerStats::* requestStats)
+{
+    std::lock_guard<std::mutex> lock(transferState->mutex);
+    (transferState->stats.*requestStats).shortTransfers++;
+}
+
+void ProgrammerHandle::setRetryPolicy(const ProgrammerRetryPolicy & policy)
+{
+    std::lock_guard<std::mutex> lock(transferState->mutex);
+    transferState->policy = policy;
+    transferState->stats.retry.timeoutMs = transferState->computeTimeoutMs();
+    transferState->updateTransportTimeout(*transport);
+}
+
+ProgrammerRetryPolicy ProgrammerHandle::getRetryPolicy() const
+{
+    if (!transferState) { return ProgrammerRetryPolicy(); }
+    std::lock_guard<std::mutex> lock(transferState->mutex);
+    return transferState->policy;
+}
+
+ProgrammerStats ProgrammerHandle::getStats() const
+{
+    if (!transferState) { return ProgrammerStats(); }
+    std::lock_guard<std::mutex> lock(transferState->mutex);
+    return transferState->stats;
+}
+
 uint8_t ProgrammerHandle::getRawSetting(uint8_t id)
 {
     uint8_t value;
     size_t transferred;
     try
     {
-        handle.control_transfer(0xC0, PAVR2_REQUEST_GET_SETTING,
-            0, id, &value, 1, &transferred);
+        controlTransfer(&ProgrammerStats::getSetting,
+            0xC0, PAVR2_REQUEST_GET_SETTING, 0, id, &value, 1, &transferred);
     }
-    catch (const libusbp::error & error)
+    catch (const ProgrammerTransportError & error)
     {
-        throw std::runtime_error(std::string("Failed to read a setting.  ")
-            + error.message());
+        throw ProgrammerTransportError(std::string("Failed to read a setting.  ")
+            + error.what(), error.getCode());
     }
 
     if (transferred != 1)
     {
+        recordShortTransfer(&ProgrammerStats::getSetting);
         throw std::runtime_error(std::string("Failed to read a setting.  ") +
             "Expected 1 byte, got " + std::to_string(transferred));
     }
@@ -470,15 +1109,47 @@ uint8_t ProgrammerHandle::getRawSetting(uint8_t id)
 
 void ProgrammerHandle::setRawSetting(uint8_t id, uint8_t value)
 {
+    // If the request fails, we don't know whether the device got the new value
+    // or not.
+    {
+        std::lock_guard<std::mutex> lock(transferState->mutex);
+        transferState->settingsShadowMask &= ~((uint32_t)1 << id);
+    }
+
     try
     {
-        handle.control_transfer(0x40, PAVR2_REQUEST_SET_SETTING, value, id);
+        controlTransfer(&ProgrammerStats::setSetting,
+            0x40, PAVR2_REQUEST_SET_SETTING, value, id, NULL, 0, NULL);
     }
-    catch(const libusbp::error & error)
+    catch(const ProgrammerTransportError & error)
     {
-        throw std::runtime_error(std::string("Failed to set a setting.  ") +
-            error.message());
+        throw ProgrammerTransportError(std::string("Failed to set a setting.  ") +
+            error.what(), error.getCode());
     }
+
+    std::lock_guard<std::mutex> lock(transferState->mutex);
+    transferState->settingsShadow[id] = value;
+    transferState->settingsShadowMask |= (uint32_t)1 << id;
+}
+
+// Sets a setting on the device, unless the shadow copy says that the device
+// already has that value.
+void ProgrammerHandle::updateRawSetting(uint8_t id, uint8_t value)
+{
+    {
+        std::lock_guard<std::mutex> lock(transferState->mutex);
+        bool known = transferState->settingsShadowMask >> id & 1;
+        if (known && transferState->settingsShadow[id] == value) { return; }
+    }
+    setRawSetting(id, value);
+}
+
+void ProgrammerHandle::invalidateSettingsShadow()
+{
+    if (!transferState) { return; }
+    std::lock_guard<std::mutex> lock(transferState->mutex);
+    transferState->settingsShadowMask = 0;
+    transferState->settingsShadowRead = false;
 }
 
 uint8_t ProgrammerHandle::getRawVariable(uint8_t id)
@@ -487,17 +1158,18 @@ uint8_t ProgrammerHandle::getRawVariable(uint8_t id)
     size_t transferred;
     try
     {
-        handle.control_transfer(0xC0, PAVR2_REQUEST_GET_VARIABLE,
-            0, id, &value, 1, &transferred);
+        controlTransfer(&ProgrammerStats::getVariable,
+            0xC0, PAVR2_REQUEST_GET_VARIABLE, 0, id, &value, 1, &transferred);
     }
-    catch (const libusbp::error & error)
+    catch (const ProgrammerTransportError & error)
     {
-        throw std::runtime_error(std::string("Failed to get a variable.  ")
-            + error.message());
+        throw ProgrammerTransportError(std::string("Failed to get a variable.  ")
+            + error.what(), error.getCode());
     }
 
     if (transferred != 1)
     {
+        recordShortTransfer(&ProgrammerStats::getVariable);
         throw std::runtime_error(std::string("Failed to get a variable.  ") +
             "Expected 1 byte, got " + std::to_string(transferred));
     }
@@ -520,11 +1192,12 @@ std::string ProgrammerHandle::getFirmwareVersionString()
     uint8_t buffer[64];
     try
     {
-        handle.control_transfer(0x80, USB_REQUEST_GET_DESCRIPTOR,
+        controlTransfer(&ProgrammerStats::getDescriptor,
+            0x80, USB_REQUEST_GET_DESCRIPTOR,
             (USB_DESCRIPTOR_TYPE_STRING << 8) | stringIndex,
             0, buffer, sizeof(buffer), &transferred);
     }
-    catch (const libusbp::error & error)
+    catch (const ProgrammerTransportError & error)
     {
         // Let's make this be a non-fatal error because it's not so important.
         // Just add a question mark so we can tell if something is wrong.
@@ -548,31 +1221,76 @@ std::string ProgrammerHandle::getFirmwareVersionString()
 }
 
 // [all-settings]
-ProgrammerSettings ProgrammerHandle::getSettings()
+ProgrammerSettingsSnapshot ProgrammerHandle::getSettingsSnapshot()
 {
-    ProgrammerSettings settings;
-    settings.sckDuration = getRawSetting(PAVR2_SETTING_SCK_DURATION);
-    settings.ispFastestPeriod = getRawSetting(PAVR2_SETTING_ISP_FASTEST_PERIOD);
-    settings.regulatorMode = getRawSetting(PAVR2_SETTING_REGULATOR_MODE);
-    settings.vccOutputEnabled = getRawSetting(PAVR2_SETTING_VCC_OUTPUT_ENABLED) ? 1 : 0;
-    settings.vccOutputIndicator = getRawSetting(PAVR2_SETTING_VCC_OUTPUT_INDICATOR) ? 1 : 0;
-    settings.lineAFunction = getRawSetting(PAVR2_SETTING_LINE_A_FUNCTION);
-    settings.lineBFunction = getRawSetting(PAVR2_SETTING_LINE_B_FUNCTION);
-    settings.softwareVersionMajor = getRawSetting(PAVR2_SETTING_SOFTWARE_VERSION_MAJOR);
-    settings.softwareVersionMinor = getRawSetting(PAVR2_SETTING_SOFTWARE_VERSION_MINOR);
-    settings.hardwareVersion = getRawSetting(PAVR2_SETTING_HARDWARE_VERSION);
-    settings.vccVddMaxRange = getRawSetting(PAVR2_SETTING_VCC_VDD_MAX_RANGE)
-        * PAVR2_VOLTAGE_UNITS;
-    settings.vcc3v3Min = getRawSetting(PAVR2_SETTING_VCC_3V3_MIN) * PAVR2_VOLTAGE_UNITS;
-    settings.vcc3v3Max = getRawSetting(PAVR2_SETTING_VCC_3V3_MAX) * PAVR2_VOLTAGE_UNITS;
-    settings.vcc5vMin = getRawSetting(PAVR2_SETTING_VCC_5V_MIN) * PAVR2_VOLTAGE_UNITS;
-    settings.vcc5vMax = getRawSetting(PAVR2_SETTING_VCC_5V_MAX) * PAVR2_VOLTAGE_UNITS;
-
     // We don't read the reset polarity here because that gets set by programming
     // software before each session; it is not really a persistent setting
     // and it might be confusing to present it that way.
+    static const uint8_t ids[] = {
+        PAVR2_SETTING_SCK_DURATION,
+        PAVR2_SETTING_ISP_FASTEST_PERIOD,
+        PAVR2_SETTING_REGULATOR_MODE,
+        PAVR2_SETTING_VCC_OUTPUT_ENABLED,
+        PAVR2_SETTING_VCC_OUTPUT_INDICATOR,
+        PAVR2_SETTING_LINE_A_FUNCTION,
+        PAVR2_SETTING_LINE_B_FUNCTION,
+        PAVR2_SETTING_SOFTWARE_VERSION_MAJOR,
+        PAVR2_SETTING_SOFTWARE_VERSION_MINOR,
+        PAVR2_SETTING_HARDWARE_VERSION,
+        PAVR2_SETTING_VCC_VDD_MAX_RANGE,
+        PAVR2_SETTING_VCC_3V3_MIN,
+        PAVR2_SETTING_VCC_3V3_MAX,
+        PAVR2_SETTING_VCC_5V_MIN,
+        PAVR2_SETTING_VCC_5V_MAX,
+    };
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    uint8_t raw[PAVR2_SETTING_VCC_5V_MAX + 1] = { 0 };
+    for (uint8_t id : ids)
+    {
+        raw[id] = getRawSetting(id);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(transferState->mutex);
+        for (uint8_t id : ids)
+        {
+            transferState->settingsShadow[id] = raw[id];
+            transferState->settingsShadowMask |= (uint32_t)1 << id;
+        }
+        transferState->settingsShadowRead = true;
+        transferState->settingsShadowReadTime = startTime;
+    }
+
+    ProgrammerSettingsSnapshot snapshot;
+    snapshot.readTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+
+    ProgrammerSettings & settings = snapshot.settings;
+    settings.sckDuration = raw[PAVR2_SETTING_SCK_DURATION];
+    settings.ispFastestPeriod = raw[PAVR2_SETTING_ISP_FASTEST_PERIOD];
+    settings.regulatorMode = raw[PAVR2_SETTING_REGULATOR_MODE];
+    settings.vccOutputEnabled = raw[PAVR2_SETTING_VCC_OUTPUT_ENABLED] ? 1 : 0;
+    settings.vccOutputIndicator = raw[PAVR2_SETTING_VCC_OUTPUT_INDICATOR] ? 1 : 0;
+    settings.lineAFunction = raw[PAVR2_SETTING_LINE_A_FUNCTION];
+    settings.lineBFunction = raw[PAVR2_SETTING_LINE_B_FUNCTION];
+    settings.softwareVersionMajor = raw[PAVR2_SETTING_SOFTWARE_VERSION_MAJOR];
+    settings.softwareVersionMinor = raw[PAVR2_SETTING_SOFTWARE_VERSION_MINOR];
+    settings.hardwareVersion = raw[PAVR2_SETTING_HARDWARE_VERSION];
+    settings.vccVddMaxRange = raw[PAVR2_SETTING_VCC_VDD_MAX_RANGE]
+        * PAVR2_VOLTAGE_UNITS;
+    settings.vcc3v3Min = raw[PAVR2_SETTING_VCC_3V3_MIN] * PAVR2_VOLTAGE_UNITS;
+    settings.vcc3v3Max = raw[PAVR2_SETTING_VCC_3V3_MAX] * PAVR2_VOLTAGE_UNITS;
+    settings.vcc5vMin = raw[PAVR2_SETTING_VCC_5V_MIN] * PAVR2_VOLTAGE_UNITS;
+    settings.vcc5vMax = raw[PAVR2_SETTING_VCC_5V_MAX] * PAVR2_VOLTAGE_UNITS;
+
+    return snapshot;
+}
 
-    return settings;
+ProgrammerSettings ProgrammerHandle::getSettings()
+{
+    return getSettingsSnapshot().settings;
 }
 
 // [all-settings]
@@ -684,58 +1402,91 @@ void ProgrammerHandle::applySettings(const ProgrammerSettings & settings)
 {
     validateSettings(settings);
 
+    // Settings that the shadow copy says are already correct on the device
+    // are skipped, so typically only the settings that changed get sent.
+    // Another program could have changed the settings since we read them, so
+    // read them again unless that was very recent.
+    bool shadowFresh;
+    {
+        std::lock_guard<std::mutex> lock(transferState->mutex);
+        shadowFresh = transferState->settingsShadowRead &&
+            std::chrono::steady_clock::now() - transferState->settingsShadowReadTime <
+            std::chrono::milliseconds(settingsShadowMaxAgeMs);
+    }
+    if (!shadowFresh) { getSettingsSnapshot(); }
+
     // We set vccOutputEnabled in a special way to ensure that if it is changing,
     // we won't accidentally output the wrong voltage on VCC for some time.
     if (!settings.vccOutputEnabled)
     {
-        setRawSetting(PAVR2_SETTING_VCC_OUTPUT_ENABLED, 0);
+        updateRawSetting(PAVR2_SETTING_VCC_OUTPUT_ENABLED, 0);
     }
 
-    setRawSetting(PAVR2_SETTING_SCK_DURATION, settings.sckDuration);
-    setRawSetting(PAVR2_SETTING_ISP_FASTEST_PERIOD, settings.ispFastestPeriod);
-    setRawSetting(PAVR2_SETTING_REGULATOR_MODE, settings.regulatorMode);
-    setRawSetting(PAVR2_SETTING_VCC_OUTPUT_INDICATOR, settings.vccOutputIndicator);
-    setRawSetting(PAVR2_SETTING_LINE_A_FUNCTION, settings.lineAFunction);
-    setRawSetting(PAVR2_SETTING_LINE_B_FUNCTION, settings.lineBFunction);
-    setRawSetting(PAVR2_SETTING_SOFTWARE_VERSION_MAJOR, settings.softwareVersionMajor);
-    setRawSetting(PAVR2_SETTING_SOFTWARE_VERSION_MINOR, settings.softwareVersionMinor);
-    setRawSetting(PAVR2_SETTING_HARDWARE_VERSION, settings.hardwareVersion);
-    setRawSetting(PAVR2_SETTING_VCC_VDD_MAX_RANGE,
+    updateRawSetting(PAVR2_SETTING_SCK_DURATION, settings.sckDuration);
+    updateRawSetting(PAVR2_SETTING_ISP_FASTEST_PERIOD, settings.ispFastestPeriod);
+    updateRawSetting(PAVR2_SETTING_REGULATOR_MODE, settings.regulatorMode);
+    updateRawSetting(PAVR2_SETTING_VCC_OUTPUT_INDICATOR, settings.vccOutputIndicator);
+    updateRawSetting(PAVR2_SETTING_LINE_A_FUNCTION, settings.lineAFunction);
+    updateRawSetting(PAVR2_SETTING_LINE_B_FUNCTION, settings.lineBFunction);
+    updateRawSetting(PAVR2_SETTING_SOFTWARE_VERSION_MAJOR, settings.softwareVersionMajor);
+    updateRawSetting(PAVR2_SETTING_SOFTWARE_VERSION_MINOR, settings.softwareVersionMinor);
+    updateRawSetting(PAVR2_SETTING_HARDWARE_VERSION, settings.hardwareVersion);
+    updateRawSetting(PAVR2_SETTING_VCC_VDD_MAX_RANGE,
         convertMvToRawUnits(settings.vccVddMaxRange));
-    setRawSetting(PAVR2_SETTING_VCC_3V3_MIN,
+    updateRawSetting(PAVR2_SETTING_VCC_3V3_MIN,
         convertMvToRawUnits(settings.vcc3v3Min));
-    setRawSetting(PAVR2_SETTING_VCC_3V3_MAX,
+    updateRawSetting(PAVR2_SETTING_VCC_3V3_MAX,
         convertMvToRawUnits(settings.vcc3v3Max));
-    setRawSetting(PAVR2_SETTING_VCC_5V_MIN,
+    updateRawSetting(PAVR2_SETTING_VCC_5V_MIN,
         convertMvToRawUnits(settings.vcc5vMin));
-    setRawSetting(PAVR2_SETTING_VCC_5V_MAX,
+    updateRawSetting(PAVR2_SETTING_VCC_5V_MAX,
         convertMvToRawUnits(settings.vcc5vMax));
 
     if (settings.vccOutputEnabled)
     {
-        setRawSetting(PAVR2_SETTING_VCC_OUTPUT_ENABLED, 1);
+        updateRawSetting(PAVR2_SETTING_VCC_OUTPUT_ENABLED, 1);
     }
 }
 
-void ProgrammerHandle::restoreDefaults()
+ProgrammerRestoreResult ProgrammerHandle::restoreDefaults(
+    const ProgrammerRestoreOptions & options)
 {
+    // Every setting is about to change.
+    invalidateSettingsShadow();
+
+    auto startTime = std::chrono::steady_clock::now();
+    auto deadline = startTime + std::chrono::milliseconds(options.timeoutMs);
+
     setRawSetting(PAVR2_SETTING_NOT_INITIALIZED, 0xFF);
 
     // The request above returns before the settings are actually initialized.
-    // Wait until the programmer succeeds in reinitializing its settings.
-    uint32_t timeMs = 0;
+    // Poll until the programmer succeeds in reinitializing its settings,
+    // starting with short delays and backing off.
+    uint32_t delayUs = std::max<uint32_t>(options.firstPollDelayUs, 1);
     while (1)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        timeMs += 10;
+        if (options.cancel && *options.cancel)
+        {
+            throw std::runtime_error(
+                "Resetting to default settings was cancelled.");
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(delayUs));
+        delayUs = std::min(delayUs * 2,
+            std::max(options.maxPollDelayUs, options.firstPollDelayUs));
 
         uint8_t notInitialized = getRawSetting(PAVR2_SETTING_NOT_INITIALIZED);
+        auto now = std::chrono::steady_clock::now();
         if (!notInitialized)
         {
-            break;
+            ProgrammerRestoreResult result;
+            result.settleTimeUs = std::chrono::duration_cast<
+                std::chrono::microseconds>(now - startTime).count();
+            result.settings = getSettings();
+            return result;
         }
 
-        if (timeMs > 300)
+        if (now > deadline)
         {
             throw std::runtime_error(
                 "A timeout occurred while resetting to default settings.");
@@ -745,42 +1496,62 @@ void ProgrammerHandle::restoreDefaults()
 
 ProgrammerVariables ProgrammerHandle::getVariables()
 {
-    ProgrammerVariables vars;
+    return getVariables(PAVR2_VARIABLE_MASK_ALL).variables;
+}
+
+ProgrammerPartialVariables ProgrammerHandle::getVariables(uint32_t mask)
+{
+    ProgrammerPartialVariables result;
+
+    uint8_t raw[PAVR2_VARIABLE_IN_PROGRAMMING_MODE + 1] = { 0 };
+    for (uint8_t id = PAVR2_VARIABLE_LAST_DEVICE_RESET;
+         id <= PAVR2_VARIABLE_IN_PROGRAMMING_MODE; id++)
+    {
+        if (mask & PAVR2_VARIABLE_MASK(id))
+        {
+            raw[id] = getRawVariable(id);
+            result.validMask |= PAVR2_VARIABLE_MASK(id);
+        }
+    }
+
+    ProgrammerVariables & vars = result.variables;
 
-    vars.lastDeviceReset = getRawVariable(PAVR2_VARIABLE_LAST_DEVICE_RESET);
+    vars.lastDeviceReset = raw[PAVR2_VARIABLE_LAST_DEVICE_RESET];
 
-    vars.programmingError = getRawVariable(PAVR2_VARIABLE_PROGRAMMING_ERROR);
+    vars.programmingError = raw[PAVR2_VARIABLE_PROGRAMMING_ERROR];
 
     vars.targetVccMeasuredMinMv =
-        getRawVariable(PAVR2_VARIABLE_TARGET_VCC_MEASURED_MIN) * PAVR2_VOLTAGE_UNITS;
+        raw[PAVR2_VARIABLE_TARGET_VCC_MEASURED_MIN] * PAVR2_VOLTAGE_UNITS;
 
     vars.targetVccMeasuredMaxMv =
-        getRawVariable(PAVR2_VARIABLE_TARGET_VCC_MEASURED_MAX) * PAVR2_VOLTAGE_UNITS;
+        raw[PAVR2_VARIABLE_TARGET_VCC_MEASURED_MAX] * PAVR2_VOLTAGE_UNITS;
 
     vars.programmerVddMeasuredMinMv =
-        getRawVariable(PAVR2_VARIABLE_PROGRAMMER_VDD_MEASURED_MIN) * PAVR2_VOLTAGE_UNITS;
+        raw[PAVR2_VARIABLE_PROGRAMMER_VDD_MEASURED_MIN] * PAVR2_VOLTAGE_UNITS;
 
     vars.programmerVddMeasuredMaxMv =
-        getRawVariable(PAVR2_VARIABLE_PROGRAMMER_VDD_MEASURED_MAX) * PAVR2_VOLTAGE_UNITS;
+        raw[PAVR2_VARIABLE_PROGRAMMER_VDD_MEASURED_MAX] * PAVR2_VOLTAGE_UNITS;
 
-    vars.hasResultsFromLastProgramming =
-        (vars.programmingError != 0) ||
-        (vars.targetVccMeasuredMinMv != 255 * PAVR2_VOLTAGE_UNITS) ||
-        (vars.targetVccMeasuredMaxMv != 0) ||
-        (vars.programmerVddMeasuredMinMv != 255 * PAVR2_VOLTAGE_UNITS) ||
-        (vars.programmerVddMeasuredMaxMv != 0);
+    if ((result.validMask & PAVR2_VARIABLE_MASK_LAST_PROGRAMMING) ==
+        PAVR2_VARIABLE_MASK_LAST_PROGRAMMING)
+    {
+        vars.hasResultsFromLastProgramming =
+            (vars.programmingError != 0) ||
+            (vars.targetVccMeasuredMinMv != 255 * PAVR2_VOLTAGE_UNITS) ||
+            (vars.targetVccMeasuredMaxMv != 0) ||
+            (vars.programmerVddMeasuredMinMv != 255 * PAVR2_VOLTAGE_UNITS) ||
+            (vars.programmerVddMeasuredMaxMv != 0);
+    }
 
-    vars.targetVccMv =
-        getRawVariable(PAVR2_VARIABLE_TARGET_VCC) * PAVR2_VOLTAGE_UNITS;
+    vars.targetVccMv = raw[PAVR2_VARIABLE_TARGET_VCC] * PAVR2_VOLTAGE_UNITS;
 
-    vars.programmerVddMv =
-        getRawVariable(PAVR2_VARIABLE_PROGRAMMER_VDD) * PAVR2_VOLTAGE_UNITS;
+    vars.programmerVddMv = raw[PAVR2_VARIABLE_PROGRAMMER_VDD] * PAVR2_VOLTAGE_UNITS;
 
-    vars.regulatorLevel = getRawVariable(PAVR2_VARIABLE_REGULATOR_LEVEL);
+    vars.regulatorLevel = raw[PAVR2_VARIABLE_REGULATOR_LEVEL];
 
-    vars.inProgrammingMode = getRawVariable(PAVR2_VARIABLE_IN_PROGRAMMING_MODE) ? 1 : 0;
+    vars.inProgrammingMode = raw[PAVR2_VARIABLE_IN_PROGRAMMING_MODE] ? 1 : 0;
 
-    return vars;
+    return result;
 }
 
 ProgrammerDigitalReadings ProgrammerHandle::digitalRead()
@@ -789,17 +1560,18 @@ ProgrammerDigitalReadings ProgrammerHandle::digitalRead()
     size_t transferred;
     try
     {
-        handle.control_transfer(0xC0, PAVR2_REQUEST_DIGITAL_READ,
-            0, 0, &buffer, 3, &transferred);
+        controlTransfer(&ProgrammerStats::digitalRead,
+            0xC0, PAVR2_REQUEST_DIGITAL_READ, 0, 0, &buffer, 3, &transferred);
     }
-    catch (const libusbp::error & error)
+    catch (const ProgrammerTransportError & error)
     {
-        throw std::runtime_error(std::string("Failed to get a variable.  ")
-            + error.message());
+        throw ProgrammerTransportError(std::string("Failed to get a variable.  ")
+            + error.what(), error.getCode());
     }
 
     if (transferred != 3)
     {
+        recordShortTransfer(&ProgrammerStats::digitalRead);
         throw std::runtime_error(std::string("Failed to get a variable.  ") +
             "Expected 3 bytes, got " + std::to_string(transferred));
     }
@@ -0,0 +1,110 @@
+#include <programmer_async.h>
+
+AsyncProgrammerHandle::AsyncProgrammerHandle(const ProgrammerHandle & handle)
+    : handle(handle)
+{
+    thread = std::thread(&AsyncProgrammerHandle::runThread, this);
+}
+
+AsyncProgrammerHandle::~AsyncProgrammerHandle()
+{
+    shutdown();
+}
+
+void AsyncProgrammerHandle::shutdown()
+{
+    // Only one caller gets to join the thread.  If this is called from a
+    // callback, we are on the I/O thread and cannot join it, but it will stop
+    // after it finishes the queue.
+    std::thread joinable;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        if (thread.get_id() != std::this_thread::get_id())
+        {
+            std::swap(joinable, thread);
+        }
+    }
+    queueChanged.notify_all();
+
+    if (joinable.joinable())
+    {
+        joinable.join();
+    }
+}
+
+bool AsyncProgrammerHandle::enqueue(std::function<void ()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) { return false; }
+        queue.push_back(std::move(task));
+    }
+    queueChanged.notify_one();
+    return true;
+}
+
+void AsyncProgrammerHandle::runThread()
+{
+    while (true)
+    {
+        std::function<void ()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queueChanged.wait(lock, [this] { return stopping || !queue.empty(); });
+
+            // Finish the queued operations before stopping so that none of the
+            // futures we handed out are left waiting forever.
+            if (queue.empty()) { return; }
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        task();
+    }
+}
+
+std::shared_future<ProgrammerSettings> AsyncProgrammerHandle::getSettings(
+    Callback<ProgrammerSettings> callback)
+{
+    return run<ProgrammerSettings>([](ProgrammerHandle & handle)
+    {
+        return handle.getSettings();
+    }, callback);
+}
+
+std::shared_future<void> AsyncProgrammerHandle::applySettings(
+    const ProgrammerSettings & settings, Callback<void> callback)
+{
+    return run<void>([settings](ProgrammerHandle & handle)
+    {
+        handle.applySettings(settings);
+    }, callback);
+}
+
+std::shared_future<ProgrammerVariables> AsyncProgrammerHandle::getVariables(
+    Callback<ProgrammerVariables> callback)
+{
+    return run<ProgrammerVariables>([](ProgrammerHandle & handle)
+    {
+        return handle.getVariables();
+    }, callback);
+}
+
+std::shared_future<ProgrammerDigitalReadings> AsyncProgrammerHandle::digitalRead(
+    Callback<ProgrammerDigitalReadings> callback)
+{
+    return run<ProgrammerDigitalReadings>([](ProgrammerHandle & handle)
+    {
+        return handle.digitalRead();
+    }, callback);
+}
+
+std::shared_future<ProgrammerRestoreResult> AsyncProgrammerHandle::restoreDefaults(
+    const ProgrammerRestoreOptions & options,
+    Callback<ProgrammerRestoreResult> callback)
+{
+    return run<ProgrammerRestoreResult>([options](ProgrammerHandle & handle)
+    {
+        return handle.restoreDefaults(options);
+    }, callback);
+}
@@ -0,0 +1,1197 @@
+#include <programmer_daemon.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+std::string programmerDaemonGetSocketPath()
+{
+    const char * path = getenv("PAVR2D_SOCKET");
+    const char * runtimeDir = getenv("XDG_RUNTIME_DIR");
+    if (path && path[0])
+    {
+        return path;
+    }
+    else if (runtimeDir && runtimeDir[0] == '/')
+    {
+        return std::string(runtimeDir) + "/pavr2d.sock";
+    }
+    else
+    {
+        return "/tmp/pavr2d-" + std::to_string(getuid()) + ".sock";
+    }
+}
+
+ProgrammerDaemonTransport::ProgrammerDaemonTransport(
+    std::shared_ptr<ProgrammerDaemonClient> client,
+    const std::string & serialNumber)
+    : client(client), serialNumber(serialNumber)
+{
+}
+
+void ProgrammerDaemonTransport::controlTransfer(uint8_t requestType,
+    uint8_t request, uint16_t value, uint16_t index,
+    void * buffer, uint16_t length, size_t * transferred)
+{
+    client->controlTransfer(serialNumber, requestType, request, value, index,
+        buffer, length, transferred);
+}
+
+// The daemon sends this to each client when it connects, followed by a 2-byte
+// protocol version, so that clients do not talk to something else by mistake.
+static const char daemonMagic[8] = { 'P', 'A', 'V', 'R', '2', 'D', 'M', 'N' };
+static const uint16_t daemonVersion = 2;
+
+// The first byte of each request says what it is.  All of them except
+// DAEMON_REQUEST_LIST are followed by the serial number of a programmer.
+#define DAEMON_REQUEST_LIST 1
+#define DAEMON_REQUEST_TRANSFER 2
+#define DAEMON_REQUEST_FIRMWARE_VERSION 3
+#define DAEMON_REQUEST_SETTINGS 4
+#define DAEMON_REQUEST_VARIABLES 5
+#define DAEMON_REQUEST_DIGITAL_READ 6
+
+// The first byte of each response says whether the request succeeded.
+#define DAEMON_RESPONSE_OK 0
+#define DAEMON_RESPONSE_ERROR 1
+
+// Each message is a 4-byte length followed by that many bytes.  Longer
+// messages are rejected so that a broken client cannot make the daemon use a
+// lot of memory.
+#define DAEMON_MAX_MESSAGE_SIZE 0x11000
+
+// The daemon stops reading requests from a client while this many bytes of
+// responses are waiting to be sent to it, so a client that sends requests
+// without reading the responses cannot make the daemon use a lot of memory.
+#define DAEMON_MAX_PENDING_OUTPUT 0x10000
+
+// How long a client waits for the daemon to respond, in milliseconds.  The
+// daemon's USB transfers time out long before this.
+#define DAEMON_CLIENT_TIMEOUT_MS 5000
+
+// How often the daemon wakes up to process hotplug events, in milliseconds.
+#define DAEMON_POLL_INTERVAL_MS 200
+
+// How long the daemon uses the settings it read from a programmer before
+// reading them again, in milliseconds.
+#define DAEMON_SETTINGS_MAX_AGE_MS 1000
+
+#define USB_REQUEST_GET_DESCRIPTOR 6
+
+static void appendUInt(std::string & out, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        out += (char)(value >> (8 * i) & 0xFF);
+    }
+}
+
+// Appends a string preceded by its length.  lengthSize is the size of the
+// length field in bytes.
+static void appendString(std::string & out, const std::string & str,
+    size_t lengthSize)
+{
+    uint64_t maxLength = ((uint64_t)1 << (8 * lengthSize)) - 1;
+    size_t length = str.size() < maxLength ? str.size() : maxLength;
+    appendUInt(out, length, lengthSize);
+    out.append(str, 0, length);
+}
+
+// Reads little-endian numbers and strings from a message.
+class MessageReader
+{
+public:
+    explicit MessageReader(const std::string & data) : data(data) { }
+
+    uint64_t readUInt(size_t size)
+    {
+        need(size);
+        uint64_t value = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            value |= (uint64_t)(uint8_t)data[position + i] << (8 * i);
+        }
+        position += size;
+        return value;
+    }
+
+    std::string readString(size_t lengthSize)
+    {
+        size_t length = readUInt(lengthSize);
+        need(length);
+        std::string str = data.substr(position, length);
+        position += length;
+        return str;
+    }
+
+private:
+    void need(size_t size)
+    {
+        if (data.size() - position < size)
+        {
+            throw std::runtime_error("A daemon message is truncated.");
+        }
+    }
+
+    const std::string & data;
+    size_t position = 0;
+};
+
+// [all-settings]
+static void appendSettings(std::string & out, const ProgrammerSettings & settings)
+{
+    appendUInt(out, settings.sckDuration, 4);
+    appendUInt(out, settings.ispFastestPeriod, 4);
+    appendUInt(out, settings.regulatorMode, 1);
+    appendUInt(out, settings.vccOutputEnabled, 1);
+    appendUInt(out, settings.vccOutputIndicator, 1);
+    appendUInt(out, settings.lineAFunction, 1);
+    appendUInt(out, settings.lineBFunction, 1);
+    appendUInt(out, settings.vccVddMaxRange, 4);
+    appendUInt(out, settings.vcc3v3Min, 4);
+    appendUInt(out, settings.vcc3v3Max, 4);
+    appendUInt(out, settings.vcc5vMin, 4);
+    appendUInt(out, settings.vcc5vMax, 4);
+    appendUInt(out, settings.hardwareVersion, 4);
+    appendUInt(out, settings.softwareVersionMajor, 4);
+    appendUInt(out, settings.softwareVersionMinor, 4);
+}
+
+// [all-settings]
+static ProgrammerSettings readSettings(MessageReader & reader)
+{
+    ProgrammerSettings settings;
+    settings.sckDuration = reader.readUInt(4);
+    settings.ispFastestPeriod = reader.readUInt(4);
+    settings.regulatorMode = reader.readUInt(1);
+    settings.vccOutputEnabled = reader.readUInt(1);
+    settings.vccOutputIndicator = reader.readUInt(1);
+    settings.lineAFunction = reader.readUInt(1);
+    settings.lineBFunction = reader.readUInt(1);
+    settings.vccVddMaxRange = reader.readUInt(4);
+    settings.vcc3v3Min = reader.readUInt(4);
+    settings.vcc3v3Max = reader.readUInt(4);
+    settings.vcc5vMin = reader.readUInt(4);
+    settings.vcc5vMax = reader.readUInt(4);
+    settings.hardwareVersion = reader.readUInt(4);
+    settings.softwareVersionMajor = reader.readUInt(4);
+    settings.softwareVersionMinor = reader.readUInt(4);
+    return settings;
+}
+
+static void appendVariables(std::string & out, const ProgrammerVariables & variables)
+{
+    appendUInt(out, variables.lastDeviceReset, 1);
+    appendUInt(out, variables.hasResultsFromLastProgramming, 1);
+    appendUInt(out, variables.programmingError, 1);
+    appendUInt(out, variables.targetVccMeasuredMinMv, 2);
+    appendUInt(out, variables.targetVccMeasuredMaxMv, 2);
+    appendUInt(out, variables.programmerVddMeasuredMinMv, 2);
+    appendUInt(out, variables.programmerVddMeasuredMaxMv, 2);
+    appendUInt(out, variables.targetVccMv, 2);
+    appendUInt(out, variables.programmerVddMv, 2);
+    appendUInt(out, variables.regulatorLevel, 1);
+    appendUInt(out, variables.inProgrammingMode, 1);
+}
+
+static ProgrammerVariables readVariables(MessageReader & reader)
+{
+    ProgrammerVariables variables;
+    variables.lastDeviceReset = reader.readUInt(1);
+    variables.hasResultsFromLastProgramming = reader.readUInt(1);
+    variables.programmingError = reader.readUInt(1);
+    variables.targetVccMeasuredMinMv = reader.readUInt(2);
+    variables.targetVccMeasuredMaxMv = reader.readUInt(2);
+    variables.programmerVddMeasuredMinMv = reader.readUInt(2);
+    variables.programmerVddMeasuredMaxMv = reader.readUInt(2);
+    variables.targetVccMv = reader.readUInt(2);
+    variables.programmerVddMv = reader.readUInt(2);
+    variables.regulatorLevel = reader.readUInt(1);
+    variables.inProgrammingMode = reader.readUInt(1);
+    return variables;
+}
+
+static std::string errorResponse(const ProgrammerTransportError & error)
+{
+    std::string response;
+    appendUInt(response, DAEMON_RESPONSE_ERROR, 1);
+    appendUInt(response, error.getCode(), 4);
+    appendString(response, error.what(), 2);
+    return response;
+}
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Makes writing to a socket whose other end was closed fail with EPIPE instead
+// of raising SIGPIPE, on systems that do not support MSG_NOSIGNAL.
+static void disableSigPipe(int fd)
+{
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+    (void)fd;
+#endif
+}
+
+// Returns true if the path is a socket that belongs to the current user and
+// that other users cannot connect to.  Anyone can create files in /tmp, so this
+// keeps clients from talking to a socket that someone else put where the
+// daemon's socket would be.
+static bool isOwnSocket(const std::string & path)
+{
+    struct stat st;
+    return lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) &&
+        st.st_uid == getuid() && (st.st_mode & 0077) == 0;
+}
+
+// Returns true if the process on the other end of a connected Unix domain
+// socket is running as the current user.
+static bool peerIsCurrentUser(int fd)
+{
+#ifdef SO_PEERCRED
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0)
+    {
+        return false;
+    }
+    return credentials.uid == getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if (getpeereid(fd, &uid, &gid) != 0) { return false; }
+    return uid == getuid();
+#endif
+}
+
+static bool makeAddress(const std::string & path, struct sockaddr_un & address)
+{
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) { return false; }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Connects to a Unix domain socket.  Returns -1 and sets errno if it fails.
+static int connectSocket(const std::string & path)
+{
+    struct sockaddr_un address;
+    if (!makeAddress(path, address))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) { return -1; }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    disableSigPipe(fd);
+
+    if (::connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+static bool sendAll(int fd, const char * data, size_t size)
+{
+    while (size)
+    {
+        ssize_t result = send(fd, data, size, MSG_NOSIGNAL);
+        if (result < 0)
+        {
+            if (errno == EINTR) { continue; }
+            return false;
+        }
+        data += result;
+        size -= result;
+    }
+    return true;
+}
+
+// Receives exactly the specified number of bytes.  Returns false if the
+// connection was closed or the receive timeout expired.
+static bool receiveAll(int fd, char * data, size_t size)
+{
+    while (size)
+    {
+        ssize_t result = recv(fd, data, size, 0);
+        if (result < 0 && errno == EINTR) { continue; }
+        if (result <= 0) { return false; }
+        data += result;
+        size -= result;
+    }
+    return true;
+}
+
+std::shared_ptr<ProgrammerDaemonClient> ProgrammerDaemonClient::connect(
+    const std::string & socketPath)
+{
+    if (socketPath.empty() || !isOwnSocket(socketPath)) { return nullptr; }
+
+    int fd = connectSocket(socketPath);
+    if (fd < 0) { return nullptr; }
+
+    // Only a daemon started by the same user can be trusted with our
+    // programmers.
+    if (!peerIsCurrentUser(fd))
+    {
+        ::close(fd);
+        return nullptr;
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = DAEMON_CLIENT_TIMEOUT_MS / 1000;
+    timeout.tv_usec = DAEMON_CLIENT_TIMEOUT_MS % 1000 * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // If something else is listening on the socket, or a daemon that speaks a
+    // different version of the protocol, act like no daemon is running.
+    char greeting[sizeof(daemonMagic) + 2];
+    if (!receiveAll(fd, greeting, sizeof(greeting)) ||
+        memcmp(greeting, daemonMagic, sizeof(daemonMagic)) ||
+        MessageReader(std::string(greeting + sizeof(daemonMagic), 2)).readUInt(2)
+        != daemonVersion)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+
+    return std::shared_ptr<ProgrammerDaemonClient>(new ProgrammerDaemonClient(fd));
+}
+
+ProgrammerDaemonClient::ProgrammerDaemonClient(int socket) : socket(socket)
+{
+}
+
+ProgrammerDaemonClient::~ProgrammerDaemonClient()
+{
+    disconnect();
+}
+
+void ProgrammerDaemonClient::disconnect()
+{
+    if (socket >= 0)
+    {
+        ::close(socket);
+        socket = -1;
+    }
+}
+
+// Sends a request and returns the response.  The caller must hold the mutex.
+// If anything goes wrong, the connection is closed because we would not know
+// which response belongs to which request any more.
+std::string ProgrammerDaemonClient::request(const std::string & message)
+{
+    if (socket < 0)
+    {
+        throw ProgrammerTransportError("The connection to the daemon was lost.");
+    }
+
+    std::string frame;
+    appendUInt(frame, message.size(), 4);
+    frame += message;
+    if (!sendAll(socket, frame.data(), frame.size()))
+    {
+        disconnect();
+        throw ProgrammerTransportError("Failed to send a request to the daemon.");
+    }
+
+    char header[4];
+    if (!receiveAll(socket, header, sizeof(header)))
+    {
+        disconnect();
+        throw ProgrammerTransportError("The daemon did not respond.");
+    }
+    size_t length = MessageReader(std::string(header, sizeof(header))).readUInt(4);
+    if (length > DAEMON_MAX_MESSAGE_SIZE)
+    {
+        disconnect();
+        throw ProgrammerTransportError("The daemon sent an invalid response.");
+    }
+
+    std::string response(length, 0);
+    if (length && !receiveAll(socket, &response[0], length))
+    {
+        disconnect();
+        throw ProgrammerTransportError("The daemon did not respond.");
+    }
+    return response;
+}
+
+std::vector<ProgrammerDaemonDevice> ProgrammerDaemonClient::getList()
+{
+    std::string message;
+    appendUInt(message, DAEMON_REQUEST_LIST, 1);
+
+    std::string response;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        response = request(message);
+    }
+
+    MessageReader reader(response);
+    if (reader.readUInt(1) != DAEMON_RESPONSE_OK)
+    {
+        throw std::runtime_error("The daemon failed to list the programmers.");
+    }
+
+    std::vector<ProgrammerDaemonDevice> list(reader.readUInt(2));
+    for (ProgrammerDaemonDevice & device : list)
+    {
+        uint16_t productId = reader.readUInt(2);
+        uint16_t firmwareVersion = reader.readUInt(2);
+        std::string serialNumber = reader.readString(1);
+        device.instance = ProgrammerInstance(libusbp::device(),
+            libusbp::generic_interface(), productId, serialNumber,
+            firmwareVersion);
+        device.programmingPortName = reader.readString(1);
+        device.ttlPortName = reader.readString(1);
+    }
+    return list;
+}
+
+// Sends a request about one programmer and returns the response, which starts
+// with DAEMON_RESPONSE_OK.  Throws the error that the daemon sent back if the
+// request failed.
+std::string ProgrammerDaemonClient::requestForDevice(const std::string & message)
+{
+    std::string response;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        response = request(message);
+    }
+
+    MessageReader reader(response);
+    if (reader.readUInt(1) != DAEMON_RESPONSE_OK)
+    {
+        uint32_t code = reader.readUInt(4);
+        throw ProgrammerTransportError(reader.readString(2), code);
+    }
+    return response;
+}
+
+static std::string deviceMessage(uint8_t requestType,
+    const std::string & serialNumber)
+{
+    std::string message;
+    appendUInt(message, requestType, 1);
+    appendString(message, serialNumber, 1);
+    return message;
+}
+
+void ProgrammerDaemonClient::controlTransfer(const std::string & serialNumber,
+    uint8_t requestType, uint8_t request, uint16_t value, uint16_t index,
+    void * buffer, uint16_t length, size_t * transferred)
+{
+    bool in = requestType & 0x80;
+
+    std::string message = deviceMessage(DAEMON_REQUEST_TRANSFER, serialNumber);
+    appendUInt(message, requestType, 1);
+    appendUInt(message, request, 1);
+    appendUInt(message, value, 2);
+    appendUInt(message, index, 2);
+    appendUInt(message, length, 2);
+    if (!in)
+    {
+        appendString(message, buffer ?
+            std::string((const char *)buffer, length) : std::string(), 2);
+    }
+
+    std::string response = requestForDevice(message);
+    MessageReader reader(response);
+    reader.readUInt(1);
+
+    size_t localTransferred;
+    if (in)
+    {
+        std::string data = reader.readString(2);
+        localTransferred = std::min<size_t>(data.size(), length);
+        if (buffer) { memcpy(buffer, data.data(), localTransferred); }
+    }
+    else
+    {
+        localTransferred = reader.readUInt(2);
+    }
+    if (transferred) { *transferred = localTransferred; }
+}
+
+std::string ProgrammerDaemonClient::getFirmwareVersionString(
+    const std::string & serialNumber)
+{
+    std::string response = requestForDevice(
+        deviceMessage(DAEMON_REQUEST_FIRMWARE_VERSION, serialNumber));
+    MessageReader reader(response);
+    reader.readUInt(1);
+    return reader.readString(1);
+}
+
+ProgrammerSettings ProgrammerDaemonClient::getSettings(
+    const std::string & serialNumber)
+{
+    std::string response = requestForDevice(
+        deviceMessage(DAEMON_REQUEST_SETTINGS, serialNumber));
+    MessageReader reader(response);
+    reader.readUInt(1);
+    return readSettings(reader);
+}
+
+ProgrammerVariables ProgrammerDaemonClient::getVariables(
+    const std::string & serialNumber)
+{
+    std::string response = requestForDevice(
+        deviceMessage(DAEMON_REQUEST_VARIABLES, serialNumber));
+    MessageReader reader(response);
+    reader.readUInt(1);
+    return readVariables(reader);
+}
+
+ProgrammerDigitalReadings ProgrammerDaemonClient::digitalRead(
+    const std::string & serialNumber)
+{
+    std::string response = requestForDevice(
+        deviceMessage(DAEMON_REQUEST_DIGITAL_READ, serialNumber));
+    MessageReader reader(response);
+    reader.readUInt(1);
+    ProgrammerDigitalReadings readings;
+    readings.portA = reader.readUInt(1);
+    readings.portB = reader.readUInt(1);
+    readings.portC = reader.readUInt(1);
+    return readings;
+}
+
+ProgrammerDaemonServer::ProgrammerDaemonServer(const std::string & socketPath)
+    : socketPath(socketPath), stopping(false)
+{
+    struct sockaddr_un address;
+    if (!makeAddress(socketPath, address))
+    {
+        throw std::runtime_error(
+            "The socket path '" + socketPath + "' is too long.");
+    }
+
+    // Never replace something that is not our own socket.
+    struct stat st;
+    if (lstat(socketPath.c_str(), &st) == 0 &&
+        (!S_ISSOCK(st.st_mode) || st.st_uid != getuid()))
+    {
+        throw std::runtime_error("The file '" + socketPath +
+            "' already exists and is not a socket owned by the current user.");
+    }
+
+    // A socket file left behind by a daemon that crashed can be replaced, but
+    // not one that a daemon is listening on.
+    int existing = connectSocket(socketPath);
+    if (existing >= 0)
+    {
+        ::close(existing);
+        throw std::runtime_error(
+            "Another daemon is already listening on '" + socketPath + "'.");
+    }
+    if (errno == ECONNREFUSED)
+    {
+        unlink(socketPath.c_str());
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        throw std::runtime_error(
+            std::string("Failed to create a socket: ") + strerror(errno));
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    // Anyone who can connect to the socket can change the settings of the
+    // programmers, so only let the current user do it.
+    mode_t oldMask = umask(0077);
+    int result = bind(fd, (struct sockaddr *)&address, sizeof(address));
+    umask(oldMask);
+    if (result != 0 || listen(fd, 16) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Failed to listen on '" + socketPath + "': " +
+            strerror(error));
+    }
+    listenSocket = fd;
+
+    if (pipe(wakePipe) != 0)
+    {
+        throw std::runtime_error(
+            std::string("Failed to create a pipe: ") + strerror(errno));
+    }
+    for (int end : wakePipe)
+    {
+        fcntl(end, F_SETFD, FD_CLOEXEC);
+        fcntl(end, F_SETFL, fcntl(end, F_GETFL) | O_NONBLOCK);
+    }
+
+    registry.onAdded([this](const ProgrammerInstance & instance)
+    {
+        addDevice(instance);
+    });
+    registry.onRemoved([this](const ProgrammerInstance & instance)
+    {
+        removeDevice(instance);
+    });
+    for (const ProgrammerInstance & instance : registry.getList())
+    {
+        addDevice(instance);
+    }
+}
+
+ProgrammerDaemonServer::~ProgrammerDaemonServer()
+{
+    // Stop the I/O threads before closing the pipe they use to wake us up.
+    devices.clear();
+
+    for (Connection & connection : connections)
+    {
+        ::close(connection.socket);
+    }
+    ::close(wakePipe[0]);
+    ::close(wakePipe[1]);
+    ::close(listenSocket);
+    unlink(socketPath.c_str());
+}
+
+void ProgrammerDaemonServer::stop()
+{
+    stopping = true;
+}
+
+void ProgrammerDaemonServer::addDevice(const ProgrammerInstance & instance)
+{
+    // Finding the port names can take a while, so do it once here instead of
+    // for every client.
+    Device device;
+    device.instance = instance;
+    try
+    {
+        device.programmingPortName = instance.getProgrammingPortName();
+        device.ttlPortName = instance.getTtlPortName();
+    }
+    catch (const libusbp::error &)
+    {
+    }
+    devices[instance.getSerialNumber()] = device;
+}
+
+void ProgrammerDaemonServer::removeDevice(const ProgrammerInstance & instance)
+{
+    auto it = devices.find(instance.getSerialNumber());
+    if (it != devices.end() &&
+        it->second.instance.getOsId() == instance.getOsId())
+    {
+        devices.erase(it);
+    }
+}
+
+ProgrammerDaemonServer::Device * ProgrammerDaemonServer::findDevice(
+    const std::string & serialNumber)
+{
+    auto it = devices.find(serialNumber);
+    return it == devices.end() ? NULL : &it->second;
+}
+
+void ProgrammerDaemonServer::run()
+{
+    while (!stopping)
+    {
+        std::vector<struct pollfd> fds(connections.size() + 2);
+        fds[0].fd = listenSocket;
+        fds[0].events = POLLIN;
+        fds[1].fd = wakePipe[0];
+        fds[1].events = POLLIN;
+        for (size_t i = 0; i < connections.size(); i++)
+        {
+            const Connection & connection = connections[i];
+            struct pollfd & fd = fds[i + 2];
+            fd.fd = connection.socket;
+            fd.events = 0;
+            if (connection.output.size() < DAEMON_MAX_PENDING_OUTPUT)
+            {
+                fd.events |= POLLIN;
+            }
+            if (!connection.output.empty()) { fd.events |= POLLOUT; }
+        }
+
+        int result = poll(fds.data(), fds.size(), DAEMON_POLL_INTERVAL_MS);
+        if (result < 0 && errno != EINTR)
+        {
+            throw std::runtime_error(std::string("Failed to poll: ") +
+                strerror(errno));
+        }
+
+        // Processing the hotplug events costs almost nothing, so do it every
+        // time we wake up.  Without them, the list is only updated when a
+        // client needs it.
+        if (registry.isEventDriven()) { registry.update(); }
+
+        if (result <= 0) { continue; }
+
+        if (fds[1].revents & POLLIN)
+        {
+            handleCompletions();
+        }
+
+        for (size_t i = 0; i < connections.size(); i++)
+        {
+            Connection & connection = connections[i];
+            bool ok = true;
+            if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                ok = readConnection(connection);
+            }
+            if (ok && !connection.output.empty())
+            {
+                ok = writeConnection(connection);
+            }
+            if (ok)
+            {
+                // Handle the requests that were held back while the output
+                // was full or while an earlier request was running.
+                ok = handleInput(connection);
+            }
+            if (!ok)
+            {
+                ::close(connection.socket);
+                connection.socket = -1;
+            }
+        }
+
+        for (auto it = connections.begin(); it != connections.end(); )
+        {
+            if (it->socket < 0) { it = connections.erase(it); }
+            else { ++it; }
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            acceptConnection();
+        }
+    }
+}
+
+void ProgrammerDaemonServer::acceptConnection()
+{
+    int fd = accept(listenSocket, NULL, NULL);
+    if (fd < 0) { return; }
+
+    // The permissions of the socket file should already keep other users
+    // out, but some systems ignore them.
+    if (!peerIsCurrentUser(fd))
+    {
+        ::close(fd);
+        return;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    disableSigPipe(fd);
+
+    Connection connection;
+    connection.socket = fd;
+    connection.id = nextConnectionId++;
+    connection.output.assign(daemonMagic, sizeof(daemonMagic));
+    appendUInt(connection.output, daemonVersion, 2);
+    if (writeConnection(connection))
+    {
+        connections.push_back(connection);
+    }
+    else
+    {
+        ::close(fd);
+    }
+}
+
+// Reads whatever the client sent and handles the complete requests in it.
+// Returns false if the connection should be closed.
+bool ProgrammerDaemonServer::readConnection(Connection & connection)
+{
+    char buffer[4096];
+    ssize_t result = recv(connection.socket, buffer, sizeof(buffer), 0);
+    if (result < 0)
+    {
+        return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    if (result == 0) { return false; }
+    connection.input.append(buffer, result);
+    return handleInput(connection);
+}
+
+static void appendResponse(std::string & output, const std::string & response)
+{
+    appendUInt(output, response.size(), 4);
+    output += response;
+}
+
+// Handles the complete requests that were received, stopping if too much
+// output is waiting to be sent or if a request has to wait for an I/O thread.
+// Returns false if the connection should be closed.
+bool ProgrammerDaemonServer::handleInput(Connection & connection)
+{
+    while (!connection.busy && connection.input.size() >= 4 &&
+        connection.output.size() < DAEMON_MAX_PENDING_OUTPUT)
+    {
+        size_t length = MessageReader(connection.input.substr(0, 4)).readUInt(4);
+        if (length > DAEMON_MAX_MESSAGE_SIZE) { return false; }
+        if (connection.input.size() < 4 + length) { break; }
+
+        std::string message = connection.input.substr(4, length);
+        connection.input.erase(0, 4 + length);
+        try
+        {
+            handleRequest(connection, message);
+        }
+        catch (const std::exception &)
+        {
+            // The client is broken or is not one of ours.
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sends as much of the pending output as the socket will take without
+// blocking.  Returns false if the connection should be closed.
+bool ProgrammerDaemonServer::writeConnection(Connection & connection)
+{
+    while (!connection.output.empty())
+    {
+        ssize_t result = send(connection.socket, connection.output.data(),
+            connection.output.size(), MSG_NOSIGNAL);
+        if (result < 0)
+        {
+            if (errno == EINTR) { continue; }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        connection.output.erase(0, result);
+    }
+    return true;
+}
+
+// Handles a request, either right away or by starting an operation on the
+// I/O thread of a programmer.
+void ProgrammerDaemonServer::handleRequest(Connection & connection,
+    const std::string & message)
+{
+    MessageReader reader(message);
+    uint8_t type = reader.readUInt(1);
+    if (type == DAEMON_REQUEST_LIST)
+    {
+        appendResponse(connection.output, handleList());
+        return;
+    }
+
+    std::string serialNumber = reader.readString(1);
+    DeviceOperation operation;
+    switch (type)
+    {
+    case DAEMON_REQUEST_TRANSFER:
+        {
+            uint8_t requestType = reader.readUInt(1);
+            uint8_t request = reader.readUInt(1);
+            uint16_t value = reader.readUInt(2);
+            uint16_t index = reader.readUInt(2);
+            uint16_t length = reader.readUInt(2);
+            bool in = requestType & 0x80;
+
+            std::string data;
+            if (in)
+            {
+                data.assign(length, 0);
+            }
+            else
+            {
+                data = reader.readString(2);
+                length = data.size();
+            }
+
+            bool descriptor = requestType == 0x80 &&
+                request == USB_REQUEST_GET_DESCRIPTOR;
+            uint64_t descriptorKey = (uint64_t)value << 32 |
+                (uint64_t)index << 16 | length;
+
+            operation = [=](ProgrammerHandle &, ProgrammerTransport & transport,
+                DeviceCache & cache) mutable
+            {
+                // Any request that sends data might change the settings.
+                if (!in) { cache.settingsValid = false; }
+
+                size_t transferred = 0;
+                auto cached = cache.descriptors.find(descriptorKey);
+                if (descriptor && cached != cache.descriptors.end())
+                {
+                    data = cached->second;
+                    transferred = data.size();
+                }
+                else
+                {
+                    transport.controlTransfer(requestType, request, value,
+                        index, length ? &data[0] : NULL, length, &transferred);
+
+                    if (descriptor)
+                    {
+                        cache.descriptors[descriptorKey] = data.substr(0, transferred);
+                    }
+                }
+
+                std::string response;
+                appendUInt(response, DAEMON_RESPONSE_OK, 1);
+                if (in)
+                {
+                    appendString(response, data.substr(0, transferred), 2);
+                }
+                else
+                {
+                    appendUInt(response, transferred, 2);
+                }
+                return response;
+            };
+            break;
+        }
+
+    case DAEMON_REQUEST_FIRMWARE_VERSION:
+        operation = [](ProgrammerHandle & handle, ProgrammerTransport &,
+            DeviceCache &)
+        {
+            std::string response;
+            appendUInt(response, DAEMON_RESPONSE_OK, 1);
+            appendString(response, handle.getFirmwareVersionString(), 1);
+            return response;
+        };
+        break;
+
+    case DAEMON_REQUEST_SETTINGS:
+        operation = [](ProgrammerHandle & handle, ProgrammerTransport &,
+            DeviceCache & cache)
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (!cache.settingsValid || now - cache.settingsTime >=
+                std::chrono::milliseconds(DAEMON_SETTINGS_MAX_AGE_MS))
+            {
+                cache.settings = handle.getSettings();
+                cache.settingsTime = now;
+                cache.settingsValid = true;
+            }
+
+            std::string response;
+            appendUInt(response, DAEMON_RESPONSE_OK, 1);
+            appendSettings(response, cache.settings);
+            return response;
+        };
+        break;
+
+    case DAEMON_REQUEST_VARIABLES:
+        operation = [](ProgrammerHandle & handle, ProgrammerTransport &,
+            DeviceCache &)
+        {
+            std::string response;
+            appendUInt(response, DAEMON_RESPONSE_OK, 1);
+            appendVariables(response, handle.getVariables());
+            return response;
+        };
+        break;
+
+    case DAEMON_REQUEST_DIGITAL_READ:
+        operation = [](ProgrammerHandle & handle, ProgrammerTransport &,
+            DeviceCache &)
+        {
+            ProgrammerDigitalReadings readings = handle.digitalRead();
+            std::string response;
+            appendUInt(response, DAEMON_RESPONSE_OK, 1);
+            appendUInt(response, readings.portA, 1);
+            appendUInt(response, readings.portB, 1);
+            appendUInt(response, readings.portC, 1);
+            return response;
+        };
+        break;
+
+    default:
+        throw std::runtime_error("Unknown request.");
+    }
+
+    startOperation(connection, serialNumber, operation);
+}
+
+std::string ProgrammerDaemonServer::handleList()
+{
+    // Without hotplug events, this is how we notice programmers that were
+    // plugged in or unplugged.
+    if (!registry.isEventDriven()) { registry.update(); }
+
+    std::string response;
+    appendUInt(response, DAEMON_RESPONSE_OK, 1);
+    appendUInt(response, devices.size(), 2);
+    for (const auto & pair : devices)
+    {
+        const Device & device = pair.second;
+        appendUInt(response, device.instance.getProductId(), 2);
+        appendUInt(response, device.instance.getFirmwareVersion(), 2);
+        appendString(response, device.instance.getSerialNumber(), 1);
+        appendString(response, device.programmingPortName, 1);
+        appendString(response, device.ttlPortName, 1);
+    }
+    return response;
+}
+
+// Runs an operation on the I/O thread of the programmer with the specified
+// serial number, opening the programmer first if needed.  The connection is
+// busy until the response comes back.
+void ProgrammerDaemonServer::startOperation(Connection & connection,
+    const std::string & serialNumber, DeviceOperation operation)
+{
+    Device * device = findDevice(serialNumber);
+    if (!device && !registry.isEventDriven())
+    {
+        registry.update();
+        device = findDevice(serialNumber);
+    }
+    if (!device)
+    {
+        appendResponse(connection.output, errorResponse(ProgrammerTransportError(
+            "The programmer is not connected.", LIBUSBP_ERROR_DEVICE_DISCONNECTED)));
+        return;
+    }
+
+    if (!device->handle)
+    {
+        try
+        {
+            if (!device->transport)
+            {
+                device->transport = std::make_shared<ProgrammerUsbTransport>(
+                    device->instance.usbInterface);
+            }
+            ProgrammerHandle handle(device->instance, device->transport);
+
+            // The control transfers from clients share the transport with
+            // this handle, so do not let the timeout drop below the default,
+            // which is what those transfers would get without the daemon.
+            ProgrammerRetryPolicy policy;
+            policy.minTimeoutMs = policy.initialTimeoutMs;
+            handle.setRetryPolicy(policy);
+
+            device->handle = std::make_shared<AsyncProgrammerHandle>(handle);
+            device->cache = std::make_shared<DeviceCache>();
+        }
+        catch (const libusbp::error & error)
+        {
+            device->transport.reset();
+            appendResponse(connection.output,
+                errorResponse(ProgrammerTransportError(error.message())));
+            return;
+        }
+        catch (const std::exception & error)
+        {
+            device->transport.reset();
+            appendResponse(connection.output,
+                errorResponse(ProgrammerTransportError(error.what())));
+            return;
+        }
+    }
+
+    std::shared_ptr<ProgrammerTransport> transport = device->transport;
+    std::shared_ptr<DeviceCache> cache = device->cache;
+    std::weak_ptr<AsyncProgrammerHandle> weakHandle = device->handle;
+    uint64_t connectionId = connection.id;
+
+    connection.busy = true;
+    device->handle->run<void>([=](ProgrammerHandle & handle)
+    {
+        Completion completion;
+        completion.connectionId = connectionId;
+        completion.serialNumber = serialNumber;
+        completion.handle = weakHandle;
+        try
+        {
+            completion.response = operation(handle, *transport, *cache);
+        }
+        catch (const ProgrammerTransportError & error)
+        {
+            completion.response = errorResponse(error);
+            completion.disconnected =
+                error.hasCode(LIBUSBP_ERROR_DEVICE_DISCONNECTED);
+        }
+        catch (const std::exception & error)
+        {
+            completion.response = errorResponse(
+                ProgrammerTransportError(error.what()));
+        }
+        finishOperation(std::move(completion));
+    });
+}
+
+// Called on an I/O thread to hand a response to run().
+void ProgrammerDaemonServer::finishOperation(Completion completion)
+{
+    {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        completions.push_back(std::move(completion));
+    }
+
+    // If the pipe is full, run() is going to wake up anyway.
+    char byte = 0;
+    ssize_t result = write(wakePipe[1], &byte, 1);
+    (void)result;
+}
+
+// Queues the responses from the I/O threads to be sent to the clients.
+void ProgrammerDaemonServer::handleCompletions()
+{
+    char buffer[256];
+    while (read(wakePipe[0], buffer, sizeof(buffer)) > 0) { }
+
+    std::vector<Completion> finished;
+    {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        std::swap(finished, completions);
+    }
+
+    for (Completion & completion : finished)
+    {
+        // The client might have disconnected while it was waiting.
+        for (Connection & connection : connections)
+        {
+            if (connection.id == completion.connectionId)
+            {
+                appendResponse(connection.output, completion.response);
+                connection.busy = false;
+            }
+        }
+
+        if (completion.disconnected)
+        {
+            // Open the programmer again when it comes back, unless that
+            // already happened.  Without hotplug events, find out now whether
+            // it is gone.
+            Device * device = findDevice(completion.serialNumber);
+            if (device && device->handle == completion.handle.lock())
+            {
+                device->handle.reset();
+                device->transport.reset();
+                device->cache.reset();
+            }
+            if (!registry.isEventDriven()) { registry.update(); }
+        }
+    }
+}
+
@@ -0,0 +1,283 @@
+#include <programmer_descriptor_cache.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// The first line of the cache file.  Change the number if the format changes,
+// and old files will be ignored.
+#define CACHE_FILE_HEADER "pavr2-descriptor-cache 1"
+
+// Each entry is one line with these fields, separated by tabs.
+#define CACHE_FIELD_COUNT 6
+
+static void makeDirectory(const std::string & path)
+{
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+}
+
+static int getProcessId()
+{
+#ifdef _WIN32
+    return _getpid();
+#else
+    return getpid();
+#endif
+}
+
+// Returns true if the serial port with the specified name might still belong
+// to the USB device with the specified OS ID.
+static bool portMightBelongTo(const std::string & name, const std::string & osId)
+{
+    if (name.empty()) { return true; }
+#ifdef _WIN32
+    // Names like "COM4" are not paths, and checking them would be as slow as
+    // looking them up again.
+    (void)osId;
+    return true;
+#else
+    struct stat st;
+    if (stat(name.c_str(), &st) != 0 || !S_ISCHR(st.st_mode)) { return false; }
+
+#ifdef __linux__
+    // Port names get reused, for example when two programmers are plugged in
+    // again in the opposite order, so check which USB device the port belongs
+    // to.  The OS ID is the path of the device in sysfs, and the device of
+    // the port is one of its interfaces.
+    std::string link = "/sys/class/tty/" + name.substr(name.rfind('/') + 1) +
+        "/device";
+    char * target = realpath(link.c_str(), NULL);
+    if (target == NULL) { return false; }
+    std::string targetPath = target;
+    free(target);
+    return targetPath.compare(0, osId.size() + 1, osId + "/") == 0;
+#else
+    (void)osId;
+    return true;
+#endif
+#endif
+}
+
+// Returns true if the string can be stored in the cache file.
+static bool storable(const std::string & s)
+{
+    return s.find_first_of("\t\r\n") == std::string::npos;
+}
+
+std::string ProgrammerDescriptorCache::getDefaultPath()
+{
+    std::string dir;
+    const char * xdg = getenv("XDG_CACHE_HOME");
+    const char * home = getenv("HOME");
+    const char * localAppData = getenv("LOCALAPPDATA");
+    if (xdg && xdg[0] == '/')
+    {
+        dir = xdg;
+    }
+    else if (home && home[0])
+    {
+        dir = std::string(home) + "/.cache";
+    }
+    else if (localAppData && localAppData[0])
+    {
+        dir = localAppData;
+    }
+    else
+    {
+        return "";
+    }
+    return dir + "/pavr2/descriptors";
+}
+
+ProgrammerDescriptorCache::ProgrammerDescriptorCache(const std::string & path)
+    : path(path)
+{
+    std::ifstream file(path);
+    std::string line;
+    if (!std::getline(file, line) || line != CACHE_FILE_HEADER) { return; }
+
+    while (std::getline(file, line))
+    {
+        std::vector<std::string> fields;
+        std::istringstream lineStream(line);
+        std::string field;
+        while (std::getline(lineStream, field, '\t'))
+        {
+            fields.push_back(field);
+        }
+        if (line.size() && line.back() == '\t') { fields.push_back(""); }
+        if (fields.size() != CACHE_FIELD_COUNT) { continue; }
+
+        Record record;
+        record.serialNumber = fields[0];
+        record.osId = fields[1];
+        record.firmwareVersion = strtoul(fields[2].c_str(), NULL, 16);
+        record.entry.firmwareVersionString = fields[3];
+        record.entry.programmingPortName = fields[4];
+        record.entry.ttlPortName = fields[5];
+        records.push_back(record);
+    }
+}
+
+std::vector<ProgrammerDescriptorCache::Record>::iterator
+ProgrammerDescriptorCache::find(const ProgrammerInstance & instance)
+{
+    std::string osId = instance.getOsId();
+    for (auto it = records.begin(); it != records.end(); ++it)
+    {
+        if (it->osId == osId &&
+            it->serialNumber == instance.getSerialNumber() &&
+            it->firmwareVersion == instance.getFirmwareVersion())
+        {
+            return it;
+        }
+    }
+    return records.end();
+}
+
+bool ProgrammerDescriptorCache::lookup(const ProgrammerInstance & instance,
+    ProgrammerDescriptorCacheEntry & entry)
+{
+    auto it = find(instance);
+    if (it == records.end()) { return false; }
+
+    if (!portMightBelongTo(it->entry.programmingPortName, it->osId) ||
+        !portMightBelongTo(it->entry.ttlPortName, it->osId))
+    {
+        records.erase(it);
+        modified = true;
+        return false;
+    }
+
+    entry = it->entry;
+    return true;
+}
+
+void ProgrammerDescriptorCache::store(const ProgrammerInstance & instance,
+    const ProgrammerDescriptorCacheEntry & entry)
+{
+    Record record;
+    record.serialNumber = instance.getSerialNumber();
+    record.osId = instance.getOsId();
+    record.firmwareVersion = instance.getFirmwareVersion();
+    record.entry = entry;
+
+    if (!storable(record.serialNumber) || !storable(record.osId) ||
+        !storable(entry.firmwareVersionString) ||
+        !storable(entry.programmingPortName) || !storable(entry.ttlPortName))
+    {
+        return;
+    }
+
+    auto it = find(instance);
+    if (it == records.end())
+    {
+        records.push_back(record);
+    }
+    else
+    {
+        *it = record;
+    }
+    modified = true;
+}
+
+void ProgrammerDescriptorCache::prune(
+    const std::vector<ProgrammerInstance> & connected)
+{
+    for (auto it = records.begin(); it != records.end(); )
+    {
+        bool present = false;
+        for (const ProgrammerInstance & instance : connected)
+        {
+            if (instance.getOsId() == it->osId &&
+                instance.getSerialNumber() == it->serialNumber &&
+                instance.getFirmwareVersion() == it->firmwareVersion)
+            {
+                present = true;
+                break;
+            }
+        }
+
+        if (present)
+        {
+            ++it;
+        }
+        else
+        {
+            it = records.erase(it);
+            modified = true;
+        }
+    }
+}
+
+void ProgrammerDescriptorCache::save()
+{
+    if (!modified || path.empty()) { return; }
+
+    // Make the directory and its parent if needed.
+    size_t slash = path.find_last_of("/\\");
+    if (slash != std::string::npos)
+    {
+        std::string dir = path.substr(0, slash);
+        size_t parentSlash = dir.find_last_of("/\\");
+        if (parentSlash != std::string::npos)
+        {
+            makeDirectory(dir.substr(0, parentSlash));
+        }
+        makeDirectory(dir);
+    }
+
+    // Write a temporary file and then rename it, so other processes never see
+    // a partially-written cache.
+    std::string tmpPath = path + "." + std::to_string(getProcessId()) + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::trunc);
+        if (!file) { return; }
+
+        file << CACHE_FILE_HEADER << '\n';
+        for (const Record & record : records)
+        {
+            char version[8];
+            snprintf(version, sizeof(version), "%04x", record.firmwareVersion);
+            file << record.serialNumber << '\t'
+                 << record.osId << '\t'
+                 << version << '\t'
+                 << record.entry.firmwareVersionString << '\t'
+                 << record.entry.programmingPortName << '\t'
+                 << record.entry.ttlPortName << '\n';
+        }
+
+        file.close();
+        if (!file)
+        {
+            std::remove(tmpPath.c_str());
+            return;
+        }
+    }
+
+#ifdef _WIN32
+    // rename does not replace existing files on Windows.
+    std::remove(path.c_str());
+#endif
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmpPath.c_str());
+        return;
+    }
+
+    modified = false;
+}
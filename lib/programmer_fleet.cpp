@@ -0,0 +1,168 @@
+#include <programmer_fleet.h>
+
+#include <algorithm>
+
+// The maximum number of threads a fleet uses if the caller does not say.  The
+// transfers to programmers on the same bus get serialized anyway, so more
+// threads than this would mostly just wait.
+#define FLEET_DEFAULT_MAX_THREADS 16
+
+ProgrammerFleet::ProgrammerFleet(size_t threadCount)
+    : ProgrammerFleet(programmerGetList(), threadCount)
+{
+}
+
+ProgrammerFleet::ProgrammerFleet(
+    const std::vector<ProgrammerInstance> & instances, size_t threadCount)
+    : ProgrammerFleet(instances, nullptr, threadCount)
+{
+}
+
+ProgrammerFleet::ProgrammerFleet(
+    const std::vector<ProgrammerInstance> & instances, Opener opener,
+    size_t threadCount)
+{
+    members.resize(instances.size());
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        members[i].instance = instances[i];
+    }
+
+    if (threadCount == 0)
+    {
+        threadCount = std::min<size_t>(instances.size(), FLEET_DEFAULT_MAX_THREADS);
+    }
+    startThreads(std::max<size_t>(threadCount, 1));
+
+    // Opening a handle involves a few USB requests, so do those in parallel
+    // too.
+    forEach([this, &opener](size_t i)
+    {
+        Member & member = members[i];
+        try
+        {
+            if (opener)
+            {
+                member.handle = opener(member.instance);
+            }
+            else
+            {
+                member.handle = ProgrammerHandle(member.instance);
+            }
+        }
+        catch (const std::exception & e)
+        {
+            member.openError = e.what();
+        }
+        catch (...)
+        {
+            member.openError = "An unknown error occurred.";
+        }
+    });
+}
+
+ProgrammerFleet::~ProgrammerFleet()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (std::thread & thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void ProgrammerFleet::startThreads(size_t threadCount)
+{
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        threads.push_back(std::thread(&ProgrammerFleet::runWorker, this));
+    }
+}
+
+void ProgrammerFleet::runWorker()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        taskReady.wait(lock, [this]
+        {
+            return stopping || (task != nullptr && nextIndex < members.size());
+        });
+        if (stopping) { return; }
+
+        size_t index = nextIndex++;
+        const std::function<void (size_t)> & currentTask = *task;
+
+        lock.unlock();
+        currentTask(index);
+        lock.lock();
+
+        if (--remaining == 0)
+        {
+            taskDone.notify_all();
+        }
+    }
+}
+
+void ProgrammerFleet::forEach(const std::function<void (size_t)> & newTask)
+{
+    if (members.empty()) { return; }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    task = &newTask;
+    nextIndex = 0;
+    remaining = members.size();
+    taskReady.notify_all();
+    taskDone.wait(lock, [this] { return remaining == 0; });
+    task = nullptr;
+}
+
+std::vector<ProgrammerFleetResult<bool>> ProgrammerFleet::getOpenResults() const
+{
+    std::vector<ProgrammerFleetResult<bool>> results(members.size());
+    for (size_t i = 0; i < members.size(); i++)
+    {
+        results[i].serialNumber = members[i].instance.getSerialNumber();
+        results[i].error = members[i].openError;
+        results[i].value = (bool)members[i].handle;
+    }
+    return results;
+}
+
+std::vector<ProgrammerFleetResult<ProgrammerSettings>> ProgrammerFleet::getSettings()
+{
+    return run<ProgrammerSettings>([](ProgrammerHandle & handle)
+    {
+        return handle.getSettings();
+    });
+}
+
+std::vector<ProgrammerFleetResult<bool>> ProgrammerFleet::applySettings(
+    const ProgrammerSettings & settings)
+{
+    return run<bool>([&settings](ProgrammerHandle & handle)
+    {
+        handle.applySettings(settings);
+        return true;
+    });
+}
+
+std::vector<ProgrammerFleetResult<ProgrammerVariables>> ProgrammerFleet::getVariables()
+{
+    return run<ProgrammerVariables>([](ProgrammerHandle & handle)
+    {
+        return handle.getVariables();
+    });
+}
+
+std::vector<ProgrammerFleetResult<ProgrammerRestoreResult>>
+ProgrammerFleet::restoreDefaults(const ProgrammerRestoreOptions & options)
+{
+    return run<ProgrammerRestoreResult>([&options](ProgrammerHandle & handle)
+    {
+        return handle.restoreDefaults(options);
+    });
+}
@@ -0,0 +1,249 @@
+#include <programmer_format.h>
+
+#include <cstdarg>
+#include <cstdio>
+
+namespace
+{
+    // Appends formatted text to a buffer and keeps track of how long the text
+    // would be if the buffer were big enough.
+    class Writer
+    {
+    public:
+        Writer(char * buffer, size_t size) : buffer(buffer), size(size)
+        {
+            if (size) { buffer[0] = 0; }
+        }
+
+        void append(const char * format, ...)
+        {
+            char * end = NULL;
+            size_t room = 0;
+            if (length < size)
+            {
+                end = buffer + length;
+                room = size - length;
+            }
+
+            va_list args;
+            va_start(args, format);
+            int result = vsnprintf(end, room, format, args);
+            va_end(args);
+            if (result > 0) { length += result; }
+        }
+
+        size_t getLength() const
+        {
+            return length;
+        }
+
+    private:
+        char * buffer;
+        size_t size;
+        size_t length = 0;
+    };
+}
+
+// The names of the variables in CSV headers and JSON objects, indexed by
+// variable ID.
+static const char * const variableNames[PAVR2_VARIABLE_IN_PROGRAMMING_MODE + 1] =
+{
+    NULL,
+    "last_device_reset",
+    "programming_error",
+    "target_vcc_measured_min_mv",
+    "target_vcc_measured_max_mv",
+    "programmer_vdd_measured_min_mv",
+    "programmer_vdd_measured_max_mv",
+    "target_vcc_mv",
+    "programmer_vdd_mv",
+    "regulator_level",
+    "in_programming_mode",
+};
+
+static void appendDeviceReset(Writer & writer, uint8_t deviceReset)
+{
+    const char * str = Programmer::convertDeviceResetToCString(deviceReset);
+    if (str)
+    {
+        writer.append("%s", str);
+    }
+    else
+    {
+        writer.append("Unknown code %u.", deviceReset);
+    }
+}
+
+static void appendProgrammingError(Writer & writer, uint8_t programmingError)
+{
+    const char * str =
+        Programmer::convertProgrammingErrorToShortCString(programmingError);
+    if (str)
+    {
+        writer.append("%s", str);
+    }
+    else
+    {
+        writer.append("Unknown code %u.", programmingError);
+    }
+}
+
+static void appendTime(Writer & writer, const ProgrammerSample & sample,
+    std::chrono::steady_clock::time_point startTime)
+{
+    long long us = std::chrono::duration_cast<std::chrono::microseconds>(
+        sample.time - startTime).count();
+    const char * sign = "";
+    if (us < 0)
+    {
+        sign = "-";
+        us = -us;
+    }
+    writer.append("%s%lld.%06lld", sign, us / 1000000, us % 1000000);
+}
+
+// Appends the value of a variable.  Strings are quoted, which is required in
+// JSON and harmless in CSV.
+static void appendVariable(Writer & writer, const ProgrammerVariables & vars,
+    uint8_t id, bool json)
+{
+    switch (id)
+    {
+    case PAVR2_VARIABLE_LAST_DEVICE_RESET:
+        writer.append("\"");
+        appendDeviceReset(writer, vars.lastDeviceReset);
+        writer.append("\"");
+        break;
+
+    case PAVR2_VARIABLE_PROGRAMMING_ERROR:
+        writer.append("\"");
+        appendProgrammingError(writer, vars.programmingError);
+        writer.append("\"");
+        break;
+
+    case PAVR2_VARIABLE_TARGET_VCC_MEASURED_MIN:
+        writer.append("%u", vars.targetVccMeasuredMinMv);
+        break;
+
+    case PAVR2_VARIABLE_TARGET_VCC_MEASURED_MAX:
+        writer.append("%u", vars.targetVccMeasuredMaxMv);
+        break;
+
+    case PAVR2_VARIABLE_PROGRAMMER_VDD_MEASURED_MIN:
+        writer.append("%u", vars.programmerVddMeasuredMinMv);
+        break;
+
+    case PAVR2_VARIABLE_PROGRAMMER_VDD_MEASURED_MAX:
+        writer.append("%u", vars.programmerVddMeasuredMaxMv);
+        break;
+
+    case PAVR2_VARIABLE_TARGET_VCC:
+        writer.append("%u", vars.targetVccMv);
+        break;
+
+    case PAVR2_VARIABLE_PROGRAMMER_VDD:
+        writer.append("%u", vars.programmerVddMv);
+        break;
+
+    case PAVR2_VARIABLE_REGULATOR_LEVEL:
+        writer.append("\"%s\"",
+            Programmer::convertRegulatorLevelToCString(vars.regulatorLevel));
+        break;
+
+    case PAVR2_VARIABLE_IN_PROGRAMMING_MODE:
+        if (json)
+        {
+            writer.append("%s", vars.inProgrammingMode ? "true" : "false");
+        }
+        else
+        {
+            writer.append("%s", vars.inProgrammingMode ? "1" : "0");
+        }
+        break;
+    }
+}
+
+size_t programmerFormatMv(char * buffer, size_t size, uint32_t mv)
+{
+    Writer writer(buffer, size);
+    writer.append("%u mV", mv);
+    return writer.getLength();
+}
+
+size_t programmerFormatDeviceReset(char * buffer, size_t size,
+    uint8_t deviceReset)
+{
+    Writer writer(buffer, size);
+    appendDeviceReset(writer, deviceReset);
+    return writer.getLength();
+}
+
+size_t programmerFormatProgrammingError(char * buffer, size_t size,
+    uint8_t programmingError)
+{
+    Writer writer(buffer, size);
+    appendProgrammingError(writer, programmingError);
+    return writer.getLength();
+}
+
+size_t programmerFormatSampleCsvHeader(char * buffer, size_t size,
+    uint32_t mask)
+{
+    Writer writer(buffer, size);
+    writer.append("time");
+    for (uint8_t id = PAVR2_VARIABLE_LAST_DEVICE_RESET;
+         id <= PAVR2_VARIABLE_IN_PROGRAMMING_MODE; id++)
+    {
+        if (mask & PAVR2_VARIABLE_MASK(id))
+        {
+            writer.append(",%s", variableNames[id]);
+        }
+    }
+    writer.append("\n");
+    return writer.getLength();
+}
+
+size_t programmerFormatSampleCsv(char * buffer, size_t size, uint32_t mask,
+    const ProgrammerSample & sample,
+    std::chrono::steady_clock::time_point startTime)
+{
+    Writer writer(buffer, size);
+    appendTime(writer, sample, startTime);
+    for (uint8_t id = PAVR2_VARIABLE_LAST_DEVICE_RESET;
+         id <= PAVR2_VARIABLE_IN_PROGRAMMING_MODE; id++)
+    {
+        if (!(mask & PAVR2_VARIABLE_MASK(id))) { continue; }
+        writer.append(",");
+        if (!sample.failed && sample.variables.isValid(id))
+        {
+            appendVariable(writer, sample.variables.variables, id, false);
+        }
+    }
+    writer.append("\n");
+    return writer.getLength();
+}
+
+size_t programmerFormatSampleJson(char * buffer, size_t size,
+    const ProgrammerSample & sample,
+    std::chrono::steady_clock::time_point startTime)
+{
+    Writer writer(buffer, size);
+    writer.append("{\"time\":");
+    appendTime(writer, sample, startTime);
+    if (sample.failed)
+    {
+        writer.append(",\"failed\":true");
+    }
+    else
+    {
+        for (uint8_t id = PAVR2_VARIABLE_LAST_DEVICE_RESET;
+             id <= PAVR2_VARIABLE_IN_PROGRAMMING_MODE; id++)
+        {
+            if (!sample.variables.isValid(id)) { continue; }
+            writer.append(",\"%s\":", variableNames[id]);
+            appendVariable(writer, sample.variables.variables, id, true);
+        }
+    }
+    writer.append("}\n");
+    return writer.getLength();
+}
@@ -0,0 +1,404 @@
+#include <programmer_profile.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#define PROFILE_VERSION 1
+#define PROFILE_VERSION_NAME "profile_version"
+
+// The names used in profiles for settings whose values are codes.
+struct ProfileCodeName
+{
+    uint8_t code;
+    const char * name;
+};
+
+static const ProfileCodeName regulatorModeNames[] =
+{
+    { PAVR2_REGULATOR_MODE_AUTO, "auto" },
+    { PAVR2_REGULATOR_MODE_3V3, "3v3" },
+    { PAVR2_REGULATOR_MODE_5V, "5v" },
+};
+
+static const ProfileCodeName vccOutputIndicatorNames[] =
+{
+    { PAVR2_VCC_OUTPUT_INDICATOR_BLINKING, "blinking" },
+    { PAVR2_VCC_OUTPUT_INDICATOR_STEADY, "steady" },
+};
+
+static const ProfileCodeName lineFunctionNames[] =
+{
+    { PAVR2_LINE_IS_NOTHING, "none" },
+    { PAVR2_LINE_IS_CD, "cd" },
+    { PAVR2_LINE_IS_DSR, "dsr" },
+    { PAVR2_LINE_IS_DTR, "dtr" },
+    { PAVR2_LINE_IS_RTS, "rts" },
+    { PAVR2_LINE_IS_CLOCK, "clock" },
+    { PAVR2_LINE_IS_DTR_RESET, "dtr-reset" },
+};
+
+template <size_t N>
+static std::string codeToName(const ProfileCodeName (&names)[N], uint8_t code)
+{
+    for (const ProfileCodeName & name : names)
+    {
+        if (name.code == code) { return name.name; }
+    }
+    return std::to_string(code);
+}
+
+template <size_t N>
+static uint8_t nameToCode(const ProfileCodeName (&names)[N],
+    const std::string & value)
+{
+    std::string expected;
+    for (const ProfileCodeName & name : names)
+    {
+        if (value == name.name) { return name.code; }
+        if (expected.size()) { expected += ", "; }
+        expected += name.name;
+    }
+    throw std::runtime_error("Invalid value '" + value + "'.  Expected one of: " +
+        expected + ".");
+}
+
+static uint32_t parseNumber(const std::string & value)
+{
+    // Base 0 allows hex numbers like 0x0F, which is how the STK500 versions
+    // are usually written.
+    const char * str = value.c_str();
+    char * end;
+    errno = 0;
+    unsigned long long number = std::strtoull(str, &end, 0);
+    if (value.empty() || !isdigit((unsigned char)value[0]) || *end != 0 ||
+        errno == ERANGE || number > 0xFFFFFFFF)
+    {
+        throw std::runtime_error("Invalid number '" + value + "'.");
+    }
+    return number;
+}
+
+static std::string formatHex(uint32_t number)
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "0x%02X", number);
+    return buffer;
+}
+
+static bool parseBool(const std::string & value)
+{
+    if (value == "true") { return true; }
+    if (value == "false") { return false; }
+    throw std::runtime_error("Invalid value '" + value +
+        "'.  Expected true or false.");
+}
+
+// Describes how to read and write one setting in a profile.  The setter
+// throws an exception if the value is invalid.
+struct ProfileField
+{
+    const char * name;
+    std::string (*get)(const ProgrammerSettings &);
+    void (*set)(ProgrammerSettings &, const std::string &);
+};
+
+// The settings in the order they are written and applied.  The maximum
+// frequency must be applied before the frequency because both can change
+// ISP_FASTEST_PERIOD, and the frequency matters more.
+//
+// Several raw values can have the same frequency name, and setting a frequency
+// by name picks one of them, so the frequencies are left alone (but still
+// checked) if they already have the name in the profile.  This makes exporting
+// a profile and importing it again change nothing.
+// [all-settings]
+static const ProfileField profileFields[] =
+{
+    {
+        "max_isp_frequency_khz",
+        [](const ProgrammerSettings & s)
+        {
+            return Programmer::getMaxFrequencyName(s.ispFastestPeriod);
+        },
+        [](ProgrammerSettings & s, const std::string & v)
+        {
+            ProgrammerSettings changed = s;
+            Programmer::setMaxFrequency(changed, v);
+            if (Programmer::getMaxFrequencyName(s.ispFastestPeriod) != v)
+            {
+                s = changed;
+            }
+        },
+    },
+    {
+        "isp_frequency_khz",
+        [](const ProgrammerSettings & s)
+        {
+            return Programmer::getFrequencyName(s.sckDuration, s.ispFastestPeriod);
+        },
+        [](ProgrammerSettings & s, const std::string & v)
+        {
+            ProgrammerSettings changed = s;
+            Programmer::setFrequency(changed, v);
+            if (Programmer::getFrequencyName(s.sckDuration, s.ispFastestPeriod) != v)
+            {
+                s = changed;
+            }
+        },
+    },
+    {
+        "regulator_mode",
+        [](const ProgrammerSettings & s)
+        {
+            return codeToName(regulatorModeNames, s.regulatorMode);
+        },
+        [](ProgrammerSettings & s, const std::string & v)
+        {
+            s.regulatorMode = nameToCode(regulatorModeNames, v);
+        },
+    },
+    {
+        "vcc_output_enabled",
+        [](const ProgrammerSettings & s)
+        {
+            return std::string(s.vccOutputEnabled ? "true" : "false");
+        },
+        [](ProgrammerSettings & s, const std::string & v)
+        {
+            s.vccOutputEnabled = parseBool(v);
+        },
+    },
+    {
+        "vcc_output_indicator",
+        [](const ProgrammerSettings & s)
+        {
+            return codeToName(vccOutputIndicatorNames, s.vccOutputIndicator);
+        },
+        [](ProgrammerSettings & s, const std::string & v)
+        {
+            s.vccOutputIndicator = nameToCode(vccOutputIndicatorNames, v);
+        },
+    },
+    {
+        "line_a_function",
+        [](const ProgrammerSettings & s)
+        {
+            return codeToName(lineFunctionNames, s.lineAFunction);
+        },
+        [](ProgrammerSettings & s, const std::string & v)
+        {
+            s.lineAFunction = nameToCode(lineFunctionNames, v);
+        },
+    },
+    {
+        "line_b_function",
+        [](const ProgrammerSettings & s)
+        {
+            return codeToName(lineFunctionNames, s.lineBFunction);
+        },
+        [](ProgrammerSettings & s, const std::string & v)
+        {
+            s.lineBFunction = nameToCode(lineFunctionNames, v);
+        },
+    },
+    {
+        "vcc_vdd_max_range_mv",
+        [](const ProgrammerSettings & s) { return std::to_string(s.vccVddMaxRange); },
+        [](ProgrammerSettings & s, const std::string & v) { s.vccVddMaxRange = parseNumber(v); },
+    },
+    {
+        "vcc_3v3_min_mv",
+        [](const ProgrammerSettings & s) { return std::to_string(s.vcc3v3Min); },
+        [](ProgrammerSettings & s, const std::string & v) { s.vcc3v3Min = parseNumber(v); },
+    },
+    {
+        "vcc_3v3_max_mv",
+        [](const ProgrammerSettings & s) { return std::to_string(s.vcc3v3Max); },
+        [](ProgrammerSettings & s, const std::string & v) { s.vcc3v3Max = parseNumber(v); },
+    },
+    {
+        "vcc_5v_min_mv",
+        [](const ProgrammerSettings & s) { return std::to_string(s.vcc5vMin); },
+        [](ProgrammerSettings & s, const std::string & v) { s.vcc5vMin = parseNumber(v); },
+    },
+    {
+        "vcc_5v_max_mv",
+        [](const ProgrammerSettings & s) { return std::to_string(s.vcc5vMax); },
+        [](ProgrammerSettings & s, const std::string & v) { s.vcc5vMax = parseNumber(v); },
+    },
+    {
+        "stk500_hardware_version",
+        [](const ProgrammerSettings & s) { return formatHex(s.hardwareVersion); },
+        [](ProgrammerSettings & s, const std::string & v) { s.hardwareVersion = parseNumber(v); },
+    },
+    {
+        "stk500_software_version_major",
+        [](const ProgrammerSettings & s) { return formatHex(s.softwareVersionMajor); },
+        [](ProgrammerSettings & s, const std::string & v) { s.softwareVersionMajor = parseNumber(v); },
+    },
+    {
+        "stk500_software_version_minor",
+        [](const ProgrammerSettings & s) { return formatHex(s.softwareVersionMinor); },
+        [](ProgrammerSettings & s, const std::string & v) { s.softwareVersionMinor = parseNumber(v); },
+    },
+};
+
+static const ProfileField * findField(const std::string & name)
+{
+    for (const ProfileField & field : profileFields)
+    {
+        if (name == field.name) { return &field; }
+    }
+    return NULL;
+}
+
+static std::string trim(const std::string & str)
+{
+    size_t start = str.find_first_not_of(" \t\r");
+    if (start == std::string::npos) { return ""; }
+    size_t end = str.find_last_not_of(" \t\r");
+    return str.substr(start, end - start + 1);
+}
+
+ProgrammerSettingsProfile::ProgrammerSettingsProfile()
+{
+}
+
+ProgrammerSettingsProfile::ProgrammerSettingsProfile(
+    const ProgrammerSettings & settings)
+{
+    for (const ProfileField & field : profileFields)
+    {
+        values[field.name] = field.get(settings);
+    }
+}
+
+ProgrammerSettingsProfile ProgrammerSettingsProfile::parse(
+    const std::string & text)
+{
+    ProgrammerSettingsProfile profile;
+    bool versionFound = false;
+
+    std::istringstream lines(text);
+    std::string line;
+    for (unsigned int lineNumber = 1; std::getline(lines, line); lineNumber++)
+    {
+        std::string prefix = "Line " + std::to_string(lineNumber) + " of the profile: ";
+
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) { continue; }
+
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+        {
+            throw std::runtime_error(prefix + "Expected 'name: value'.");
+        }
+        std::string name = trim(line.substr(0, colon));
+        std::string value = trim(line.substr(colon + 1));
+
+        if (name == PROFILE_VERSION_NAME)
+        {
+            if (versionFound)
+            {
+                throw std::runtime_error(prefix + "The version is specified twice.");
+            }
+            if (value != std::to_string(PROFILE_VERSION))
+            {
+                throw std::runtime_error(prefix + "Unsupported profile version '" +
+                    value + "'.  This software supports version " +
+                    std::to_string(PROFILE_VERSION) + ".");
+            }
+            versionFound = true;
+            continue;
+        }
+
+        if (!versionFound)
+        {
+            throw std::runtime_error(prefix +
+                "Expected '" PROFILE_VERSION_NAME ": " +
+                std::to_string(PROFILE_VERSION) + "' before the settings.");
+        }
+
+        const ProfileField * field = findField(name);
+        if (field == NULL)
+        {
+            throw std::runtime_error(prefix + "Unknown setting '" + name + "'.");
+        }
+        if (profile.values.count(name))
+        {
+            throw std::runtime_error(prefix + "The setting '" + name +
+                "' is specified twice.");
+        }
+
+        // Check the value now so that applying the profile cannot fail.
+        try
+        {
+            ProgrammerSettings settings;
+            field->set(settings, value);
+        }
+        catch (const std::exception & error)
+        {
+            throw std::runtime_error(prefix + error.what());
+        }
+        profile.values[name] = value;
+    }
+
+    if (!versionFound)
+    {
+        throw std::runtime_error("The profile is empty.");
+    }
+    return profile;
+}
+
+ProgrammerSettingsProfile ProgrammerSettingsProfile::load(
+    const std::string & fileName)
+{
+    std::ifstream file(fileName);
+    if (!file)
+    {
+        throw std::runtime_error(
+            "Failed to open profile '" + fileName + "' for reading.");
+    }
+    std::string text((std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>());
+    return parse(text);
+}
+
+std::string ProgrammerSettingsProfile::toString() const
+{
+    std::string text = "# Pololu USB AVR Programmer v2 settings profile\n";
+    text += PROFILE_VERSION_NAME ": " + std::to_string(PROFILE_VERSION) + "\n";
+    for (const ProfileField & field : profileFields)
+    {
+        auto it = values.find(field.name);
+        if (it == values.end()) { continue; }
+        text += std::string(field.name) + ": " + it->second + "\n";
+    }
+    return text;
+}
+
+void ProgrammerSettingsProfile::save(const std::string & fileName) const
+{
+    std::ofstream file(fileName, std::ios::trunc);
+    file << toString();
+    file.close();
+    if (!file)
+    {
+        throw std::runtime_error(
+            "Failed to write profile '" + fileName + "'.");
+    }
+}
+
+void ProgrammerSettingsProfile::applyTo(ProgrammerSettings & settings) const
+{
+    for (const ProfileField & field : profileFields)
+    {
+        auto it = values.find(field.name);
+        if (it == values.end()) { continue; }
+        field.set(settings, it->second);
+    }
+}
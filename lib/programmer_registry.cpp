@@ -0,0 +1,217 @@
+#include <programmer_registry.h>
+
+#include <cstdlib>
+
+#ifdef __linux__
+#include <cerrno>
+#include <unistd.h>
+#include <libudev.h>
+#endif
+
+ProgrammerRegistry::ProgrammerRegistry()
+{
+    openMonitor();
+    rescan();
+}
+
+ProgrammerRegistry::~ProgrammerRegistry()
+{
+    closeMonitor();
+}
+
+void ProgrammerRegistry::onAdded(Callback callback)
+{
+    addedCallback = callback;
+}
+
+void ProgrammerRegistry::onRemoved(Callback callback)
+{
+    removedCallback = callback;
+}
+
+void ProgrammerRegistry::rescan()
+{
+    std::vector<ProgrammerInstance> newList = programmerGetList();
+    std::vector<ProgrammerInstance> oldList = list;
+    list = newList;
+
+    for (const ProgrammerInstance & oldInstance : oldList)
+    {
+        std::string id = oldInstance.getOsId();
+        bool present = false;
+        for (const ProgrammerInstance & instance : newList)
+        {
+            if (instance.getOsId() == id) { present = true; break; }
+        }
+        if (!present && removedCallback) { removedCallback(oldInstance); }
+    }
+
+    for (const ProgrammerInstance & instance : newList)
+    {
+        std::string id = instance.getOsId();
+        bool present = false;
+        for (const ProgrammerInstance & oldInstance : oldList)
+        {
+            if (oldInstance.getOsId() == id) { present = true; break; }
+        }
+        if (!present && addedCallback) { addedCallback(instance); }
+    }
+}
+
+void ProgrammerRegistry::remove(const std::string & osId)
+{
+    for (auto it = list.begin(); it != list.end(); ++it)
+    {
+        if (it->getOsId() == osId)
+        {
+            ProgrammerInstance instance = *it;
+            list.erase(it);
+            programmerForgetPortNames(osId);
+            if (removedCallback) { removedCallback(instance); }
+            return;
+        }
+    }
+}
+
+#ifdef __linux__
+
+void ProgrammerRegistry::openMonitor()
+{
+    // If udev is not running, nobody would send us events.
+    if (access("/run/udev/control", F_OK) != 0) { return; }
+
+    udev = udev_new();
+    if (udev == NULL) { return; }
+
+    // Listen to the events that udev has finished processing instead of the
+    // raw kernel events so that the device nodes and permissions are already
+    // set up when we hear about a device.  The monitor's socket is
+    // non-blocking, and it only accepts events sent by udev.
+    monitor = udev_monitor_new_from_netlink(udev, "udev");
+    if (monitor == NULL ||
+        udev_monitor_filter_add_match_subsystem_devtype(monitor, "usb", NULL) < 0 ||
+        udev_monitor_enable_receiving(monitor) < 0)
+    {
+        closeMonitor();
+    }
+}
+
+void ProgrammerRegistry::closeMonitor()
+{
+    if (monitor != NULL)
+    {
+        udev_monitor_unref(monitor);
+        monitor = NULL;
+    }
+    if (udev != NULL)
+    {
+        udev_unref(udev);
+        udev = NULL;
+    }
+}
+
+void ProgrammerRegistry::update()
+{
+    if (monitor == NULL)
+    {
+        rescan();
+        return;
+    }
+
+    bool needRescan = false;
+    while (true)
+    {
+        errno = 0;
+        struct udev_device * device = udev_monitor_receive_device(monitor);
+        if (device == NULL)
+        {
+            if (errno == EINTR) { continue; }
+            if (errno == ENOBUFS)
+            {
+                // Events were lost because we did not read them fast enough,
+                // so our list might be stale.
+                needRescan = true;
+                continue;
+            }
+            break;
+        }
+
+        if (handleEvent(device))
+        {
+            needRescan = true;
+        }
+        udev_device_unref(device);
+    }
+
+    if (needRescan)
+    {
+        rescan();
+    }
+}
+
+// Returns the value of a property of the device, or an empty string if it
+// does not have that property.
+static std::string getProperty(struct udev_device * device, const char * name)
+{
+    const char * value = udev_device_get_property_value(device, name);
+    return value ? value : "";
+}
+
+// Handles one hotplug event.  Returns true if the USB devices need to be
+// scanned again.
+bool ProgrammerRegistry::handleEvent(struct udev_device * device)
+{
+    const char * actionPtr = udev_device_get_action(device);
+    const char * syspath = udev_device_get_syspath(device);
+    if (actionPtr == NULL || syspath == NULL) { return false; }
+    std::string action = actionPtr;
+    std::string devtype = getProperty(device, "DEVTYPE");
+
+    if (action == "remove")
+    {
+        // The OS ID of a device from libusbp is its path in sysfs, so we can
+        // drop it from the list without scanning anything.  Removal of the
+        // device's interfaces can be ignored because the device itself gets
+        // removed too.
+        if (devtype == "usb_device")
+        {
+            remove(syspath);
+        }
+        return false;
+    }
+
+    if (action == "add" || action == "bind")
+    {
+        // PRODUCT looks like "1ffb/3c0/107", in hex.  We get an event for the
+        // device and then one for each of its interfaces, so if the interface
+        // we need was not ready when the device was added, a later event will
+        // make us look again.
+        std::string product = getProperty(device, "PRODUCT");
+        uint32_t vendorId = strtoul(product.c_str(), NULL, 16);
+        return vendorId == PAVR2_USB_VENDOR_ID;
+    }
+
+    return false;
+}
+
+#else
+
+void ProgrammerRegistry::openMonitor()
+{
+}
+
+void ProgrammerRegistry::closeMonitor()
+{
+}
+
+void ProgrammerRegistry::update()
+{
+    rescan();
+}
+
+bool ProgrammerRegistry::handleEvent(struct udev_device *)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,181 @@
+#include <programmer_resilient.h>
+
+#include <thread>
+
+// Returns true if the error means that the connection to the programmer might
+// have been lost.  A STALL means the programmer is there but rejected the
+// request, and a transport that has no response for a request will not get
+// one after reconnecting either, so reconnecting would not help.
+static bool mightBeDisconnected(const ProgrammerTransportError & error)
+{
+    return !error.hasCode(LIBUSBP_ERROR_STALL) &&
+        !error.hasCode(PROGRAMMER_TRANSPORT_ERROR_NO_RESPONSE);
+}
+
+ResilientProgrammerHandle::ResilientProgrammerHandle(
+    const ProgrammerHandle & handle, const ProgrammerReconnectOptions & options)
+    : handle(handle),
+      serialNumber(handle.getInstance().getSerialNumber()),
+      options(options),
+      retryPolicy(handle.getRetryPolicy())
+{
+    if (!this->options.open)
+    {
+        this->options.open = [](const std::string & serialNumber)
+        {
+            ProgrammerInstance instance = programmerFindBySerial(serialNumber);
+            if (!instance) { return ProgrammerHandle(); }
+            return ProgrammerHandle(instance);
+        };
+    }
+}
+
+void ResilientProgrammerHandle::onReconnect(std::function<void ()> callback)
+{
+    reconnectCallback = callback;
+}
+
+void ResilientProgrammerHandle::runWithRecovery(
+    const std::function<void (ProgrammerHandle &)> & operation)
+{
+    bool recovering = false;
+    std::chrono::steady_clock::time_point deadline;
+    while (true)
+    {
+        try
+        {
+            if (!handle)
+            {
+                throw ProgrammerTransportError(
+                    "The programmer is not connected.",
+                    LIBUSBP_ERROR_DEVICE_DISCONNECTED);
+            }
+            operation(handle);
+            return;
+        }
+        catch (const ProgrammerTransportError & error)
+        {
+            if (!mightBeDisconnected(error)) { throw; }
+
+            auto now = std::chrono::steady_clock::now();
+            if (!recovering)
+            {
+                recovering = true;
+                deadline = now + std::chrono::milliseconds(options.timeoutMs);
+            }
+            if (now >= deadline) { throw; }
+
+            // Release the old device so the OS can give it back to us when it
+            // re-enumerates.
+            handle.close();
+            reconnect(deadline);
+            if (!handle) { throw; }
+        }
+    }
+}
+
+// Waits for the programmer to come back and opens it, giving up at the
+// deadline.
+void ResilientProgrammerHandle::reconnect(
+    std::chrono::steady_clock::time_point deadline)
+{
+    while (!tryReconnect())
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) { return; }
+
+        auto delay = std::chrono::milliseconds(options.pollIntervalMs);
+        if (delay > deadline - now)
+        {
+            std::this_thread::sleep_until(deadline);
+        }
+        else
+        {
+            std::this_thread::sleep_for(delay);
+        }
+    }
+}
+
+bool ResilientProgrammerHandle::tryReconnect()
+{
+    ProgrammerHandle newHandle;
+    try
+    {
+        newHandle = options.open(serialNumber);
+        if (!newHandle) { return false; }
+
+        newHandle.setRetryPolicy(retryPolicy);
+        if (options.restoreSettings && hasLastSettings)
+        {
+            // Reading the settings first means that only the ones that
+            // actually changed get written.
+            newHandle.getSettings();
+            newHandle.applySettings(lastSettings);
+        }
+    }
+    catch (const std::exception &)
+    {
+        // The programmer is probably still enumerating.
+        return false;
+    }
+
+    handle = newHandle;
+    reconnectCount++;
+    if (reconnectCallback) { reconnectCallback(); }
+    return true;
+}
+
+ProgrammerSettings ResilientProgrammerHandle::getSettings()
+{
+    return run<ProgrammerSettings>([](ProgrammerHandle & h)
+    {
+        return h.getSettings();
+    });
+}
+
+void ResilientProgrammerHandle::applySettings(const ProgrammerSettings & settings)
+{
+    runWithRecovery([&](ProgrammerHandle & h)
+    {
+        h.applySettings(settings);
+    });
+    lastSettings = settings;
+    hasLastSettings = true;
+}
+
+ProgrammerRestoreResult ResilientProgrammerHandle::restoreDefaults(
+    const ProgrammerRestoreOptions & restoreOptions)
+{
+    ProgrammerRestoreResult result = run<ProgrammerRestoreResult>(
+        [&](ProgrammerHandle & h)
+        {
+            return h.restoreDefaults(restoreOptions);
+        });
+    lastSettings = result.settings;
+    hasLastSettings = true;
+    return result;
+}
+
+ProgrammerVariables ResilientProgrammerHandle::getVariables()
+{
+    return run<ProgrammerVariables>([](ProgrammerHandle & h)
+    {
+        return h.getVariables();
+    });
+}
+
+ProgrammerPartialVariables ResilientProgrammerHandle::getVariables(uint32_t mask)
+{
+    return run<ProgrammerPartialVariables>([mask](ProgrammerHandle & h)
+    {
+        return h.getVariables(mask);
+    });
+}
+
+ProgrammerDigitalReadings ResilientProgrammerHandle::digitalRead()
+{
+    return run<ProgrammerDigitalReadings>([](ProgrammerHandle & h)
+    {
+        return h.digitalRead();
+    });
+}
@@ -0,0 +1,97 @@
+#include <programmer_sampler.h>
+
+ProgrammerSampler::ProgrammerSampler(const ProgrammerHandle & handle,
+    uint32_t mask, std::chrono::microseconds interval, size_t capacity)
+    : handle(handle), mask(mask), interval(interval),
+      buffer(capacity + 1), writeIndex(0), readIndex(0), droppedCount(0)
+{
+}
+
+ProgrammerSampler::~ProgrammerSampler()
+{
+    stop();
+}
+
+void ProgrammerSampler::start()
+{
+    if (thread.joinable()) { return; }
+
+    stopRequested = false;
+    thread = std::thread(&ProgrammerSampler::run, this);
+}
+
+void ProgrammerSampler::stop()
+{
+    if (!thread.joinable()) { return; }
+
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopRequested = true;
+    }
+    stopCondition.notify_all();
+    thread.join();
+}
+
+void ProgrammerSampler::run()
+{
+    auto nextTime = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+        ProgrammerSample sample;
+        sample.time = std::chrono::steady_clock::now();
+        try
+        {
+            sample.variables = handle.getVariables(mask);
+        }
+        catch (const std::exception &)
+        {
+            sample.failed = true;
+        }
+        push(sample);
+
+        // If reading took longer than the interval, skip the samples we
+        // missed instead of trying to catch up.
+        nextTime += interval;
+        auto now = std::chrono::steady_clock::now();
+        if (nextTime < now) { nextTime = now; }
+
+        std::unique_lock<std::mutex> lock(stopMutex);
+        if (stopCondition.wait_until(lock, nextTime, [this] { return stopRequested; }))
+        {
+            return;
+        }
+    }
+}
+
+void ProgrammerSampler::push(const ProgrammerSample & sample)
+{
+    size_t write = writeIndex.load(std::memory_order_relaxed);
+    size_t next = (write + 1) % buffer.size();
+    if (next == readIndex.load(std::memory_order_acquire))
+    {
+        droppedCount++;
+        return;
+    }
+
+    buffer[write] = sample;
+    writeIndex.store(next, std::memory_order_release);
+}
+
+bool ProgrammerSampler::pop(ProgrammerSample & sample)
+{
+    size_t read = readIndex.load(std::memory_order_relaxed);
+    if (read == writeIndex.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    sample = buffer[read];
+    readIndex.store((read + 1) % buffer.size(), std::memory_order_release);
+    return true;
+}
+
+uint64_t ProgrammerSampler::getDroppedCount() const
+{
+    return droppedCount;
+}
@@ -0,0 +1,273 @@
+#include <programmer_simulator.h>
+
+#include <cassert>
+#include <cstring>
+#include <thread>
+
+// A setup packet bRequest value from USB 2.0 Table 9-4
+#define USB_REQUEST_GET_DESCRIPTOR 6
+
+// A descriptor type from USB 2.0 Table 9-5
+#define USB_DESCRIPTOR_TYPE_STRING 3
+
+// The index of the string descriptor that holds the firmware modification
+// string.
+#define FIRMWARE_MODIFICATION_STRING_INDEX 6
+
+// The default firmware version reported by the simulated device, in BCD.
+#define SIMULATED_FIRMWARE_VERSION 0x0107
+
+ProgrammerSimulator::ProgrammerSimulator(std::string serialNumber)
+    : serialNumber(serialNumber),
+      latency(0),
+      timeout(0),
+      restoreDefaultsTime(std::chrono::milliseconds(20))
+{
+    restoreDefaultSettings();
+
+    memset(variables, 0, sizeof(variables));
+    variables[PAVR2_VARIABLE_LAST_DEVICE_RESET] = PAVR2_RESET_POWER_UP;
+    variables[PAVR2_VARIABLE_TARGET_VCC_MEASURED_MIN] = 0xFF;
+    variables[PAVR2_VARIABLE_PROGRAMMER_VDD_MEASURED_MIN] = 0xFF;
+    variables[PAVR2_VARIABLE_TARGET_VCC] = 5000 / PAVR2_VOLTAGE_UNITS;
+    variables[PAVR2_VARIABLE_PROGRAMMER_VDD] = 5000 / PAVR2_VOLTAGE_UNITS;
+    variables[PAVR2_VARIABLE_REGULATOR_LEVEL] = PAVR2_REGULATOR_LEVEL_5V;
+
+    digitalReadings.portA = 0;
+    digitalReadings.portB = 0;
+    digitalReadings.portC = 0;
+}
+
+ProgrammerInstance ProgrammerSimulator::getInstance() const
+{
+    return ProgrammerInstance(libusbp::device(), libusbp::generic_interface(),
+        PAVR2_USB_PRODUCT_ID_V2, serialNumber, SIMULATED_FIRMWARE_VERSION);
+}
+
+// [all-settings]
+void ProgrammerSimulator::restoreDefaultSettings()
+{
+    memset(settings, 0, sizeof(settings));
+    settings[PAVR2_SETTING_SCK_DURATION] = 2;  // 114 kHz
+    settings[PAVR2_SETTING_ISP_FASTEST_PERIOD] = 7;  // 1714 kHz
+    settings[PAVR2_SETTING_REGULATOR_MODE] = PAVR2_REGULATOR_MODE_AUTO;
+    settings[PAVR2_SETTING_VCC_OUTPUT_ENABLED] = 0;
+    settings[PAVR2_SETTING_VCC_OUTPUT_INDICATOR] = PAVR2_VCC_OUTPUT_INDICATOR_BLINKING;
+    settings[PAVR2_SETTING_LINE_A_FUNCTION] = PAVR2_LINE_IS_NOTHING;
+    settings[PAVR2_SETTING_LINE_B_FUNCTION] = PAVR2_LINE_IS_NOTHING;
+    settings[PAVR2_SETTING_SOFTWARE_VERSION_MAJOR] = 0x02;
+    settings[PAVR2_SETTING_SOFTWARE_VERSION_MINOR] = 0x0A;
+    settings[PAVR2_SETTING_HARDWARE_VERSION] = 0x0F;
+    settings[PAVR2_SETTING_VCC_VDD_MAX_RANGE] = 896 / PAVR2_VOLTAGE_UNITS;
+    settings[PAVR2_SETTING_VCC_3V3_MIN] = 2720 / PAVR2_VOLTAGE_UNITS;
+    settings[PAVR2_SETTING_VCC_3V3_MAX] = 3872 / PAVR2_VOLTAGE_UNITS;
+    settings[PAVR2_SETTING_VCC_5V_MIN] = 4128 / PAVR2_VOLTAGE_UNITS;
+    settings[PAVR2_SETTING_VCC_5V_MAX] = 5856 / PAVR2_VOLTAGE_UNITS;
+}
+
+void ProgrammerSimulator::controlTransfer(uint8_t requestType,
+    uint8_t request, uint16_t value, uint16_t index,
+    void * buffer, uint16_t length, size_t * transferred)
+{
+    if (transferred) { *transferred = 0; }
+
+    std::chrono::microseconds latency;
+    std::chrono::microseconds timeout;
+    bool injectFailure = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        transferCount++;
+        if (disconnected)
+        {
+            throw ProgrammerTransportError("The simulated device was disconnected.",
+                LIBUSBP_ERROR_DEVICE_DISCONNECTED);
+        }
+        latency = this->latency;
+        timeout = this->timeout;
+        if (pendingFailures)
+        {
+            pendingFailures--;
+            injectFailure = true;
+        }
+    }
+
+    // Sleep without holding the lock so that transfers from different threads
+    // overlap each other.
+    if (timeout.count() > 0 && latency > timeout)
+    {
+        std::this_thread::sleep_for(timeout);
+        throw ProgrammerTransportError("The simulated transfer timed out.",
+            LIBUSBP_ERROR_TIMEOUT);
+    }
+    if (latency.count() > 0)
+    {
+        std::this_thread::sleep_for(latency);
+    }
+
+    if (injectFailure)
+    {
+        throw ProgrammerTransportError("A simulated transient failure occurred.",
+            LIBUSBP_ERROR_TIMEOUT);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    uint8_t * bytes = (uint8_t *)buffer;
+
+    if (requestType == 0xC0 && request == PAVR2_REQUEST_GET_SETTING)
+    {
+        handleGetSetting(index, bytes, length, transferred);
+    }
+    else if (requestType == 0x40 && request == PAVR2_REQUEST_SET_SETTING)
+    {
+        handleSetSetting(value, index);
+    }
+    else if (requestType == 0xC0 && request == PAVR2_REQUEST_GET_VARIABLE)
+    {
+        if (index == 0 || index > PAVR2_VARIABLE_IN_PROGRAMMING_MODE)
+        {
+            throw ProgrammerTransportError("The simulated programmer stalled "
+                "a request for an invalid variable.", LIBUSBP_ERROR_STALL);
+        }
+        if (length >= 1)
+        {
+            bytes[0] = variables[index];
+            if (transferred) { *transferred = 1; }
+        }
+    }
+    else if (requestType == 0xC0 && request == PAVR2_REQUEST_DIGITAL_READ)
+    {
+        uint8_t readings[3] = {
+            digitalReadings.portA, digitalReadings.portB, digitalReadings.portC };
+        size_t size = length < sizeof(readings) ? length : sizeof(readings);
+        memcpy(bytes, readings, size);
+        if (transferred) { *transferred = size; }
+    }
+    else if (requestType == 0x80 && request == USB_REQUEST_GET_DESCRIPTOR &&
+        value == ((USB_DESCRIPTOR_TYPE_STRING << 8) | FIRMWARE_MODIFICATION_STRING_INDEX))
+    {
+        // A string descriptor holding "-", which means the firmware has no
+        // modifications.
+        uint8_t descriptor[4] = { 4, USB_DESCRIPTOR_TYPE_STRING, '-', 0 };
+        size_t size = length < sizeof(descriptor) ? length : sizeof(descriptor);
+        memcpy(bytes, descriptor, size);
+        if (transferred) { *transferred = size; }
+    }
+    else
+    {
+        throw ProgrammerTransportError("The simulated programmer stalled "
+            "an unsupported request.", LIBUSBP_ERROR_STALL);
+    }
+}
+
+void ProgrammerSimulator::handleGetSetting(uint16_t index,
+    uint8_t * buffer, uint16_t length, size_t * transferred)
+{
+    if (index > PAVR2_SETTING_VCC_5V_MAX)
+    {
+        throw ProgrammerTransportError("The simulated programmer stalled "
+            "a request for an invalid setting.", LIBUSBP_ERROR_STALL);
+    }
+
+    // The firmware finishes restoring its default settings some time after
+    // it was asked to, and then clears NOT_INITIALIZED.
+    if (settings[PAVR2_SETTING_NOT_INITIALIZED] &&
+        std::chrono::steady_clock::now() >= restoreDefaultsDoneTime)
+    {
+        restoreDefaultSettings();
+    }
+
+    if (length >= 1)
+    {
+        buffer[0] = settings[index];
+        if (transferred) { *transferred = 1; }
+    }
+}
+
+void ProgrammerSimulator::handleSetSetting(uint16_t value, uint16_t index)
+{
+    if (index > PAVR2_SETTING_VCC_5V_MAX || value > 0xFF)
+    {
+        throw ProgrammerTransportError("The simulated programmer stalled "
+            "a request to set an invalid setting.", LIBUSBP_ERROR_STALL);
+    }
+
+    settings[index] = value;
+
+    if (index == PAVR2_SETTING_NOT_INITIALIZED && value)
+    {
+        restoreDefaultsDoneTime = std::chrono::steady_clock::now() +
+            restoreDefaultsTime;
+    }
+}
+
+void ProgrammerSimulator::setLatency(std::chrono::microseconds latency)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->latency = latency;
+}
+
+void ProgrammerSimulator::setTimeout(uint32_t timeoutMs)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    timeout = std::chrono::milliseconds(timeoutMs);
+}
+
+void ProgrammerSimulator::failNextTransfers(uint32_t count)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingFailures = count;
+}
+
+void ProgrammerSimulator::disconnect()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    disconnected = true;
+}
+
+void ProgrammerSimulator::setRestoreDefaultsTime(std::chrono::microseconds time)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    restoreDefaultsTime = time;
+}
+
+uint8_t ProgrammerSimulator::getRawSetting(uint8_t id) const
+{
+    assert(id <= PAVR2_SETTING_VCC_5V_MAX);
+    std::lock_guard<std::mutex> lock(mutex);
+    return settings[id];
+}
+
+void ProgrammerSimulator::setRawSetting(uint8_t id, uint8_t value)
+{
+    assert(id <= PAVR2_SETTING_VCC_5V_MAX);
+    std::lock_guard<std::mutex> lock(mutex);
+    settings[id] = value;
+}
+
+uint8_t ProgrammerSimulator::getRawVariable(uint8_t id) const
+{
+    assert(id <= PAVR2_VARIABLE_IN_PROGRAMMING_MODE);
+    std::lock_guard<std::mutex> lock(mutex);
+    return variables[id];
+}
+
+void ProgrammerSimulator::setRawVariable(uint8_t id, uint8_t value)
+{
+    assert(id <= PAVR2_VARIABLE_IN_PROGRAMMING_MODE);
+    std::lock_guard<std::mutex> lock(mutex);
+    variables[id] = value;
+}
+
+void ProgrammerSimulator::setDigitalReadings(
+    const ProgrammerDigitalReadings & readings)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    digitalReadings = readings;
+}
+
+uint32_t ProgrammerSimulator::getTransferCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return transferCount;
+}
@@ -0,0 +1,114 @@
+#include <programmer_stats.h>
+
+// Each power of two is split into 2^subBucketBits buckets.
+static const uint32_t subBucketBits = 5;
+static const uint32_t subBucketCount = 1 << subBucketBits;
+
+// Enough buckets to hold any 32-bit value.
+static const uint32_t bucketCount = subBucketCount * (32 - subBucketBits + 1);
+
+static uint32_t bucketIndex(uint32_t value)
+{
+    if (value < subBucketCount) { return value; }
+
+    uint32_t shift = 0;
+    while ((value >> shift) >= 2 * subBucketCount) { shift++; }
+
+    // (value >> shift) is between subBucketCount and 2 * subBucketCount - 1.
+    return subBucketCount * (shift + 1) + (value >> shift) - subBucketCount;
+}
+
+// Returns the largest value that would be stored in the specified bucket.
+static uint32_t bucketUpperBound(uint32_t index)
+{
+    if (index < subBucketCount) { return index; }
+
+    uint32_t shift = index / subBucketCount - 1;
+    uint64_t top = subBucketCount + index % subBucketCount;
+    return ((top + 1) << shift) - 1;
+}
+
+ProgrammerLatencyHistogram::ProgrammerLatencyHistogram()
+    : buckets(bucketCount, 0)
+{
+}
+
+void ProgrammerLatencyHistogram::record(uint32_t us)
+{
+    buckets[bucketIndex(us)]++;
+    if (count == 0 || us < min) { min = us; }
+    if (us > max) { max = us; }
+    count++;
+    sum += us;
+}
+
+uint32_t ProgrammerLatencyHistogram::getPercentile(double percentile) const
+{
+    if (count == 0) { return 0; }
+
+    // The number of values that must be at or below the result.
+    uint64_t target = (uint64_t)(percentile / 100 * count + 0.5);
+    if (target < 1) { target = 1; }
+    if (target > count) { target = count; }
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < bucketCount; i++)
+    {
+        seen += buckets[i];
+        if (seen >= target)
+        {
+            uint32_t bound = bucketUpperBound(i);
+            return bound < max ? bound : max;
+        }
+    }
+    return max;
+}
+
+ProgrammerLatencyHistogram & ProgrammerLatencyHistogram::operator+=(
+    const ProgrammerLatencyHistogram & other)
+{
+    if (other.count == 0) { return *this; }
+
+    for (uint32_t i = 0; i < bucketCount; i++)
+    {
+        buckets[i] += other.buckets[i];
+    }
+    if (count == 0 || other.min < min) { min = other.min; }
+    if (other.max > max) { max = other.max; }
+    count += other.count;
+    sum += other.sum;
+    return *this;
+}
+
+ProgrammerRequestStats & ProgrammerRequestStats::operator+=(
+    const ProgrammerRequestStats & other)
+{
+    latency += other.latency;
+    failures += other.failures;
+    shortTransfers += other.shortTransfers;
+    return *this;
+}
+
+ProgrammerRetryStats & ProgrammerRetryStats::operator+=(
+    const ProgrammerRetryStats & other)
+{
+    retries += other.retries;
+    recovered += other.recovered;
+    exhausted += other.exhausted;
+
+    // These are not counters, so just keep the worst values.
+    if (other.smoothedRttUs > smoothedRttUs) { smoothedRttUs = other.smoothedRttUs; }
+    if (other.timeoutMs > timeoutMs) { timeoutMs = other.timeoutMs; }
+    return *this;
+}
+
+ProgrammerStats & ProgrammerStats::operator+=(const ProgrammerStats & other)
+{
+    getSetting += other.getSetting;
+    setSetting += other.setSetting;
+    getVariable += other.getVariable;
+    digitalRead += other.digitalRead;
+    getDescriptor += other.getDescriptor;
+    retry += other.retry;
+    return *this;
+}
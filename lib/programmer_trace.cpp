@@ -0,0 +1,287 @@
+#include <programmer_trace.h>
+
+#include <cstring>
+#include <thread>
+
+static const char traceMagic[8] = { 'P', 'A', 'V', 'R', '2', 'T', 'R', 'C' };
+static const uint16_t traceVersion = 2;
+
+static void appendUInt(std::string & out, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        out += (char)(value >> (8 * i) & 0xFF);
+    }
+}
+
+// Appends a string preceded by its length.  lengthSize is the size of the
+// length field in bytes.
+static void appendString(std::string & out, const std::string & str,
+    size_t lengthSize)
+{
+    uint64_t maxLength = ((uint64_t)1 << (8 * lengthSize)) - 1;
+    size_t length = str.size() < maxLength ? str.size() : maxLength;
+    appendUInt(out, length, lengthSize);
+    out.append(str, 0, length);
+}
+
+ProgrammerTraceRecorder::ProgrammerTraceRecorder(
+    const std::string & fileName,
+    const ProgrammerInstance & instance,
+    std::shared_ptr<ProgrammerTransport> transport)
+    : transport(transport), startTime(std::chrono::steady_clock::now())
+{
+    file.open(fileName, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        throw std::runtime_error(
+            "Failed to open trace file '" + fileName + "' for writing.");
+    }
+
+    std::string header(traceMagic, sizeof(traceMagic));
+    appendUInt(header, traceVersion, 2);
+    appendUInt(header, instance.getProductId(), 2);
+    appendUInt(header, instance.getFirmwareVersion(), 2);
+    appendString(header, instance.getSerialNumber(), 1);
+    file.write(header.data(), header.size());
+}
+
+void ProgrammerTraceRecorder::controlTransfer(uint8_t requestType,
+    uint8_t request, uint16_t value, uint16_t index,
+    void * buffer, uint16_t length, size_t * transferred)
+{
+    auto transferStart = std::chrono::steady_clock::now();
+
+    size_t localTransferred = 0;
+    bool failed = false;
+    std::string message;
+    uint32_t code = 0;
+    try
+    {
+        transport->controlTransfer(requestType, request, value, index,
+            buffer, length, &localTransferred);
+    }
+    catch (const ProgrammerTransportError & error)
+    {
+        failed = true;
+        message = error.what();
+        code = error.getCode();
+    }
+
+    auto transferEnd = std::chrono::steady_clock::now();
+
+    std::string record;
+    appendUInt(record, std::chrono::duration_cast<std::chrono::microseconds>(
+        transferStart - startTime).count(), 8);
+    appendUInt(record, std::chrono::duration_cast<std::chrono::microseconds>(
+        transferEnd - transferStart).count(), 4);
+    appendUInt(record, requestType, 1);
+    appendUInt(record, request, 1);
+    appendUInt(record, value, 2);
+    appendUInt(record, index, 2);
+    appendUInt(record, length, 2);
+    appendUInt(record, failed, 1);
+    if (failed)
+    {
+        appendUInt(record, code, 4);
+        appendString(record, message, 2);
+    }
+    else if (requestType & 0x80)
+    {
+        appendString(record,
+            std::string((const char *)buffer, localTransferred), 2);
+    }
+    else
+    {
+        appendUInt(record, localTransferred, 2);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        file.write(record.data(), record.size());
+    }
+
+    if (failed) { throw ProgrammerTransportError(message, code); }
+    if (transferred) { *transferred = localTransferred; }
+}
+
+void ProgrammerTraceRecorder::setTimeout(uint32_t timeoutMs)
+{
+    transport->setTimeout(timeoutMs);
+}
+
+// Reads little-endian numbers and strings from the contents of a trace file.
+class TraceReader
+{
+public:
+    explicit TraceReader(const std::string & data) : data(data) { }
+
+    bool atEnd() const { return position == data.size(); }
+
+    uint64_t readUInt(size_t size)
+    {
+        need(size);
+        uint64_t value = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            value |= (uint64_t)(uint8_t)data[position + i] << (8 * i);
+        }
+        position += size;
+        return value;
+    }
+
+    std::string readString(size_t lengthSize)
+    {
+        size_t length = readUInt(lengthSize);
+        need(length);
+        std::string str = data.substr(position, length);
+        position += length;
+        return str;
+    }
+
+private:
+    void need(size_t size)
+    {
+        if (data.size() - position < size)
+        {
+            throw std::runtime_error("The trace file is truncated.");
+        }
+    }
+
+    const std::string & data;
+    size_t position = 0;
+};
+
+ProgrammerTraceReplayer::ProgrammerTraceReplayer(
+    const std::string & fileName, bool recordedTiming)
+    : recordedTiming(recordedTiming)
+{
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error(
+            "Failed to open trace file '" + fileName + "' for reading.");
+    }
+    std::string data((std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>());
+
+    if (data.size() < sizeof(traceMagic) ||
+        memcmp(data.data(), traceMagic, sizeof(traceMagic)))
+    {
+        throw std::runtime_error(
+            "The file '" + fileName + "' is not a programmer trace.");
+    }
+
+    TraceReader reader(data);
+    reader.readUInt(sizeof(traceMagic));
+    uint16_t version = reader.readUInt(2);
+    if (version < 1 || version > traceVersion)
+    {
+        throw std::runtime_error(
+            "The trace file '" + fileName + "' has an unsupported version.");
+    }
+    productId = reader.readUInt(2);
+    firmwareVersion = reader.readUInt(2);
+    serialNumber = reader.readString(1);
+
+    while (!reader.atEnd())
+    {
+        Record record;
+        record.timestampUs = reader.readUInt(8);
+        record.durationUs = reader.readUInt(4);
+        record.requestType = reader.readUInt(1);
+        record.request = reader.readUInt(1);
+        record.value = reader.readUInt(2);
+        record.index = reader.readUInt(2);
+        reader.readUInt(2);  // wLength
+        record.failed = reader.readUInt(1);
+        record.errorCode = 0;
+        if (record.failed && version >= 2)
+        {
+            record.errorCode = reader.readUInt(4);
+        }
+        if (record.failed || (record.requestType & 0x80))
+        {
+            record.data = reader.readString(2);
+        }
+        else
+        {
+            record.data.resize(reader.readUInt(2));
+        }
+        record.used = false;
+        if (records.empty() || record.timestampUs < firstTimestampUs)
+        {
+            firstTimestampUs = record.timestampUs;
+        }
+        records.push_back(record);
+    }
+}
+
+ProgrammerInstance ProgrammerTraceReplayer::getInstance() const
+{
+    return ProgrammerInstance(libusbp::device(), libusbp::generic_interface(),
+        productId, serialNumber, firmwareVersion);
+}
+
+void ProgrammerTraceReplayer::controlTransfer(uint8_t requestType,
+    uint8_t request, uint16_t value, uint16_t index,
+    void * buffer, uint16_t length, size_t * transferred)
+{
+    Record record;
+    std::chrono::steady_clock::time_point responseTime;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!started)
+        {
+            started = true;
+            startTime = std::chrono::steady_clock::now();
+        }
+
+        size_t i = firstUnused;
+        for (; i < records.size(); i++)
+        {
+            const Record & r = records[i];
+            if (!r.used && r.requestType == requestType && r.request == request
+                && r.value == value && r.index == index)
+            {
+                break;
+            }
+        }
+
+        if (i == records.size())
+        {
+            throw ProgrammerTransportError(
+                "The trace has no more responses for this request.",
+                PROGRAMMER_TRANSPORT_ERROR_NO_RESPONSE);
+        }
+
+        records[i].used = true;
+        record = records[i];
+        responseTime = startTime + std::chrono::microseconds(
+            record.timestampUs - firstTimestampUs + record.durationUs);
+
+        while (firstUnused < records.size() && records[firstUnused].used)
+        {
+            firstUnused++;
+        }
+    }
+
+    if (recordedTiming)
+    {
+        std::this_thread::sleep_until(responseTime);
+    }
+
+    if (record.failed)
+    {
+        throw ProgrammerTransportError(record.data, record.errorCode);
+    }
+
+    size_t size = record.data.size();
+    if (requestType & 0x80)
+    {
+        if (size > length) { size = length; }
+        memcpy(buffer, record.data.data(), size);
+    }
+    if (transferred) { *transferred = size; }
+}
@@ -0,0 +1,52 @@
+#include <programmer_transport.h>
+
+// Returns the code from the error that matters the most when deciding whether
+// to retry a transfer.
+static uint32_t getErrorCode(const libusbp::error & error)
+{
+    static const uint32_t codes[] = {
+        LIBUSBP_ERROR_DEVICE_DISCONNECTED,
+        LIBUSBP_ERROR_TIMEOUT,
+        LIBUSBP_ERROR_STALL,
+        LIBUSBP_ERROR_CANCELLED,
+        LIBUSBP_ERROR_NOT_READY,
+    };
+    for (uint32_t code : codes)
+    {
+        if (error.has_code(code)) { return code; }
+    }
+    return 0;
+}
+
+ProgrammerUsbTransport::ProgrammerUsbTransport(
+    const libusbp::generic_interface & usbInterface)
+    : handle(usbInterface)
+{
+    // Set a timeout for all control transfers to prevent the CLI from hanging
+    // indefinitely if something goes wrong with the USB communication.
+    handle.set_timeout(0, 300);
+}
+
+void ProgrammerUsbTransport::controlTransfer(uint8_t requestType,
+    uint8_t request, uint16_t value, uint16_t index,
+    void * buffer, uint16_t length, size_t * transferred)
+{
+    // This also serializes the transfers, but the programmer handles control
+    // transfers one at a time anyway.
+    std::lock_guard<std::mutex> lock(mutex);
+    try
+    {
+        handle.control_transfer(requestType, request, value, index,
+            buffer, length, transferred);
+    }
+    catch (const libusbp::error & error)
+    {
+        throw ProgrammerTransportError(error.message(), getErrorCode(error));
+    }
+}
+
+void ProgrammerUsbTransport::setTimeout(uint32_t timeoutMs)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    handle.set_timeout(0, timeoutMs);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// A minimal test harness.  Each test program calls its test functions from
+// main() with TEST_RUN and returns testResult(), which is nonzero if any check
+// failed, so CTest can run it directly.
+
+#include <iostream>
+#include <exception>
+
+static int testFailures = 0;
+
+static void testCheck(bool condition, const char * expression,
+    const char * file, int line)
+{
+    if (condition) { return; }
+    std::cerr << file << ":" << line << ": check failed: " << expression
+        << std::endl;
+    testFailures++;
+}
+
+#define TEST_CHECK(condition) \
+    testCheck((condition), #condition, __FILE__, __LINE__)
+
+#define TEST_RUN(test) testRun(test, #test)
+
+template <typename Test>
+static void testRun(Test test, const char * name)
+{
+    int failuresBefore = testFailures;
+    try
+    {
+        test();
+    }
+    catch (const std::exception & error)
+    {
+        std::cerr << name << ": unexpected exception: " << error.what()
+            << std::endl;
+        testFailures++;
+    }
+    std::cout << (testFailures == failuresBefore ? "PASS " : "FAIL ")
+        << name << std::endl;
+}
+
+static int testResult()
+{
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+// Tests AsyncProgrammerHandle against the firmware simulator.
+
+#include "test.h"
+
+#include <programmer.h>
+#include <programmer_simulator.h>
+#include <programmer_async.h>
+
+#include <vector>
+
+// The I/O thread uses a copy of the handle, so a setting written with the
+// original handle must not make the copy skip a write it needs.
+static void testApplySettingsAfterOriginalWrote()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+    AsyncProgrammerHandle async(handle);
+
+    ProgrammerSettings settings = async.getSettings().get();
+    ProgrammerSettings changed = settings;
+    changed.regulatorMode = PAVR2_REGULATOR_MODE_3V3;
+    handle.applySettings(changed);
+    TEST_CHECK(simulator->getRawSetting(PAVR2_SETTING_REGULATOR_MODE) ==
+        PAVR2_REGULATOR_MODE_3V3);
+
+    async.applySettings(settings).get();
+    TEST_CHECK(simulator->getRawSetting(PAVR2_SETTING_REGULATOR_MODE) ==
+        settings.regulatorMode);
+}
+
+static void testOperationsRunInOrder()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+    AsyncProgrammerHandle async(handle);
+
+    std::vector<int> order;
+    std::shared_future<int> last;
+    for (int i = 0; i < 10; i++)
+    {
+        last = async.run<int>([&order, i](ProgrammerHandle &)
+        {
+            order.push_back(i);
+            return i;
+        });
+    }
+    TEST_CHECK(last.get() == 9);
+    TEST_CHECK(order.size() == 10);
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        TEST_CHECK(order[i] == (int)i);
+    }
+}
+
+static void testErrorsGoToTheFuture()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+    AsyncProgrammerHandle async(handle);
+
+    simulator->disconnect();
+    bool callbackThrew = false;
+    std::shared_future<ProgrammerVariables> future = async.getVariables(
+        [&](std::shared_future<ProgrammerVariables> f)
+        {
+            try
+            {
+                f.get();
+            }
+            catch (const ProgrammerTransportError &)
+            {
+                callbackThrew = true;
+            }
+        });
+
+    bool threw = false;
+    try
+    {
+        future.get();
+    }
+    catch (const ProgrammerTransportError & error)
+    {
+        threw = error.hasCode(LIBUSBP_ERROR_DEVICE_DISCONNECTED);
+    }
+    async.shutdown();
+    TEST_CHECK(threw);
+    TEST_CHECK(callbackThrew);
+}
+
+static void testOperationsFailAfterShutdown()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+    AsyncProgrammerHandle async(handle);
+
+    async.shutdown();
+    uint32_t transfers = simulator->getTransferCount();
+    bool threw = false;
+    try
+    {
+        async.digitalRead().get();
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    TEST_CHECK(threw);
+    TEST_CHECK(simulator->getTransferCount() == transfers);
+}
+
+int main()
+{
+    TEST_RUN(testApplySettingsAfterOriginalWrote);
+    TEST_RUN(testOperationsRunInOrder);
+    TEST_RUN(testErrorsGoToTheFuture);
+    TEST_RUN(testOperationsFailAfterShutdown);
+    return testResult();
+}
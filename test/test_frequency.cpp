@@ -0,0 +1,214 @@
+// Tests the index used to find frequencies by name and period, and the
+// functions that round a frequency down to an allowed one.
+
+#include "test.h"
+
+#include <programmer_frequency_tables.h>
+#include <programmer.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+static void testFindStk500ByName()
+{
+    for (size_t i = 0; i < programmerStk500FrequencyTable.size(); i++)
+    {
+        const char * name = programmerStk500FrequencyTable[i].name;
+        int32_t index = programmerStk500FrequencyFindByName(name);
+        TEST_CHECK(index >= 0 && index <= (int32_t)i);
+        if (index >= 0)
+        {
+            TEST_CHECK(strcmp(programmerStk500FrequencyTable[index].name, name) == 0);
+        }
+    }
+}
+
+static void testFindAllowedMaxByName()
+{
+    for (size_t i = 0; i < programmerAllowedMaxFrequencyTable.size(); i++)
+    {
+        const char * name = programmerAllowedMaxFrequencyTable[i].name;
+        TEST_CHECK(programmerAllowedMaxFrequencyFindByName(name) == (int32_t)i);
+    }
+}
+
+static void testFindStk500ByPeriod()
+{
+    for (size_t i = 0; i < programmerStk500FrequencyTable.size(); i++)
+    {
+        uint16_t period = programmerStk500FrequencyTable[i].period;
+        int32_t index = programmerStk500FrequencyFindByPeriod(period);
+        TEST_CHECK(index >= 0 && index <= (int32_t)i);
+        if (index >= 0)
+        {
+            TEST_CHECK(programmerStk500FrequencyTable[index].period == period);
+        }
+    }
+}
+
+static void testUnknownNames()
+{
+    TEST_CHECK(programmerStk500FrequencyFindByName("") == -1);
+    TEST_CHECK(programmerStk500FrequencyFindByName("12345") == -1);
+    TEST_CHECK(programmerAllowedMaxFrequencyFindByName("1.5") == -1);
+}
+
+static void testFindAtMost()
+{
+    ProgrammerFrequencyTable table = programmerAllowedFrequencyTable;
+
+    // Exact frequencies, including ones computed from each period.
+    TEST_CHECK(programmerFrequencyFindAtMost(table, 1500000) == 6);
+    for (size_t i = 0; i < table.size(); i++)
+    {
+        int32_t index = programmerFrequencyFindAtMost(table,
+            12000000.0 / table[i].period);
+        TEST_CHECK(index >= 0 && table[index].period == table[i].period);
+    }
+
+    // Between two entries: 1400 kHz is between 1500 kHz and 1333 kHz.
+    TEST_CHECK(programmerFrequencyFindAtMost(table, 1400000) == 7);
+
+    // Faster than the fastest entry.
+    TEST_CHECK(programmerFrequencyFindAtMost(table, 20000000) == 0);
+
+    // Slower than the slowest entry (1.465 kHz).
+    TEST_CHECK(programmerFrequencyFindAtMost(table, 1400) == -1);
+    TEST_CHECK(programmerFrequencyFindAtMost(table, 0) == -1);
+}
+
+static void testFindFrequencyAtMost()
+{
+    ProgrammerFrequencySetting setting = Programmer::findFrequencyAtMost(1500000);
+    TEST_CHECK(Programmer::getFrequencyName(setting.sckDuration,
+        setting.ispFastestPeriod) == "1500");
+
+    setting = Programmer::findFrequencyAtMost(1400000);
+    TEST_CHECK(Programmer::getFrequencyName(setting.sckDuration,
+        setting.ispFastestPeriod) == "1333");
+
+    setting = Programmer::findFrequencyAtMost(20000000);
+    TEST_CHECK(Programmer::getFrequencyName(setting.sckDuration,
+        setting.ispFastestPeriod) == "6000");
+
+    // Frequencies below 444 kHz come from SCK_DURATION.
+    setting = Programmer::findFrequencyAtMost(1470);
+    TEST_CHECK(setting.sckDuration != 0);
+    TEST_CHECK(Programmer::getFrequencyName(setting.sckDuration,
+        setting.ispFastestPeriod) == "1.465");
+
+    bool threw = false;
+    try { Programmer::findFrequencyAtMost(1400); }
+    catch (const std::runtime_error &) { threw = true; }
+    TEST_CHECK(threw);
+}
+
+static void testFindMaxFrequencyAtMost()
+{
+    TEST_CHECK(Programmer::findMaxFrequencyAtMost(1500000) == 8);
+    TEST_CHECK(Programmer::findMaxFrequencyAtMost(1400000) == 9);
+    TEST_CHECK(Programmer::findMaxFrequencyAtMost(20000000) == 2);
+    TEST_CHECK(Programmer::findMaxFrequencyAtMost(470000) == 26);
+
+    // The slowest allowed maximum frequency is 462 kHz.
+    bool threw = false;
+    try { Programmer::findMaxFrequencyAtMost(450000); }
+    catch (const std::runtime_error &) { threw = true; }
+    TEST_CHECK(threw);
+}
+
+static void testSplitFrequency()
+{
+    std::string number;
+    double unitHz = 0;
+
+    TEST_CHECK(Programmer::splitFrequency("1500", number, unitHz));
+    TEST_CHECK(number == "1500" && unitHz == 1000);
+    TEST_CHECK(Programmer::splitFrequency("1500k", number, unitHz));
+    TEST_CHECK(number == "1500" && unitHz == 1000);
+    TEST_CHECK(Programmer::splitFrequency("114 kHz", number, unitHz));
+    TEST_CHECK(number == "114" && unitHz == 1000);
+    TEST_CHECK(Programmer::splitFrequency("1.5M", number, unitHz));
+    TEST_CHECK(number == "1.5" && unitHz == 1000000);
+    TEST_CHECK(Programmer::splitFrequency("1.5MHz", number, unitHz));
+    TEST_CHECK(number == "1.5" && unitHz == 1000000);
+    TEST_CHECK(Programmer::splitFrequency("1500000 hz", number, unitHz));
+    TEST_CHECK(number == "1500000" && unitHz == 1);
+    TEST_CHECK(Programmer::splitFrequency("1500000HZ", number, unitHz));
+    TEST_CHECK(number == "1500000" && unitHz == 1);
+
+    TEST_CHECK(!Programmer::splitFrequency("", number, unitHz));
+    TEST_CHECK(!Programmer::splitFrequency("kHz", number, unitHz));
+    TEST_CHECK(!Programmer::splitFrequency(".", number, unitHz));
+    TEST_CHECK(!Programmer::splitFrequency("1.5.0", number, unitHz));
+    TEST_CHECK(!Programmer::splitFrequency("1.5GHz", number, unitHz));
+    TEST_CHECK(!Programmer::splitFrequency("-1", number, unitHz));
+}
+
+static std::string frequencyNameFromString(const std::string & frequency)
+{
+    ProgrammerSettings settings;
+    Programmer::setFrequencyFromString(settings, frequency, false);
+    return Programmer::getFrequencyName(settings.sckDuration,
+        settings.ispFastestPeriod);
+}
+
+static std::string maxFrequencyNameFromString(const std::string & frequency)
+{
+    ProgrammerSettings settings;
+    Programmer::setFrequencyFromString(settings, frequency, true);
+    return Programmer::getMaxFrequencyName(settings.ispFastestPeriod);
+}
+
+static void testSetFrequencyFromString()
+{
+    // Each unit suffix.
+    TEST_CHECK(frequencyNameFromString("1500") == "1500");
+    TEST_CHECK(frequencyNameFromString("1500k") == "1500");
+    TEST_CHECK(frequencyNameFromString("1500 kHz") == "1500");
+    TEST_CHECK(frequencyNameFromString("1.5M") == "1500");
+    TEST_CHECK(frequencyNameFromString("1.5 MHz") == "1500");
+    TEST_CHECK(frequencyNameFromString("1500000Hz") == "1500");
+    TEST_CHECK(maxFrequencyNameFromString("1.5mhz") == "1500");
+    TEST_CHECK(maxFrequencyNameFromString("1500000 Hz") == "1500");
+
+    // A name from the tables is used exactly even though it is rounded: 114
+    // kHz is really 12 MHz / 105, which is slightly faster than 114 kHz.
+    TEST_CHECK(frequencyNameFromString("114") == "114");
+    TEST_CHECK(frequencyNameFromString("114000 Hz") != "114");
+
+    // Other frequencies round down.
+    TEST_CHECK(frequencyNameFromString("1.4 MHz") == "1333");
+    TEST_CHECK(frequencyNameFromString("20 MHz") == "6000");
+    TEST_CHECK(maxFrequencyNameFromString("1400") == "1333");
+
+    // Invalid strings and frequencies below the slowest allowed one throw.
+    const char * invalid[] = { "1.5GHz", "", "1..5", "1 Hz" };
+    for (const char * frequency : invalid)
+    {
+        bool threw = false;
+        try { frequencyNameFromString(frequency); }
+        catch (const std::runtime_error &) { threw = true; }
+        TEST_CHECK(threw);
+    }
+
+    bool threw = false;
+    try { maxFrequencyNameFromString("400 kHz"); }
+    catch (const std::runtime_error &) { threw = true; }
+    TEST_CHECK(threw);
+}
+
+int main()
+{
+    TEST_RUN(testFindStk500ByName);
+    TEST_RUN(testFindAllowedMaxByName);
+    TEST_RUN(testFindStk500ByPeriod);
+    TEST_RUN(testUnknownNames);
+    TEST_RUN(testFindAtMost);
+    TEST_RUN(testFindFrequencyAtMost);
+    TEST_RUN(testFindMaxFrequencyAtMost);
+    TEST_RUN(testSplitFrequency);
+    TEST_RUN(testSetFrequencyFromString);
+    return testResult();
+}
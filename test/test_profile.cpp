@@ -0,0 +1,106 @@
+// Tests settings profiles.
+
+#include "test.h"
+
+#include <programmer_profile.h>
+#include <programmer_simulator.h>
+
+#include <string>
+
+static bool frequenciesEqual(const ProgrammerSettings & a,
+    const ProgrammerSettings & b)
+{
+    return a.sckDuration == b.sckDuration &&
+        a.ispFastestPeriod == b.ispFastestPeriod;
+}
+
+// Exporting the settings and importing them again must not change anything,
+// even though several raw values can have the same frequency name.
+static void testRoundTripKeepsFrequencies()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+    ProgrammerSettings settings = handle.getSettings();
+
+    uint32_t changed = 0;
+    for (uint32_t period = PAVR2_ISP_FASTEST_PERIOD_MIN;
+        period <= PAVR2_ISP_FASTEST_PERIOD_MAX; period++)
+    {
+        for (uint32_t duration = 0; duration <= 255; duration++)
+        {
+            settings.ispFastestPeriod = period;
+            settings.sckDuration = duration;
+            std::string text = ProgrammerSettingsProfile(settings).toString();
+            ProgrammerSettings imported = settings;
+            ProgrammerSettingsProfile::parse(text).applyTo(imported);
+            if (!frequenciesEqual(imported, settings)) { changed++; }
+        }
+    }
+    TEST_CHECK(changed == 0);
+}
+
+static void testImportWritesNothingNew()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    simulator->setRawSetting(PAVR2_SETTING_SCK_DURATION, 230);
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+
+    ProgrammerSettings settings = handle.getSettings();
+    ProgrammerSettingsProfile profile(settings);
+    ProgrammerSettingsProfile::parse(profile.toString()).applyTo(settings);
+    handle.applySettings(settings);
+    TEST_CHECK(handle.getStats().setSetting.latency.getCount() == 0);
+    TEST_CHECK(simulator->getRawSetting(PAVR2_SETTING_SCK_DURATION) == 230);
+}
+
+static void testPartialProfile()
+{
+    ProgrammerSettingsProfile profile = ProgrammerSettingsProfile::parse(
+        "profile_version: 1\n"
+        "isp_frequency_khz: 114  # the default\n"
+        "line_a_function: dtr-reset\n");
+
+    ProgrammerSettings settings = ProgrammerSettings();
+    settings.regulatorMode = PAVR2_REGULATOR_MODE_5V;
+    profile.applyTo(settings);
+    TEST_CHECK(Programmer::getFrequencyName(settings.sckDuration,
+        settings.ispFastestPeriod) == "114");
+    TEST_CHECK(settings.lineAFunction == PAVR2_LINE_IS_DTR_RESET);
+    TEST_CHECK(settings.regulatorMode == PAVR2_REGULATOR_MODE_5V);
+}
+
+static std::string getParseError(const std::string & text)
+{
+    try
+    {
+        ProgrammerSettingsProfile::parse(text);
+    }
+    catch (const std::exception & error)
+    {
+        return error.what();
+    }
+    return "";
+}
+
+static void testParseErrors()
+{
+    TEST_CHECK(getParseError("") == "The profile is empty.");
+    TEST_CHECK(getParseError("regulator_mode: auto\n").find("Line 1 ") == 0);
+    TEST_CHECK(getParseError("profile_version: 2\n").find("Line 1 ") == 0);
+    TEST_CHECK(getParseError(
+        "profile_version: 1\nisp_frequency_khz: 12345\n").find("Line 2 ") == 0);
+    TEST_CHECK(getParseError(
+        "profile_version: 1\nfoo: 1\n").find("Unknown setting") != std::string::npos);
+    TEST_CHECK(getParseError(
+        "profile_version: 1\nvcc_output_enabled: true\n"
+        "vcc_output_enabled: false\n").find("Line 3 ") == 0);
+}
+
+int main()
+{
+    TEST_RUN(testRoundTripKeepsFrequencies);
+    TEST_RUN(testImportWritesNothingNew);
+    TEST_RUN(testPartialProfile);
+    TEST_RUN(testParseErrors);
+    return testResult();
+}
@@ -0,0 +1,234 @@
+// Tests ProgrammerHandle and ResilientProgrammerHandle against the firmware
+// simulator.
+
+#include "test.h"
+
+#include <programmer.h>
+#include <programmer_simulator.h>
+#include <programmer_resilient.h>
+
+#include <chrono>
+#include <thread>
+
+static uint64_t getSetSettingCount(const ProgrammerHandle & handle)
+{
+    return handle.getStats().setSetting.latency.getCount();
+}
+
+static void testApplySettingsWritesOnlyChanges()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+
+    ProgrammerSettings settings = handle.getSettings();
+    settings.regulatorMode = PAVR2_REGULATOR_MODE_5V;
+    settings.lineAFunction = PAVR2_LINE_IS_DTR;
+    handle.applySettings(settings);
+    TEST_CHECK(getSetSettingCount(handle) == 2);
+    TEST_CHECK(simulator->getRawSetting(PAVR2_SETTING_REGULATOR_MODE) ==
+        PAVR2_REGULATOR_MODE_5V);
+    TEST_CHECK(simulator->getRawSetting(PAVR2_SETTING_LINE_A_FUNCTION) ==
+        PAVR2_LINE_IS_DTR);
+
+    // Nothing changed since the last call.
+    handle.applySettings(settings);
+    TEST_CHECK(getSetSettingCount(handle) == 2);
+}
+
+static void testApplySettingsAfterInvalidate()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+
+    ProgrammerSettings settings = handle.getSettings();
+    handle.invalidateSettingsShadow();
+    simulator->setRawSetting(PAVR2_SETTING_LINE_B_FUNCTION, PAVR2_LINE_IS_RTS);
+    handle.applySettings(settings);
+    TEST_CHECK(getSetSettingCount(handle) == 1);
+    TEST_CHECK(simulator->getRawSetting(PAVR2_SETTING_LINE_B_FUNCTION) ==
+        PAVR2_LINE_IS_NOTHING);
+}
+
+static void testApplySettingsRereadsOldShadow()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+
+    // Another program changes a setting after we read them.
+    ProgrammerSettings settings = handle.getSettings();
+    simulator->setRawSetting(PAVR2_SETTING_LINE_B_FUNCTION, PAVR2_LINE_IS_RTS);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+    handle.applySettings(settings);
+    TEST_CHECK(getSetSettingCount(handle) == 1);
+    TEST_CHECK(simulator->getRawSetting(PAVR2_SETTING_LINE_B_FUNCTION) ==
+        PAVR2_LINE_IS_NOTHING);
+}
+
+static void testCopiesShareSettingsShadow()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle original(simulator->getInstance(), simulator);
+    ProgrammerHandle copy = original;
+
+    ProgrammerSettings settings = copy.getSettings();
+    ProgrammerSettings changed = settings;
+    changed.sckDuration = settings.sckDuration + 1;
+    original.applySettings(changed);
+
+    copy.applySettings(settings);
+    TEST_CHECK(simulator->getRawSetting(PAVR2_SETTING_SCK_DURATION) ==
+        settings.sckDuration);
+}
+
+static void testReadRetriesRecover()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+
+    simulator->failNextTransfers(2);
+    handle.getVariables();
+    ProgrammerStats stats = handle.getStats();
+    TEST_CHECK(stats.retry.retries == 2);
+    TEST_CHECK(stats.retry.recovered == 1);
+    TEST_CHECK(stats.retry.exhausted == 0);
+}
+
+static void testReadRetriesExhausted()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+
+    ProgrammerRetryPolicy policy;
+    policy.maxRetries = 1;
+    handle.setRetryPolicy(policy);
+
+    simulator->failNextTransfers(2);
+    bool threw = false;
+    try
+    {
+        handle.getVariables();
+    }
+    catch (const ProgrammerTransportError & error)
+    {
+        threw = error.hasCode(LIBUSBP_ERROR_TIMEOUT);
+    }
+    TEST_CHECK(threw);
+    TEST_CHECK(handle.getStats().retry.exhausted == 1);
+}
+
+static void testWritesAreNotRetried()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+
+    ProgrammerSettings settings = handle.getSettings();
+    settings.regulatorMode = PAVR2_REGULATOR_MODE_3V3;
+    simulator->failNextTransfers(1);
+    bool threw = false;
+    try
+    {
+        handle.applySettings(settings);
+    }
+    catch (const ProgrammerTransportError &)
+    {
+        threw = true;
+    }
+    TEST_CHECK(threw);
+    TEST_CHECK(handle.getStats().retry.retries == 0);
+
+    // The failed write might not have happened, so it is written again.
+    handle.applySettings(settings);
+    TEST_CHECK(simulator->getRawSetting(PAVR2_SETTING_REGULATOR_MODE) ==
+        PAVR2_REGULATOR_MODE_3V3);
+}
+
+static void testWritesGetInitialTimeout()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+
+    // Fast reads bring the timeout down to the minimum.
+    ProgrammerSettings settings = handle.getSettings();
+    TEST_CHECK(handle.getStats().retry.timeoutMs ==
+        handle.getRetryPolicy().minTimeoutMs);
+
+    // A write slower than that still gets the initial timeout.
+    simulator->setLatency(std::chrono::milliseconds(100));
+    settings.regulatorMode = PAVR2_REGULATOR_MODE_3V3;
+    handle.applySettings(settings);
+    TEST_CHECK(simulator->getRawSetting(PAVR2_SETTING_REGULATOR_MODE) ==
+        PAVR2_REGULATOR_MODE_3V3);
+    TEST_CHECK(handle.getStats().setSetting.failures == 0);
+}
+
+static void testReconnect()
+{
+    auto first = std::make_shared<ProgrammerSimulator>("00001234");
+    auto second = std::make_shared<ProgrammerSimulator>("00001234");
+    ProgrammerHandle handle(first->getInstance(), first);
+
+    // The programmer is missing for the first two attempts to open it.
+    unsigned int openCount = 0;
+    ProgrammerReconnectOptions options;
+    options.pollIntervalMs = 1;
+    options.restoreSettings = true;
+    options.open = [&](const std::string & serialNumber)
+    {
+        TEST_CHECK(serialNumber == "00001234");
+        if (++openCount < 3) { return ProgrammerHandle(); }
+        return ProgrammerHandle(second->getInstance(), second);
+    };
+
+    ResilientProgrammerHandle resilient(handle, options);
+    ProgrammerSettings settings = resilient.getSettings();
+    settings.lineBFunction = PAVR2_LINE_IS_CLOCK;
+    resilient.applySettings(settings);
+
+    first->disconnect();
+    resilient.getVariables();
+    TEST_CHECK(resilient.getReconnectCount() == 1);
+    TEST_CHECK(openCount == 3);
+    TEST_CHECK(second->getRawSetting(PAVR2_SETTING_LINE_B_FUNCTION) ==
+        PAVR2_LINE_IS_CLOCK);
+}
+
+static void testReconnectTimeout()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    ProgrammerHandle handle(simulator->getInstance(), simulator);
+
+    ProgrammerReconnectOptions options;
+    options.timeoutMs = 20;
+    options.pollIntervalMs = 1;
+    options.open = [](const std::string &) { return ProgrammerHandle(); };
+
+    ResilientProgrammerHandle resilient(handle, options);
+    simulator->disconnect();
+    bool threw = false;
+    try
+    {
+        resilient.getVariables();
+    }
+    catch (const ProgrammerTransportError & error)
+    {
+        threw = error.hasCode(LIBUSBP_ERROR_DEVICE_DISCONNECTED);
+    }
+    TEST_CHECK(threw);
+    TEST_CHECK(resilient.getReconnectCount() == 0);
+}
+
+int main()
+{
+    TEST_RUN(testApplySettingsWritesOnlyChanges);
+    TEST_RUN(testApplySettingsAfterInvalidate);
+    TEST_RUN(testApplySettingsRereadsOldShadow);
+    TEST_RUN(testCopiesShareSettingsShadow);
+    TEST_RUN(testReadRetriesRecover);
+    TEST_RUN(testReadRetriesExhausted);
+    TEST_RUN(testWritesAreNotRetried);
+    TEST_RUN(testWritesGetInitialTimeout);
+    TEST_RUN(testReconnect);
+    TEST_RUN(testReconnectTimeout);
+    return testResult();
+}
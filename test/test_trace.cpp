@@ -0,0 +1,103 @@
+// Tests recording a session with the firmware simulator and replaying it.
+
+#include "test.h"
+
+#include <programmer.h>
+#include <programmer_simulator.h>
+#include <programmer_trace.h>
+#include <programmer_resilient.h>
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+static const char traceFile[] = "test_trace.pavr2trc";
+
+// Records a session that reads the settings and then the variables twice.
+static void recordSession()
+{
+    auto simulator = std::make_shared<ProgrammerSimulator>();
+    simulator->setRawSetting(PAVR2_SETTING_LINE_A_FUNCTION, PAVR2_LINE_IS_CD);
+    auto recorder = std::make_shared<ProgrammerTraceRecorder>(
+        traceFile, simulator->getInstance(), simulator);
+    ProgrammerHandle handle(simulator->getInstance(), recorder);
+    handle.getSettings();
+    handle.getVariables();
+    handle.getVariables();
+}
+
+static void testReplay()
+{
+    recordSession();
+    auto replayer = std::make_shared<ProgrammerTraceReplayer>(traceFile);
+    ProgrammerHandle handle(replayer->getInstance(), replayer);
+    TEST_CHECK(handle.getSettings().lineAFunction == PAVR2_LINE_IS_CD);
+    handle.getVariables();
+    handle.getVariables();
+}
+
+// Running out of responses must not look like a problem that retrying or
+// reconnecting could fix.
+static void testReplayExhausted()
+{
+    recordSession();
+    auto replayer = std::make_shared<ProgrammerTraceReplayer>(traceFile);
+    ProgrammerHandle handle(replayer->getInstance(), replayer);
+    handle.getVariables();
+    handle.getVariables();
+
+    unsigned int openCount = 0;
+    ProgrammerReconnectOptions options;
+    options.open = [&](const std::string &)
+    {
+        openCount++;
+        return ProgrammerHandle();
+    };
+    ResilientProgrammerHandle resilient(handle, options);
+
+    uint32_t code = 0;
+    try
+    {
+        resilient.getVariables();
+    }
+    catch (const ProgrammerTransportError & error)
+    {
+        code = error.getCode();
+    }
+    TEST_CHECK(code == PROGRAMMER_TRANSPORT_ERROR_NO_RESPONSE);
+    TEST_CHECK(openCount == 0);
+    TEST_CHECK(resilient.getHandle().getStats().retry.retries == 0);
+}
+
+// With the recorded timing, the gap between two requests is replayed too, not
+// just how long each one took.
+static void testReplayTiming()
+{
+    {
+        auto simulator = std::make_shared<ProgrammerSimulator>();
+        simulator->setLatency(std::chrono::milliseconds(1));
+        auto recorder = std::make_shared<ProgrammerTraceRecorder>(
+            traceFile, simulator->getInstance(), simulator);
+        ProgrammerHandle handle(simulator->getInstance(), recorder);
+        handle.digitalRead();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        handle.digitalRead();
+    }
+
+    auto replayer = std::make_shared<ProgrammerTraceReplayer>(traceFile, true);
+    ProgrammerHandle handle(replayer->getInstance(), replayer);
+    auto startTime = std::chrono::steady_clock::now();
+    handle.digitalRead();
+    handle.digitalRead();
+    auto elapsed = std::chrono::steady_clock::now() - startTime;
+    TEST_CHECK(elapsed >= std::chrono::milliseconds(50));
+}
+
+int main()
+{
+    TEST_RUN(testReplay);
+    TEST_RUN(testReplayExhausted);
+    TEST_RUN(testReplayTiming);
+    std::remove(traceFile);
+    return testResult();
+}